@@ -18,6 +18,7 @@
 #ifndef CEPH_BLK_BLOCKDEVICE_H
 #define CEPH_BLK_BLOCKDEVICE_H
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <list>
@@ -103,6 +104,8 @@ public:
   std::atomic_int num_running = {0};
   bool allow_eio;
   uint32_t flags = 0;               // FLAG_*
+  /// reads that landed in buffers the cache must not pin
+  std::vector<const ceph::buffer::list*> dont_cache_bls;
 
   explicit IOContext(CephContext* cct, void *p, bool allow_eio = false)
     : cct(cct), priv(p), allow_eio(allow_eio)
@@ -144,6 +147,11 @@ public:
   bool skip_cache() const {
     return flags & FLAG_DONT_CACHE;
   }
+  bool skip_cache(const ceph::buffer::list& bl) const {
+    return skip_cache() ||
+      std::find(dont_cache_bls.begin(), dont_cache_bls.end(), &bl) !=
+        dont_cache_bls.end();
+  }
 };
 
 
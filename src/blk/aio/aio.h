@@ -104,6 +104,13 @@ struct io_queue_t {
   virtual int submit_batch(aio_iter begin, aio_iter end,
 			   void *priv, int *retries, int submit_retries, int initial_delay_us) = 0;
   virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+
+  /// get a buffer the queue can do I/O into with less overhead (e.g. one
+  /// pre-registered with the kernel); nullptr if the queue has none to spare
+  virtual ceph::unique_leakable_ptr<ceph::buffer::raw>
+  try_create_registered_buffer(size_t len) {
+    return nullptr;
+  }
 };
 
 struct aio_queue_t final : public io_queue_t {
@@ -91,7 +91,13 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
   if (use_ioring && ioring_queue_t::supported()) {
     bool use_ioring_hipri = cct->_conf.get_val<bool>("bdev_ioring_hipri");
     bool use_ioring_sqthread_poll = cct->_conf.get_val<bool>("bdev_ioring_sqthread_poll");
-    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri, use_ioring_sqthread_poll);
+    unsigned ioring_registered_buffers =
+      cct->_conf.get_val<uint64_t>("bdev_ioring_registered_buffers");
+    size_t ioring_registered_buffer_size =
+      cct->_conf.get_val<Option::size_t>("bdev_ioring_registered_buffer_size");
+    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri, use_ioring_sqthread_poll,
+                                                ioring_registered_buffers,
+                                                ioring_registered_buffer_size);
   } else {
     static bool once;
     if (use_ioring && !once) {
@@ -111,6 +117,9 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
             "Number of discard ops issued to kernel device");
   b.add_u64_counter(l_blk_kernel_discard_threads, "discard_threads",
             "Number of discard threads running");
+  b.add_u64_counter(l_blk_kernel_device_registered_buffer_reads,
+            "registered_buffer_reads",
+            "Number of reads into io_uring registered buffers");
 
   logger.reset(b.create_perf_counters());
   cct->get_perfcounters_collection()->add(logger.get());
@@ -1523,8 +1532,15 @@ int KernelDevice::aio_read(
     ioc->pending_aios.push_back(aio_t(ioc, fd_directs[WRITE_LIFE_NOT_SET]));
     ++ioc->num_pending;
     aio_t& aio = ioc->pending_aios.back();
-    aio.bl.push_back(
-      ceph::buffer::ptr_node::create(create_custom_aligned(len, ioc)));
+    auto raw = io_queue->try_create_registered_buffer(len);
+    if (raw) {
+      // the registered pool is small, don't let the cache pin this read
+      ioc->dont_cache_bls.push_back(pbl);
+      logger->inc(l_blk_kernel_device_registered_buffer_reads);
+    } else {
+      raw = create_custom_aligned(len, ioc);
+    }
+    aio.bl.push_back(ceph::buffer::ptr_node::create(std::move(raw)));
     aio.bl.prepare_iov(&aio.iov);
     aio.preadv(off, len);
     dout(30) << aio << dendl;
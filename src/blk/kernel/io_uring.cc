@@ -9,15 +9,84 @@
 #include <sys/epoll.h>
 #include <map>
 
+#include <boost/lockfree/queue.hpp>
+
+#include "include/buffer_raw.h"
+#include "include/intarith.h"
+
 using std::list;
 using std::make_unique;
 
+/*
+ * A single page-aligned arena registered with io_uring and split into
+ * equally sized slots. The pool is shared with the buffers handed out,
+ * so they stay valid even when they outlive the queue.
+ */
+struct ioring_buffer_pool {
+  char *arena = nullptr;
+  const size_t buffer_size;
+  const unsigned buffer_count;
+  boost::lockfree::queue<unsigned> free_slots;
+
+  struct registered_raw : public ceph::buffer::raw {
+    std::shared_ptr<ioring_buffer_pool> pool; // for recycling
+    const unsigned slot;
+
+    registered_raw(std::shared_ptr<ioring_buffer_pool> pool,
+                   unsigned slot, unsigned len)
+      : raw(pool->arena + slot * pool->buffer_size, len),
+        pool(std::move(pool)),
+        slot(slot) {
+    }
+    ~registered_raw() override {
+      // don't free; recycle the slot instead
+      pool->free_slots.push(slot);
+    }
+  };
+
+  ioring_buffer_pool(size_t buffer_size, unsigned buffer_count)
+    : buffer_size(buffer_size),
+      buffer_count(buffer_count),
+      free_slots(buffer_count) {
+  }
+  ~ioring_buffer_pool() {
+    ::free(arena);
+  }
+
+  int init() {
+    int r = ::posix_memalign((void**)&arena, CEPH_PAGE_SIZE,
+                             buffer_size * buffer_count);
+    if (r) {
+      arena = nullptr;
+      return -r;
+    }
+    for (unsigned i = 0; i < buffer_count; ++i) {
+      free_slots.push(i);
+    }
+    return 0;
+  }
+
+  /// registered buffer index covering [base, base + len), or -1
+  int find(const void *base, size_t len) const {
+    auto p = static_cast<const char*>(base);
+    if (p < arena || p + len > arena + buffer_size * buffer_count) {
+      return -1;
+    }
+    size_t off = p - arena;
+    if (off / buffer_size != (off + len - 1) / buffer_size) {
+      return -1;
+    }
+    return off / buffer_size;
+  }
+};
+
 struct ioring_data {
   struct io_uring io_uring;
   pthread_mutex_t cq_mutex;
   pthread_mutex_t sq_mutex;
   int epoll_fd = -1;
   std::map<int, int> fixed_fds_map;
+  std::shared_ptr<ioring_buffer_pool> buffer_pool;
 };
 
 static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
@@ -51,6 +120,14 @@ static int find_fixed_fd(struct ioring_data *d, int real_fd)
   return it->second;
 }
 
+static int find_fixed_buffer(struct ioring_data *d, struct aio_t *io)
+{
+  if (!d->buffer_pool || io->iov.size() != 1)
+    return -1;
+
+  return d->buffer_pool->find(io->iov[0].iov_base, io->iov[0].iov_len);
+}
+
 static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 		     struct aio_t *io)
 {
@@ -58,7 +135,19 @@ static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 
   ceph_assert(fixed_fd != -1);
 
-  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
+  int fixed_buf = find_fixed_buffer(d, io);
+
+  if (fixed_buf != -1) {
+    /* No need for the kernel to map and pin the pages for this one */
+    if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
+      io_uring_prep_write_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+				io->iov[0].iov_len, io->offset, fixed_buf);
+    else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV)
+      io_uring_prep_read_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+			       io->iov[0].iov_len, io->offset, fixed_buf);
+    else
+      ceph_assert(0);
+  } else if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
     io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
 			 io->iov.size(), io->offset);
   else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV)
@@ -107,11 +196,36 @@ static void build_fixed_fds_map(struct ioring_data *d,
   }
 }
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_) :
+static int register_buffers(struct ioring_data *d, unsigned count,
+			    size_t size)
+{
+  auto pool = std::make_shared<ioring_buffer_pool>(size, count);
+  int ret = pool->init();
+  if (ret < 0)
+    return ret;
+
+  std::vector<struct iovec> iovs(count);
+  for (unsigned i = 0; i < count; i++) {
+    iovs[i].iov_base = pool->arena + i * size;
+    iovs[i].iov_len = size;
+  }
+  ret = io_uring_register_buffers(&d->io_uring, iovs.data(), iovs.size());
+  if (ret < 0)
+    return ret;
+
+  d->buffer_pool = std::move(pool);
+  return 0;
+}
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+			       unsigned registered_buffers_,
+			       size_t registered_buffer_size_) :
   d(make_unique<ioring_data>()),
   iodepth(iodepth_),
   hipri(hipri_),
-  sq_thread(sq_thread_)
+  sq_thread(sq_thread_),
+  registered_buffers(registered_buffers_),
+  registered_buffer_size(registered_buffer_size_)
 {
 }
 
@@ -144,10 +258,18 @@ int ioring_queue_t::init(std::vector<int> &fds)
 
   build_fixed_fds_map(d.get(), fds);
 
+  if (registered_buffers && registered_buffer_size) {
+    ret = register_buffers(d.get(), registered_buffers,
+			   p2roundup<size_t>(registered_buffer_size,
+					     CEPH_PAGE_SIZE));
+    if (ret < 0)
+      goto unregister_files;
+  }
+
   d->epoll_fd = epoll_create1(0);
   if (d->epoll_fd < 0) {
     ret = -errno;
-    goto unregister_files;
+    goto unregister_buffers;
   }
 
   struct epoll_event ev;
@@ -162,6 +284,11 @@ int ioring_queue_t::init(std::vector<int> &fds)
 
 close_epoll_fd:
   close(d->epoll_fd);
+unregister_buffers:
+  if (d->buffer_pool) {
+    io_uring_unregister_buffers(&d->io_uring);
+    d->buffer_pool.reset();
+  }
 unregister_files:
   io_uring_unregister_files(&d->io_uring);
 close_ring_fd:
@@ -175,6 +302,12 @@ void ioring_queue_t::shutdown()
   d->fixed_fds_map.clear();
   close(d->epoll_fd);
   d->epoll_fd = -1;
+  if (d->buffer_pool) {
+    // buffers still in use keep the pool alive, the kernel side
+    // of the registration is gone though
+    io_uring_unregister_buffers(&d->io_uring);
+    d->buffer_pool.reset();
+  }
   io_uring_unregister_files(&d->io_uring);
   io_uring_queue_exit(&d->io_uring);
 }
@@ -212,6 +345,21 @@ get_cqe:
   return events;
 }
 
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+ioring_queue_t::try_create_registered_buffer(size_t len)
+{
+  auto& pool = d->buffer_pool;
+  if (!pool || len == 0 || len > pool->buffer_size)
+    return nullptr;
+
+  unsigned slot;
+  if (!pool->free_slots.pop(slot))
+    return nullptr;
+
+  return ceph::unique_leakable_ptr<ceph::buffer::raw>(
+    new ioring_buffer_pool::registered_raw(pool, slot, len));
+}
+
 bool ioring_queue_t::supported()
 {
   struct io_uring ring;
@@ -227,7 +375,9 @@ bool ioring_queue_t::supported()
 
 struct ioring_data {};
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+			       unsigned registered_buffers_,
+			       size_t registered_buffer_size_)
 {
   ceph_assert(0);
 }
@@ -259,6 +409,12 @@ int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
   ceph_assert(0);
 }
 
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+ioring_queue_t::try_create_registered_buffer(size_t len)
+{
+  ceph_assert(0);
+}
+
 bool ioring_queue_t::supported()
 {
   return false;
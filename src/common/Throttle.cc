@@ -95,19 +95,24 @@ bool Throttle::_wait(int64_t c, std::unique_lock<std::mutex>& l)
 {
   mono_time start;
   bool waited = false;
-  if (_should_wait(c) || !conds.empty()) { // always wait behind other waiters.
+  // always wait behind other waiters.
+  if (!conds.empty() || !_try_get(c)) {
     {
       auto cv = conds.emplace(conds.end());
+      // put() skips the lock unless it sees us, so announce ourselves
+      // before checking count again
+      ++waiting;
       auto w = make_scope_guard([this, cv]() {
 	  conds.erase(cv);
+	  --waiting;
 	});
       waited = true;
       ldout(cct, 2) << "_wait waiting..." << dendl;
       if (logger)
 	start = mono_clock::now();
 
-      cv->wait(l, [this, c, cv]() { return (!_should_wait(c) &&
-					    cv == conds.begin()); });
+      cv->wait(l, [this, c, cv]() { return (cv == conds.begin() &&
+					    _try_get(c)); });
       ldout(cct, 2) << "_wait finished waiting" << dendl;
       if (logger) {
 	logger->tinc(l_throttle_wait, mono_clock::now() - start);
@@ -164,14 +169,14 @@ bool Throttle::get(int64_t c, int64_t m)
     logger->inc(l_throttle_get_started);
   }
   bool waited = false;
-  {
+  // fast path, nobody to queue behind
+  if (m || waiting || !_try_get(c)) {
     std::unique_lock l(lock);
     if (m) {
       ceph_assert(m > 0);
       _reset_max(m);
     }
     waited = _wait(c, l);
-    count += c;
   }
   if (logger) {
     logger->inc(l_throttle_get);
@@ -192,18 +197,12 @@ bool Throttle::get_or_fail(int64_t c)
   }
 
   assert (c >= 0);
-  bool result = false;
-  {
-    std::lock_guard l(lock);
-    if (_should_wait(c) || !conds.empty()) {
-      ldout(cct, 10) << "get_or_fail " << c << " failed" << dendl;
-      result = false;
-    } else {
-      ldout(cct, 10) << "get_or_fail " << c << " success (" << count.load()
-	<< " -> " << (count.load() + c) << ")" << dendl;
-      count += c;
-      result = true;
-    }
+  bool result = !waiting && _try_get(c);
+  if (result) {
+    ldout(cct, 10) << "get_or_fail " << c << " success (" << count.load() - c
+		   << " -> " << count.load() << ")" << dendl;
+  } else {
+    ldout(cct, 10) << "get_or_fail " << c << " failed" << dendl;
   }
 
   if (logger) {
@@ -229,16 +228,16 @@ int64_t Throttle::put(int64_t c)
   ceph_assert(c >= 0);
   ldout(cct, 10) << "put " << c << " (" << count.load() << " -> "
 		 << (count.load()-c) << ")" << dendl;
-  int64_t new_count;
-  {
-    std::lock_guard l(lock);
-    new_count = count;
-    if (c) {
+  int64_t new_count = count;
+  if (c) {
+    int64_t old_count = count.fetch_sub(c);
+    // if count goes negative, we failed somewhere!
+    ceph_assert(old_count >= c);
+    new_count = old_count - c;
+    if (waiting) {
+      std::lock_guard l(lock);
       if (!conds.empty())
 	conds.front().notify_one();
-      // if count goes negative, we failed somewhere!
-      ceph_assert(count >= c);
-      new_count = count -= c;
     }
   }
   if (logger) {
@@ -389,6 +388,8 @@ bool BackoffThrottle::set_params(
   high_delay_per_count = _high_multiple / _expected_throughput;
   max_delay_per_count = _max_multiple / _expected_throughput;
   max = _throttle_max;
+  no_delay_below = _throttle_max ?
+    uint64_t(low_threshold * _throttle_max) : UINT64_MAX;
 
   if (logger)
     logger->set(l_backoff_throttle_max, max);
@@ -412,12 +413,12 @@ bool BackoffThrottle::set_params(
   return true;
 }
 
-ceph::timespan BackoffThrottle::_get_delay(uint64_t c) const
+ceph::timespan BackoffThrottle::_get_delay(uint64_t c, uint64_t cur) const
 {
   if (max == 0)
     return ceph::timespan(0);
 
-  double r = ((double)current) / ((double)max);
+  double r = ((double)cur) / ((double)max);
   if (r < low_threshold) {
     return ceph::timespan(0);
   } else if (r < high_threshold) {
@@ -429,29 +430,50 @@ ceph::timespan BackoffThrottle::_get_delay(uint64_t c) const
   }
 }
 
-ceph::timespan BackoffThrottle::get(uint64_t c)
+bool BackoffThrottle::_try_get(uint64_t c)
 {
-  locker l(lock);
-  auto delay = _get_delay(c);
+  uint64_t cur = current;
+  do {
+    if (cur >= no_delay_below ||
+	(max != 0 && cur != 0 && (cur + c) > max)) {
+      return false;
+    }
+  } while (!current.compare_exchange_weak(cur, cur + c));
+  return true;
+}
 
+ceph::timespan BackoffThrottle::get(uint64_t c)
+{
   if (logger) {
     logger->inc(l_backoff_throttle_get);
     logger->inc(l_backoff_throttle_get_sum, c);
   }
 
-  // fast path
-  if (delay.count() == 0 &&
-      waiters.empty() &&
-      ((max == 0) || (current == 0) || ((current + c) <= max))) {
-    current += c;
-
+  // lock-free fast path, well below the low threshold and nobody waiting
+  if (!nwaiters && _try_get(c)) {
     if (logger) {
       logger->set(l_backoff_throttle_val, current);
     }
-
     return ceph::make_timespan(0);
   }
 
+  locker l(lock);
+  ceph::timespan delay = timespan::zero();
+
+  // fast path
+  if (waiters.empty()) {
+    uint64_t cur = current;
+    while ((delay = _get_delay(c, cur)).count() == 0 &&
+	   ((max == 0) || (cur == 0) || ((cur + c) <= max))) {
+      if (current.compare_exchange_weak(cur, cur + c)) {
+	if (logger) {
+	  logger->set(l_backoff_throttle_val, current);
+	}
+	return ceph::make_timespan(0);
+      }
+    }
+  }
+
   auto ticket = _push_waiter();
   auto wait_from = mono_clock::now();
   bool waited = false;
@@ -464,13 +486,16 @@ ceph::timespan BackoffThrottle::get(uint64_t c)
   auto start = mono_clock::now();
   delay = _get_delay(c);
   while (true) {
-    if (max != 0 && current != 0 && (current + c) > max) {
+    // we are at the front, so only lock-free getters that raced with
+    // _push_waiter() may still move current under us
+    uint64_t cur = current;
+    if (max != 0 && cur != 0 && (cur + c) > max) {
       (*ticket)->wait(l);
       waited = true;
     } else if (delay.count() > 0) {
       (*ticket)->wait_for(l, delay);
       waited = true;
-    } else {
+    } else if (current.compare_exchange_strong(cur, cur + c)) {
       break;
     }
     ceph_assert(ticket == waiters.begin());
@@ -482,11 +507,9 @@ ceph::timespan BackoffThrottle::get(uint64_t c)
       delay -= elapsed;
     }
   }
-  waiters.pop_front();
+  _pop_waiter();
   _kick_waiters();
 
-  current += c;
-
   if (logger) {
     logger->set(l_backoff_throttle_val, current);
     if (waited) {
@@ -499,18 +522,21 @@ ceph::timespan BackoffThrottle::get(uint64_t c)
 
 uint64_t BackoffThrottle::put(uint64_t c)
 {
-  locker l(lock);
-  ceph_assert(current >= c);
-  current -= c;
-  _kick_waiters();
+  uint64_t old = current.fetch_sub(c);
+  ceph_assert(old >= c);
+  // get() announces itself in nwaiters before checking current again
+  if (nwaiters) {
+    locker l(lock);
+    _kick_waiters();
+  }
 
   if (logger) {
     logger->inc(l_backoff_throttle_put);
     logger->inc(l_backoff_throttle_put_sum, c);
-    logger->set(l_backoff_throttle_val, current);
+    logger->set(l_backoff_throttle_val, old - c);
   }
 
-  return current;
+  return old - c;
 }
 
 uint64_t BackoffThrottle::take(uint64_t c)
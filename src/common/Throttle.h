@@ -36,6 +36,9 @@ class Throttle final : public ThrottleInterface {
   std::atomic<int64_t> count = { 0 }, max = { 0 };
   std::mutex lock;
   std::list<std::condition_variable> conds;
+  /// conds.size(), so that get() and put() only take the lock if there
+  /// is somebody to queue behind or to wake up
+  std::atomic<uint32_t> waiting = { 0 };
   const bool use_perf;
 
 public:
@@ -44,15 +47,26 @@ public:
 
 private:
   void _reset_max(int64_t m);
-  bool _should_wait(int64_t c) const {
+  bool _should_wait(int64_t c, int64_t cur) const {
     int64_t m = max;
-    int64_t cur = count;
     return
       m &&
       ((c <= m && cur + c > m) || // normally stay under max
        (c >= m && cur > m));     // except for large c
   }
 
+  /// take c slots unless that would have to wait, lock-free
+  bool _try_get(int64_t c) {
+    int64_t cur = count;
+    do {
+      if (_should_wait(c, cur)) {
+	return false;
+      }
+    } while (!count.compare_exchange_weak(cur, cur + c));
+    return true;
+  }
+
+  /// take c slots, waiting behind the other waiters if needed
   bool _wait(int64_t c, std::unique_lock<std::mutex>& l);
 
 public:
@@ -170,12 +184,20 @@ class BackoffThrottle {
   /// pointers into conds
   std::list<std::condition_variable*> waiters;
 
+  /// waiters.size(), lets get() and put() skip the lock when zero
+  std::atomic<uint32_t> nwaiters = { 0 };
+
   std::list<std::condition_variable*>::iterator _push_waiter() {
     unsigned next = next_cond++;
     if (next_cond == conds.size())
       next_cond = 0;
+    ++nwaiters;
     return waiters.insert(waiters.end(), &(conds[next]));
   }
+  void _pop_waiter() {
+    waiters.pop_front();
+    --nwaiters;
+  }
 
   void _kick_waiters() {
     if (!waiters.empty())
@@ -195,10 +217,17 @@ class BackoffThrottle {
   double s1 = 0; ///< (m - e)/(1 - h), 1 != h, 0 otherwise
 
   /// max
-  uint64_t max = 0;
-  uint64_t current = 0;
+  std::atomic<uint64_t> max = { 0 };
+  std::atomic<uint64_t> current = { 0 };
+  /// below this no delay is injected, lets get() skip the lock
+  std::atomic<uint64_t> no_delay_below = { UINT64_MAX };
 
-  ceph::timespan _get_delay(uint64_t c) const;
+  ceph::timespan _get_delay(uint64_t c) const {
+    return _get_delay(c, current);
+  }
+  ceph::timespan _get_delay(uint64_t c, uint64_t cur) const;
+  /// take c unless that would be delayed, lock-free
+  bool _try_get(uint64_t c);
 
 public:
   /**
@@ -14,6 +14,7 @@
  */
 
 #include <atomic>
+#include <bit>
 #include <cstring>
 #include <errno.h>
 #include <limits.h>
@@ -86,6 +87,206 @@ static ceph::spinlock debug_lock;
     return buffer_missed_crc;
   }
 
+  static bool buffer_cache_enabled = !get_env_bool("CEPH_BUFFER_NO_CACHE");
+
+namespace {
+  /*
+   * page aligned data buffers of the common I/O sizes are recycled
+   * through per-thread magazines, one per size class, backed by a global
+   * depot of full magazines.  the depot is also the way back for buffers
+   * released by another thread than the one that allocated them, e.g. a
+   * messenger worker reading into a buffer that an OSD shard thread
+   * frees.  idle buffers are accounted to mempool::buffer_cache.  the
+   * per-thread magazines alone would grow with the number of threads, so
+   * all idle buffers together are capped at MAX_CACHED_BYTES; beyond
+   * that freed buffers go straight back to the system.
+   */
+  namespace aligned_buffer_cache {
+    constexpr size_t MIN_CLASS_SIZE = 4096;
+    constexpr unsigned NUM_CLASSES = 5;         // 4K .. 64K
+    constexpr unsigned MAX_ROUNDS = 32;
+    constexpr size_t MAGAZINE_BYTES = 128 * 1024;
+    constexpr unsigned DEPOT_MAGAZINES = 16;    // per class
+    constexpr int64_t MAX_CACHED_BYTES = 64 << 20;
+
+    std::atomic<int64_t> cached_bytes = {0};
+
+    struct magazine {
+      unsigned n = 0;
+      char *bufs[MAX_ROUNDS];
+    };
+
+    struct depot_t {
+      ceph::spinlock lock;
+      std::vector<magazine*> full[NUM_CLASSES];
+      std::vector<magazine*> empty[NUM_CLASSES];
+    };
+
+    depot_t& depot() {
+      // leaked on purpose, exiting threads may still hand magazines back
+      static depot_t *d = new depot_t;
+      return *d;
+    }
+
+    struct thread_cache {
+      magazine *loaded[NUM_CLASSES] = {};
+      magazine *previous[NUM_CLASSES] = {};
+      ~thread_cache();
+    };
+    thread_local thread_cache tcache;
+    thread_local bool tcache_gone = false;
+
+    int size_class(size_t len) {
+      if (len < MIN_CLASS_SIZE || (len & (len - 1))) {
+	return -1;
+      }
+      unsigned cls = std::countr_zero(len) - std::countr_zero(MIN_CLASS_SIZE);
+      return cls < NUM_CLASSES ? cls : -1;
+    }
+
+    unsigned rounds(unsigned cls) {
+      return std::min<size_t>(MAX_ROUNDS,
+			      MAGAZINE_BYTES / (MIN_CLASS_SIZE << cls));
+    }
+
+    void account(unsigned cls, int items) {
+      int64_t bytes = items * int64_t(MIN_CLASS_SIZE << cls);
+      cached_bytes.fetch_add(bytes, std::memory_order_relaxed);
+      mempool::get_pool(mempool::mempool_buffer_cache).adjust_count(
+	items, bytes);
+    }
+
+    magazine *take_empty(unsigned cls) {
+      {
+	auto& d = depot();
+	std::lock_guard l{d.lock};
+	if (!d.empty[cls].empty()) {
+	  magazine *m = d.empty[cls].back();
+	  d.empty[cls].pop_back();
+	  return m;
+	}
+      }
+      return new magazine;
+    }
+
+    void return_empty(unsigned cls, magazine *m) {
+      {
+	auto& d = depot();
+	std::lock_guard l{d.lock};
+	if (d.empty[cls].size() < DEPOT_MAGAZINES) {
+	  d.empty[cls].push_back(m);
+	  return;
+	}
+      }
+      delete m;
+    }
+
+    magazine *take_full(unsigned cls) {
+      auto& d = depot();
+      std::lock_guard l{d.lock};
+      if (d.full[cls].empty()) {
+	return nullptr;
+      }
+      magazine *m = d.full[cls].back();
+      d.full[cls].pop_back();
+      return m;
+    }
+
+    void return_full(unsigned cls, magazine *m) {
+      {
+	auto& d = depot();
+	std::lock_guard l{d.lock};
+	if (d.full[cls].size() < DEPOT_MAGAZINES) {
+	  d.full[cls].push_back(m);
+	  return;
+	}
+      }
+      // depot is full, give the buffers back to the system
+      account(cls, -(int)m->n);
+      while (m->n) {
+	aligned_free(m->bufs[--m->n]);
+      }
+      return_empty(cls, m);
+    }
+
+    thread_cache::~thread_cache() {
+      tcache_gone = true;
+      for (unsigned cls = 0; cls < NUM_CLASSES; ++cls) {
+	for (magazine *m : {loaded[cls], previous[cls]}) {
+	  if (!m) {
+	    continue;
+	  }
+	  if (m->n) {
+	    return_full(cls, m);
+	  } else {
+	    return_empty(cls, m);
+	  }
+	}
+      }
+    }
+
+    char *alloc(size_t len, unsigned align) {
+      int cls = size_class(len);
+      bool cacheable = buffer_cache_enabled && cls >= 0 &&
+	align <= CEPH_PAGE_SIZE && !tcache_gone;
+      if (cacheable) {
+	auto& tc = tcache;
+	magazine *m = tc.loaded[cls];
+	if (!m || m->n == 0) {
+	  if (tc.previous[cls] && tc.previous[cls]->n) {
+	    std::swap(tc.loaded[cls], tc.previous[cls]);
+	  } else if (magazine *full = take_full(cls); full) {
+	    if (tc.previous[cls]) {
+	      return_empty(cls, tc.previous[cls]);
+	    }
+	    tc.previous[cls] = tc.loaded[cls];
+	    tc.loaded[cls] = full;
+	  }
+	  m = tc.loaded[cls];
+	}
+	if (m && m->n) {
+	  account(cls, -1);
+	  return m->bufs[--m->n];
+	}
+	// page align it so it can be cached once freed
+	align = CEPH_PAGE_SIZE;
+      }
+      char *p = nullptr;
+      if (::posix_memalign((void**)(void*)&p, align, len)) {
+	return nullptr;
+      }
+      return p;
+    }
+
+    void free(char *p, size_t len) {
+      int cls = size_class(len);
+      if (!buffer_cache_enabled || cls < 0 ||
+	  (reinterpret_cast<uintptr_t>(p) & ~CEPH_PAGE_MASK) || tcache_gone ||
+	  cached_bytes.load(std::memory_order_relaxed) + int64_t(len) >
+	    MAX_CACHED_BYTES) {
+	aligned_free(p);
+	return;
+      }
+      auto& tc = tcache;
+      magazine *m = tc.loaded[cls];
+      if (!m || m->n == rounds(cls)) {
+	if (tc.previous[cls] && tc.previous[cls]->n < rounds(cls)) {
+	  std::swap(tc.loaded[cls], tc.previous[cls]);
+	} else {
+	  if (tc.previous[cls]) {
+	    return_full(cls, tc.previous[cls]);
+	  }
+	  tc.previous[cls] = tc.loaded[cls];
+	  tc.loaded[cls] = take_empty(cls);
+	}
+	m = tc.loaded[cls];
+      }
+      m->bufs[m->n++] = p;
+      account(cls, 1);
+    }
+  }
+}
+
   /*
    * raw_combined is always placed within a single allocation along
    * with the data buffer.  the data goes at the beginning, and
@@ -203,18 +404,17 @@ static ceph::spinlock debug_lock;
 
 #ifndef __CYGWIN__
   class buffer::raw_posix_aligned : public buffer::raw {
+    const unsigned alloc_len;  // len may change, the allocation doesn't
   public:
     MEMPOOL_CLASS_HELPERS();
 
-    raw_posix_aligned(unsigned l, unsigned align) : raw(l) {
+    raw_posix_aligned(unsigned l, unsigned align) : raw(l), alloc_len(l) {
       // posix_memalign() requires a multiple of sizeof(void *)
       align = std::max<unsigned>(align, sizeof(void *));
 #ifdef DARWIN
       data = (char *) valloc(len);
 #else
-      int r = ::posix_memalign((void**)(void*)&data, align, len);
-      if (r)
-	throw bad_alloc();
+      data = aligned_buffer_cache::alloc(len, align);
 #endif /* DARWIN */
       if (!data)
 	throw bad_alloc();
@@ -222,7 +422,11 @@ static ceph::spinlock debug_lock;
 	    << " l=" << l << ", align=" << align << bendl;
     }
     ~raw_posix_aligned() override {
+#ifdef DARWIN
       aligned_free(data);
+#else
+      aligned_buffer_cache::free(data, alloc_len);
+#endif /* DARWIN */
       bdout << "raw_posix_aligned " << this << " free " << (void *)data << bendl;
     }
   };
@@ -283,6 +487,86 @@ static ceph::spinlock debug_lock;
     ~raw_claim_buffer() override {}
   };
 
+  /*
+   * arena chunk header.  the raws carved out of the chunk follow it in
+   * the same allocation, each control block right before its data.
+   */
+  class buffer::arena::chunk {
+  public:
+    ceph::atomic<unsigned> nref { 1 };  // the arena's own reference
+    const unsigned size;                // bytes available after the header
+    unsigned used = 0;
+
+    static size_t header_len() {
+      return round_up_to(sizeof(chunk), alignof(std::max_align_t));
+    }
+    static chunk* create(unsigned size) {
+      void *ptr = ::malloc(header_len() + size);
+      if (!ptr)
+	throw bad_alloc();
+      return new (ptr) chunk(size);
+    }
+    char *base() {
+      return reinterpret_cast<char*>(this) + header_len();
+    }
+    void put() {
+      if (--nref == 0) {
+	this->~chunk();
+	::free(this);
+      }
+    }
+
+  private:
+    explicit chunk(unsigned s) : size(s) {}
+  };
+
+  class buffer::raw_arena : public buffer::raw {
+    arena::chunk *c;
+  public:
+    raw_arena(char *dataptr, unsigned l, int mempool, arena::chunk *c)
+      : raw(dataptr, l, mempool), c(c) {
+      ++c->nref;
+    }
+
+    // the memory belongs to the chunk, drop our reference on it instead
+    static void operator delete(raw_arena *raw, std::destroying_delete_t) {
+      arena::chunk *c = raw->c;
+      raw->~raw_arena();
+      c->put();
+    }
+  };
+
+  buffer::arena::arena(unsigned chunk_size)
+    : arena(chunk_size, mempool::mempool_buffer_anon) {
+  }
+  buffer::arena::arena(unsigned chunk_size, int mempool)
+    : chunk_size(chunk_size), mempool(mempool) {
+  }
+  buffer::arena::~arena() {
+    if (cur) {
+      cur->put();
+    }
+  }
+
+  ceph::unique_leakable_ptr<buffer::raw> buffer::arena::create(unsigned len)
+  {
+    const size_t rawlen = round_up_to(sizeof(raw_arena), alignof(raw_arena));
+    const size_t need = rawlen + round_up_to(len, alignof(raw_arena));
+    if (need > chunk_size) {
+      return raw_combined::create(len, 0, mempool);
+    }
+    if (!cur || cur->size - cur->used < need) {
+      if (cur) {
+	cur->put();
+      }
+      cur = chunk::create(chunk_size);
+    }
+    char *ptr = cur->base() + cur->used;
+    cur->used += need;
+    return ceph::unique_leakable_ptr<buffer::raw>(
+      new (ptr) raw_arena(ptr + rawlen, len, mempool, cur));
+  }
+
   ceph::unique_leakable_ptr<buffer::raw> buffer::copy(const char *c, unsigned len) {
     auto r = buffer::create_aligned(len, sizeof(size_t));
     memcpy(r->get_data(), c, len);
@@ -621,6 +905,13 @@ static ceph::spinlock debug_lock;
     maybe_inline_memcpy(dest, src, l, 64);
   }
 
+  void buffer::ptr::set_crc32c(uint32_t base, uint32_t crc)
+  {
+    ceph_assert(_raw);
+    _raw->set_crc(std::make_pair(_off, _off + _len),
+                  std::make_pair(base, crc));
+  }
+
   void buffer::ptr::zero(bool crc_reset)
   {
     if (crc_reset)
@@ -1280,7 +1571,22 @@ static ceph::spinlock debug_lock;
   void buffer::list::reserve(size_t prealloc)
   {
     if (get_append_buffer_unused_tail_length() < prealloc) {
-      auto ptr = ptr_node::create(buffer::create_small_page_aligned(prealloc));
+      // tiny reservations don't benefit from alignment, keep the data
+      // in the same allocation as its raw
+      auto ptr = ptr_node::create(prealloc < CEPH_PAGE_SIZE ?
+	raw_combined::create(prealloc, 0, get_mempool()) :
+	buffer::create_small_page_aligned(prealloc));
+      ptr->set_length(0);   // unused, so far.
+      _carriage = ptr.get();
+      _buffers.push_back(*ptr.release());
+      _num += 1;
+    }
+  }
+
+  void buffer::list::reserve(size_t prealloc, arena& a)
+  {
+    if (get_append_buffer_unused_tail_length() < prealloc) {
+      auto ptr = ptr_node::create(a.create(prealloc));
       ptr->set_length(0);   // unused, so far.
       _carriage = ptr.get();
       _buffers.push_back(*ptr.release());
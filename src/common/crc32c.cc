@@ -1,6 +1,8 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
 // vim: ts=8 sw=2 sts=2 expandtab
 
+#include <cstring>
+
 #include "include/crc32c.h"
 #include "arch/probe.h"
 #include "arch/intel.h"
@@ -263,3 +265,18 @@ uint32_t ceph_crc32c_zeros(uint32_t crc, unsigned len)
     crc = ceph_crc32c(crc, nullptr, remainder);
   return crc;
 }
+
+uint32_t ceph_crc32c_copy(uint32_t crc, unsigned char *dst,
+                          unsigned char const *src, unsigned length)
+{
+  static constexpr unsigned chunk = 8192;
+  while (length > 0) {
+    unsigned len = length < chunk ? length : chunk;
+    memcpy(dst, src, len);
+    crc = ceph_crc32c_func(crc, dst, len);
+    dst += len;
+    src += len;
+    length -= len;
+  }
+  return crc;
+}
@@ -261,3 +261,18 @@ int set_cpu_affinity_all_threads(size_t cpu_set_size,
 }
 
 #endif
+
+int pick_numa_node(int store_node, int front_node, int back_node,
+		   bool auto_affinity, bool prefer_storage, int forced_node)
+{
+  if (forced_node >= 0) {
+    return forced_node;
+  }
+  if (store_node < 0) {
+    return -1;
+  }
+  if (auto_affinity && front_node == store_node && back_node == store_node) {
+    return store_node;
+  }
+  return prefer_storage ? store_node : -1;
+}
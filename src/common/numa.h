@@ -26,3 +26,15 @@ int get_numa_node_cpu_set(int node,
 
 int set_cpu_affinity_all_threads(size_t cpu_set_size,
 				 cpu_set_t *cpu_set);
+
+/**
+ * pick the numa node a daemon should bind to
+ *
+ * A forced node (>= 0) always wins.  Otherwise the storage node is used
+ * if auto_affinity is set and both networks are on it too, or, when
+ * prefer_storage is set, regardless of where the networks are.
+ *
+ * @return the node, or -1 to leave the affinity alone
+ */
+int pick_numa_node(int store_node, int front_node, int back_node,
+		   bool auto_affinity, bool prefer_storage, int forced_node);
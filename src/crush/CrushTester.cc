@@ -18,6 +18,7 @@
 #include "CrushTreeDumper.h"
 #include "common/ceph_context.h"
 #include "include/ceph_features.h"
+#include "common/ceph_time.h"
 #include "common/debug.h"
 
 #define dout_subsys ceph_subsys_crush
@@ -784,3 +785,82 @@ int CrushTester::compare(CrushWrapper& crush2)
   }
   return ret;
 }
+
+int CrushTester::compare_simd()
+{
+  if (min_rule < 0 || max_rule < 0) {
+    min_rule = 0;
+    max_rule = crush.get_max_rules() - 1;
+  }
+  if (min_x < 0 || max_x < 0) {
+    min_x = 0;
+    max_x = 1023;
+  }
+
+  vector<__u32> weight;
+  for (int o = 0; o < crush.get_max_devices(); o++) {
+    if (device_weight.count(o)) {
+      weight.push_back(device_weight[o]);
+    } else if (crush.check_item_present(o)) {
+      weight.push_back(0x10000);
+    } else {
+      weight.push_back(0);
+    }
+  }
+  adjust_weights(weight);
+
+  vector<int> xs;
+  for (int x = min_x; x <= max_x; ++x) {
+    xs.push_back(x);
+  }
+
+  int ret = 0;
+  for (int r = min_rule; r < crush.get_max_rules() && r <= max_rule; r++) {
+    if (!crush.rule_exists(r)) {
+      if (output_statistics)
+        err << "rule " << r << " dne" << std::endl;
+      continue;
+    }
+    int bad = 0;
+    ceph::timespan batch_time = ceph::timespan::zero();
+    ceph::timespan scalar_time = ceph::timespan::zero();
+    for (int nr = min_rep; nr <= max_rep; nr++) {
+      vector<vector<int>> out;
+      auto start = ceph::mono_clock::now();
+      crush.do_rule_batch(r, xs, out, nr, weight, 0);
+      batch_time += ceph::mono_clock::now() - start;
+
+      int old = crush_hash_set_simd(0);
+      start = ceph::mono_clock::now();
+      vector<vector<int>> out2(xs.size());
+      for (size_t i = 0; i < xs.size(); ++i) {
+	crush.do_rule(r, xs[i], out2[i], nr, weight, 0);
+      }
+      scalar_time += ceph::mono_clock::now() - start;
+      crush_hash_set_simd(old);
+
+      for (size_t i = 0; i < xs.size(); ++i) {
+	if (out[i] != out2[i]) {
+	  ++bad;
+	  if (output_bad_mappings) {
+	    err << "rule " << r << " x " << xs[i] << " num_rep " << nr
+		<< " batch " << out[i] << " scalar " << out2[i] << std::endl;
+	  }
+	}
+      }
+    }
+    if (bad) {
+      ret = -1;
+    }
+    int max = (max_rep - min_rep + 1) * (max_x - min_x + 1);
+    cout << "rule " << r << " had " << bad << "/" << max
+	 << " mismatched mappings, batch " << batch_time
+	 << " scalar " << scalar_time << std::endl;
+  }
+  if (ret) {
+    cerr << "warning: batch and scalar mappings differ" << std::endl;
+  } else {
+    cout << "batch and scalar mappings are identical" << std::endl;
+  }
+  return ret;
+}
@@ -361,6 +361,13 @@ public:
   int test_with_fork(CephContext* cct, int timeout);
 
   int compare(CrushWrapper& other);
+  /**
+   * map the --test inputs with the batch/SIMD mapper and with the scalar
+   * one, and report the mismatches and the time both took
+   *
+   * @return 0 if all the mappings are identical, -1 otherwise
+   */
+  int compare_simd();
 };
 
 #endif
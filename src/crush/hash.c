@@ -140,6 +140,133 @@ __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d, __u32 e)
 	}
 }
 
+#ifndef __KERNEL__
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+# include <immintrin.h>
+# define CRUSH_HASH_AVX2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+# define CRUSH_HASH_NEON
+#endif
+
+/*
+ * meant to be flipped by tests and tools comparing the SIMD and scalar
+ * paths; both give the same results, so a concurrent mapping only sees
+ * a change of path, but the flag is accessed atomically all the same.
+ */
+static int crush_hash_simd = 1;
+
+int crush_hash_set_simd(int enable)
+{
+	return __atomic_exchange_n(&crush_hash_simd, enable, __ATOMIC_RELAXED);
+}
+
+int crush_hash_get_simd(void)
+{
+	return __atomic_load_n(&crush_hash_simd, __ATOMIC_RELAXED);
+}
+
+/* crush_hashmix() on vectors of 32 bit lanes */
+#define crush_hashmix_vec(a, b, c, SUB, XOR, SRL, SLL) do {	\
+		a = SUB(a, b);  a = SUB(a, c);  a = XOR(a, SRL(c, 13));	\
+		b = SUB(b, c);  b = SUB(b, a);  b = XOR(b, SLL(a, 8));	\
+		c = SUB(c, a);  c = SUB(c, b);  c = XOR(c, SRL(b, 13));	\
+		a = SUB(a, b);  a = SUB(a, c);  a = XOR(a, SRL(c, 12));	\
+		b = SUB(b, c);  b = SUB(b, a);  b = XOR(b, SLL(a, 16));	\
+		c = SUB(c, a);  c = SUB(c, b);  c = XOR(c, SRL(b, 5));	\
+		a = SUB(a, b);  a = SUB(a, c);  a = XOR(a, SRL(c, 3));	\
+		b = SUB(b, c);  b = SUB(b, a);  b = XOR(b, SLL(a, 10));	\
+		c = SUB(c, a);  c = SUB(c, b);  c = XOR(c, SRL(b, 15));	\
+	} while (0)
+
+#ifdef CRUSH_HASH_AVX2
+#define crush_hashmix_avx2(a, b, c)					\
+	crush_hashmix_vec(a, b, c, _mm256_sub_epi32, _mm256_xor_si256,	\
+			  _mm256_srli_epi32, _mm256_slli_epi32)
+
+/* returns the number of hashes computed, a multiple of 8 */
+__attribute__((__target__("avx2")))
+static unsigned crush_hash32_rjenkins1_3_avx2(__u32 a, const __s32 *b,
+					      __u32 c, __u32 *out, unsigned n)
+{
+	const __m256i va = _mm256_set1_epi32(a);
+	const __m256i vc = _mm256_set1_epi32(c);
+	const __m256i seed = _mm256_set1_epi32(crush_hash_seed ^ a ^ c);
+	const __m256i vx = _mm256_set1_epi32(231232);
+	const __m256i vy = _mm256_set1_epi32(1232);
+	unsigned i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256i bb = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i hash = _mm256_xor_si256(seed, bb);
+		__m256i aa = va, cc = vc, x = vx, y = vy;
+		crush_hashmix_avx2(aa, bb, hash);
+		crush_hashmix_avx2(cc, x, hash);
+		crush_hashmix_avx2(y, aa, hash);
+		crush_hashmix_avx2(bb, x, hash);
+		crush_hashmix_avx2(y, cc, hash);
+		_mm256_storeu_si256((__m256i *)(out + i), hash);
+	}
+	return i;
+}
+#endif
+
+#ifdef CRUSH_HASH_NEON
+#define crush_hashmix_neon(a, b, c)				\
+	crush_hashmix_vec(a, b, c, vsubq_u32, veorq_u32,	\
+			  vshrq_n_u32, vshlq_n_u32)
+
+/* returns the number of hashes computed, a multiple of 4 */
+static unsigned crush_hash32_rjenkins1_3_neon(__u32 a, const __s32 *b,
+					      __u32 c, __u32 *out, unsigned n)
+{
+	const uint32x4_t va = vdupq_n_u32(a);
+	const uint32x4_t vc = vdupq_n_u32(c);
+	const uint32x4_t seed = vdupq_n_u32(crush_hash_seed ^ a ^ c);
+	const uint32x4_t vx = vdupq_n_u32(231232);
+	const uint32x4_t vy = vdupq_n_u32(1232);
+	unsigned i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		uint32x4_t bb = vld1q_u32((const uint32_t *)(b + i));
+		uint32x4_t hash = veorq_u32(seed, bb);
+		uint32x4_t aa = va, cc = vc, x = vx, y = vy;
+		crush_hashmix_neon(aa, bb, hash);
+		crush_hashmix_neon(cc, x, hash);
+		crush_hashmix_neon(y, aa, hash);
+		crush_hashmix_neon(bb, x, hash);
+		crush_hashmix_neon(y, cc, hash);
+		vst1q_u32(out + i, hash);
+	}
+	return i;
+}
+#endif
+
+void crush_hash32_3_batch(int type, __u32 a, const __s32 *b, __u32 c,
+			  __u32 *out, unsigned n)
+{
+	unsigned i = 0;
+
+	if (type != CRUSH_HASH_RJENKINS1) {
+		for (; i < n; i++)
+			out[i] = crush_hash32_3(type, a, b[i], c);
+		return;
+	}
+	if (crush_hash_get_simd()) {
+#if defined(CRUSH_HASH_AVX2)
+		if (__builtin_cpu_supports("avx2"))
+			i = crush_hash32_rjenkins1_3_avx2(a, b, c, out, n);
+#elif defined(CRUSH_HASH_NEON)
+		i = crush_hash32_rjenkins1_3_neon(a, b, c, out, n);
+#endif
+	}
+	for (; i < n; i++)
+		out[i] = crush_hash32_rjenkins1_3(a, b[i], c);
+}
+
+#endif /* __KERNEL__ */
+
 const char *crush_hash_name(int type)
 {
 	switch (type) {
@@ -20,4 +20,23 @@ extern __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d);
 extern __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d,
 			    __u32 e);
 
+#ifndef __KERNEL__
+/*
+ * out[i] = crush_hash32_3(type, a, b[i], c) for i in [0, n), using SIMD
+ * (AVX2 or NEON) where available.  The result is bit identical to the
+ * scalar function.
+ */
+extern void crush_hash32_3_batch(int type, __u32 a, const __s32 *b, __u32 c,
+				 __u32 *out, unsigned n);
+
+/*
+ * Enable (the default) or disable the SIMD code paths, e.g. to verify
+ * them against the scalar ones.  This also turns off the batched straw2
+ * chooser, so that mappings go through the original scalar loop.  Meant
+ * for tests and tools.  Returns the previous setting.
+ */
+extern int crush_hash_set_simd(int enable);
+extern int crush_hash_get_simd(void);
+#endif
+
 #endif
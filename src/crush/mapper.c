@@ -312,10 +312,8 @@ static inline __s32 *get_choose_arg_ids(const struct crush_bucket_straw2 *bucket
  * for reference, see the exponential distribution example at:  
  * https://en.wikipedia.org/wiki/Inverse_transform_sampling#Examples
  */
-static inline __s64 generate_exponential_distribution(int type, int x, int y, int z, 
-                                                      int weight)
+static inline __s64 exponential_draw(unsigned int u, int weight)
 {
-	unsigned int u = crush_hash32_3(type, x, y, z);
 	u &= 0xffff;
 
 	/*
@@ -339,6 +337,48 @@ static inline __s64 generate_exponential_distribution(int type, int x, int y, in
 	return div64_s64(ln, weight);
 }
 
+static inline __s64 generate_exponential_distribution(int type, int x, int y, int z, 
+                                                      int weight)
+{
+	return exponential_draw(crush_hash32_3(type, x, y, z), weight);
+}
+
+#ifndef __KERNEL__
+/*
+ * straw2 for larger buckets: hash the items in chunks with
+ * crush_hash32_3_batch() (SIMD), then do the ln lookups and divisions
+ * over the chunk.  Picks exactly the same item as the loop below.
+ */
+#define CRUSH_STRAW2_BATCH_MIN 8
+#define CRUSH_STRAW2_BATCH 64
+
+static int bucket_straw2_choose_batch(const struct crush_bucket_straw2 *bucket,
+				      int x, int r, const __u32 *weights,
+				      const __s32 *ids)
+{
+	__u32 u[CRUSH_STRAW2_BATCH];
+	unsigned int i, j, n, high = 0;
+	__s64 draw, high_draw = 0;
+
+	for (i = 0; i < bucket->h.size; i += n) {
+		n = MIN(bucket->h.size - i, CRUSH_STRAW2_BATCH);
+		crush_hash32_3_batch(bucket->h.hash, x, ids + i, r, u, n);
+		for (j = 0; j < n; j++) {
+			if (weights[i + j]) {
+				draw = exponential_draw(u[j], weights[i + j]);
+			} else {
+				draw = S64_MIN;
+			}
+			if (i + j == 0 || draw > high_draw) {
+				high = i + j;
+				high_draw = draw;
+			}
+		}
+	}
+	return bucket->h.items[high];
+}
+#endif
+
 static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 				int x, int r, const struct crush_choose_arg *arg,
                                 int position)
@@ -347,6 +387,10 @@ static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 	__s64 draw, high_draw = 0;
         __u32 *weights = get_choose_arg_weights(bucket, arg, position);
         __s32 *ids = get_choose_arg_ids(bucket, arg);
+#ifndef __KERNEL__
+	if (bucket->h.size >= CRUSH_STRAW2_BATCH_MIN && crush_hash_get_simd())
+		return bucket_straw2_choose_batch(bucket, x, r, weights, ids);
+#endif
 	for (i = 0; i < bucket->h.size; i++) {
                 dprintk("weight 0x%x item %d\n", weights[i], ids[i]);
 		if (weights[i]) {
@@ -2051,3 +2095,34 @@ int crush_do_rule(const struct crush_map *map,
 			choose_args);
 	}
 }
+
+/**
+ * crush_do_rule_batch - calculate the mappings of many inputs
+ * @map: the crush_map
+ * @ruleno: the rule id
+ * @x: hash inputs
+ * @num_x: number of inputs
+ * @result: num_x * result_max results, the ones of x[i] start at
+ *          result + i * result_max
+ * @result_max: maximum result size
+ * @result_len: num_x result sizes
+ * @weight: weight vector (for map leaves)
+ * @weight_max: size of weight vector
+ * @cwin: Pointer to at least map->working_size bytes of memory or NULL.
+ */
+int crush_do_rule_batch(const struct crush_map *map,
+			int ruleno, const int *x, int num_x,
+			int *result, int result_max, int *result_len,
+			const __u32 *weight, int weight_max,
+			void *cwin, const struct crush_choose_arg *choose_args)
+{
+	int i;
+
+	for (i = 0; i < num_x; i++) {
+		result_len[i] = crush_do_rule(map, ruleno, x[i],
+					      result + i * result_max,
+					      result_max, weight, weight_max,
+					      cwin, choose_args);
+	}
+	return num_x;
+}
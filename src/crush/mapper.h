@@ -94,6 +94,23 @@ extern int crush_do_rule(const struct crush_map *map,
 			 const __u32 *weights, int weight_max,
 			 void *cwin, const struct crush_choose_arg *choose_args);
 
+/** @ingroup API
+ *
+ * Map each of the __num_x__ inputs in __x__ as crush_do_rule() does,
+ * reusing the workspace __cwin__ for all of them. The items x[i] maps
+ * to are stored at __result__ + i * __result_max__, their number in
+ * __result_len__[i].
+ *
+ * @return the number of inputs mapped
+ */
+extern int crush_do_rule_batch(const struct crush_map *map,
+			       int ruleno,
+			       const int *x, int num_x,
+			       int *result, int result_max, int *result_len,
+			       const __u32 *weights, int weight_max,
+			       void *cwin,
+			       const struct crush_choose_arg *choose_args);
+
 /* Returns enough workspace for any crush rule within map to generate
    result_max outputs. The caller can then allocate this much on its own,
    either on the stack, in a per-thread long-lived buffer, or however it likes.*/
@@ -132,6 +132,7 @@ struct error_code;
   class raw_combined;
   class raw_zeros;
   class raw_claim_buffer;
+  class raw_arena;
 
 
   /*
@@ -161,6 +162,34 @@ struct error_code;
   ceph::unique_leakable_ptr<buffer::raw> create_local(seastar::temporary_buffer<char>&& buf);
 #endif
 
+  /*
+   * a bump allocator for short lived buffers, e.g. the temporary encodes
+   * of a single op.  raws are carved out of larger chunks, control block
+   * included, so a burst of tiny buffers costs one allocation per chunk
+   * instead of one per buffer.  a chunk is freed once the arena moved
+   * past it and all raws carved out of it are released; a long lived raw
+   * therefore pins its whole chunk.  not thread safe, but the raws may be
+   * released from any thread.
+   */
+  class CEPH_BUFFER_API arena {
+  public:
+    class chunk;
+
+    explicit arena(unsigned chunk_size = 65536);
+    arena(unsigned chunk_size, int mempool);
+    ~arena();
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    /// raws larger than a chunk are allocated from the heap as usual
+    ceph::unique_leakable_ptr<raw> create(unsigned len);
+
+  private:
+    chunk *cur = nullptr;
+    unsigned chunk_size;
+    int mempool;
+  };
+
   /*
    * a buffer pointer.  references (a subsequence of) a raw buffer.
    */
@@ -337,6 +366,8 @@ struct error_code;
     }
 #endif // __cplusplus >= 201703L
     void copy_in(unsigned o, unsigned l, const char *src, bool crc_reset = true);
+    /// remember crc32c(base, contents) so list::crc32c() needn't compute it
+    void set_crc32c(uint32_t base, uint32_t crc);
     void zero(bool crc_reset = true);
     void zero(unsigned o, unsigned l, bool crc_reset = true);
     unsigned append_zeros(unsigned l);
@@ -957,6 +988,12 @@ struct error_code;
         _num(0) {
       reserve(prealloc);
     }
+    list(unsigned prealloc, arena& a)
+      : _carriage(&always_empty_bptr),
+        _len(0),
+        _num(0) {
+      reserve(prealloc, a);
+    }
 
     list(const list& other)
       : _carriage(&always_empty_bptr),
@@ -1098,6 +1135,7 @@ struct error_code;
     bool rebuild_page_aligned();
 
     void reserve(size_t prealloc);
+    void reserve(size_t prealloc, arena& a);
 
     [[deprecated("in favor of operator=(list&&)")]] void claim(list& bl) {
       *this = std::move(bl);
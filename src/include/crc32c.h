@@ -30,6 +30,20 @@ extern ceph_crc32c_func_t ceph_choose_crc32(void);
  */
 uint32_t ceph_crc32c_zeros(uint32_t crc, unsigned length);
 
+/**
+ * copy a buffer and calculate the crc32c of it in the same pass
+ *
+ * The data is copied and checksummed in cache sized chunks, so it is
+ * only read from memory once.
+ *
+ * @param crc initial value
+ * @param dst destination buffer, at least length bytes
+ * @param src source buffer
+ * @param length length of buffer
+ */
+uint32_t ceph_crc32c_copy(uint32_t crc, unsigned char *dst,
+			  unsigned char const *src, unsigned length);
+
 /**
  * calculate crc32c
  *
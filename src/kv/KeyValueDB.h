@@ -195,6 +195,16 @@ public:
     return submit_transaction(t);
   }
 
+  /// Combine a group of transactions, in order, into a single one.
+  /// Writes that are overridden by a later set() of the same key within
+  /// the group are left out. Returns nullptr if nothing would be saved
+  /// or the backend does not support it; the caller then submits the
+  /// transactions one by one.
+  virtual Transaction coalesce_transactions(
+    const std::vector<Transaction>& ts) {
+    return nullptr;
+  }
+
   /// Retrieve Keys
   virtual int get(
     const std::string &prefix,               ///< [in] Prefix/CF for key
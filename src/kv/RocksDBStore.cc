@@ -2,6 +2,7 @@
 // vim: ts=8 sw=2 sts=2 expandtab
 
 #include <filesystem>
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <set>
@@ -644,6 +645,7 @@ void RocksDBStore::add_column_family(const std::string& cf_name, uint32_t hash_l
     column.handles.resize(shard_idx + 1);
   column.handles[shard_idx] = handle;
   cf_ids_to_prefix.emplace(handle->GetID(), cf_name);
+  cf_ids_to_handle[handle->GetID()] = handle;
 }
 
 bool RocksDBStore::is_column_family(const std::string& prefix) {
@@ -835,6 +837,10 @@ int RocksDBStore::create_shards(const rocksdb::Options& opt,
     if (r != 0) {
       return r;
     }
+    r = apply_column_family_profile(p.name, &cf_opt);
+    if (r != 0) {
+      return r;
+    }
     for (size_t idx = 0; idx < p.shard_cnt; idx++) {
       std::string cf_name;
       if (p.shard_cnt == 1)
@@ -964,6 +970,38 @@ int RocksDBStore::update_column_family_options(const std::string& base_name,
   return 0;
 }
 
+// Applies options selected for column family base_name by rocksdb_cf_options.
+// Unlike the options stored with the sharding definition they are taken
+// from config on every open, so a column family can be retuned (block
+// size, filters, compression...) without resharding; new settings take
+// effect for files written from then on.
+int RocksDBStore::apply_column_family_profile(const std::string& base_name,
+					      rocksdb::ColumnFamilyOptions* cf_opt)
+{
+  std::string profiles = cct->_conf.get_val<std::string>("rocksdb_cf_options");
+  if (profiles.empty()) {
+    return 0;
+  }
+  std::vector<ColumnFamily> profile_def;
+  char const* error_position = nullptr;
+  std::string error_msg;
+  if (!parse_sharding_def(profiles, profile_def, &error_position, &error_msg)) {
+    derr << __func__ << " bad rocksdb_cf_options: " << dendl;
+    derr << __func__ << profiles << dendl;
+    derr << __func__ << std::string(error_position - &profiles[0], ' ') << "^"
+	 << error_msg << dendl;
+    return -EINVAL;
+  }
+  for (auto& p : profile_def) {
+    if (p.name == base_name && !p.options.empty()) {
+      dout(5) << __func__ << " column family " << base_name
+	      << " options " << p.options << dendl;
+      return update_column_family_options(base_name, p.options, cf_opt);
+    }
+  }
+  return 0;
+}
+
 int RocksDBStore::apply_block_cache_options(const std::string& column_name,
 					    const std::string& block_cache_opt,
 					    rocksdb::ColumnFamilyOptions* cf_opt)
@@ -1039,6 +1077,7 @@ int RocksDBStore::apply_block_cache_options(const std::string& column_name,
 }
 
 int RocksDBStore::verify_sharding(const rocksdb::Options& opt,
+				  const std::string& requested_sharding_text,
 				  std::vector<rocksdb::ColumnFamilyDescriptor>& existing_cfs,
 				  std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> >& existing_cfs_shard,
 				  std::vector<rocksdb::ColumnFamilyDescriptor>& missing_cfs,
@@ -1067,6 +1106,29 @@ int RocksDBStore::verify_sharding(const rocksdb::Options& opt,
   std::sort(stored_sharding_def.begin(), stored_sharding_def.end(),
 	    [](ColumnFamily& a, ColumnFamily& b) { return a.name < b.name; } );
 
+  // the stored layout always wins, there is no online migration between
+  // column families: make it visible when the requested one differs
+  std::vector<ColumnFamily> requested_sharding_def;
+  if (!requested_sharding_text.empty() &&
+      parse_sharding_def(requested_sharding_text, requested_sharding_def)) {
+    std::sort(requested_sharding_def.begin(), requested_sharding_def.end(),
+	      [](ColumnFamily& a, ColumnFamily& b) { return a.name < b.name; } );
+    bool same_layout = std::equal(
+      stored_sharding_def.begin(), stored_sharding_def.end(),
+      requested_sharding_def.begin(), requested_sharding_def.end(),
+      [](const ColumnFamily& a, const ColumnFamily& b) {
+	return a.name == b.name && a.shard_cnt == b.shard_cnt &&
+	  a.hash_l == b.hash_l && a.hash_h == b.hash_h;
+      });
+    if (!same_layout) {
+      derr << __func__ << " WARNING: requested sharding '"
+	   << requested_sharding_text << "' differs from the stored one '"
+	   << stored_sharding_text << "', which stays in use. Column families"
+	   << " are only moved by an offline 'ceph-bluestore-tool reshard',"
+	   << " rocksdb_cf_options retunes the existing ones" << dendl;
+    }
+  }
+
   std::vector<string> rocksdb_cfs;
   status = rocksdb::DB::ListColumnFamilies(rocksdb::DBOptions(opt),
 					   path, &rocksdb_cfs);
@@ -1095,6 +1157,10 @@ int RocksDBStore::verify_sharding(const rocksdb::Options& opt,
     if (r != 0) {
       return r;
     }
+    r = apply_column_family_profile(column.name, &cf_opt);
+    if (r != 0) {
+      return r;
+    }
     if (column.shard_cnt == 1) {
       emplace_cf(column, 0, column.name, cf_opt);
     } else {
@@ -1165,7 +1231,7 @@ int RocksDBStore::do_open(ostream &out,
     std::vector<rocksdb::ColumnFamilyDescriptor> missing_cfs;
     std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> > missing_cfs_shard;
 
-    r = verify_sharding(opt,
+    r = verify_sharding(opt, sharding_text,
 			existing_cfs, existing_cfs_shard,
 			missing_cfs, missing_cfs_shard);
     if (r < 0) {
@@ -1333,6 +1399,7 @@ void RocksDBStore::close()
     }
   }
   cf_handles.clear();
+  cf_ids_to_handle.clear();
   if (must_close_default_cf) {
     db->DestroyColumnFamilyHandle(default_cf);
     must_close_default_cf = false;
@@ -1413,6 +1480,18 @@ bool RocksDBStore::get_property(
   return db->GetIntProperty(property, out);
 }
 
+int RocksDBStore::get_column_family_options(
+  const std::string& prefix,
+  rocksdb::ColumnFamilyOptions *out)
+{
+  auto p = cf_handles.find(prefix);
+  if (p == cf_handles.end() || p->second.handles.empty()) {
+    return -ENOENT;
+  }
+  *out = db->GetOptions(p->second.handles[0]);
+  return 0;
+}
+
 int64_t RocksDBStore::estimate_prefix_size(const string& prefix,
 					   const string& key_prefix)
 {
@@ -1625,6 +1704,188 @@ int RocksDBStore::submit_transaction_sync(KeyValueDB::Transaction t)
   return result;
 }
 
+/// Cheap first pass of coalesce_transactions(): hashes the column family
+/// and key of every Put, so that a group in which no key is written
+/// twice is recognized without building a key string per operation.
+class RocksWBPutHasher : public rocksdb::WriteBatch::Handler
+{
+  std::vector<size_t> hashes;
+
+public:
+  /// false if no two Puts of the group can be of the same key
+  bool may_overlap() {
+    std::sort(hashes.begin(), hashes.end());
+    return std::adjacent_find(hashes.begin(), hashes.end()) != hashes.end();
+  }
+
+  rocksdb::Status PutCF(uint32_t column_family_id, const rocksdb::Slice& key,
+			const rocksdb::Slice& value) override {
+    hashes.push_back(
+      std::hash<std::string_view>{}(std::string_view(key.data(), key.size())) ^
+      column_family_id);
+    return rocksdb::Status::OK();
+  }
+  rocksdb::Status MergeCF(uint32_t column_family_id, const rocksdb::Slice& key,
+			  const rocksdb::Slice& value) override {
+    return rocksdb::Status::OK();
+  }
+  rocksdb::Status DeleteCF(uint32_t column_family_id,
+			   const rocksdb::Slice& key) override {
+    return rocksdb::Status::OK();
+  }
+  rocksdb::Status SingleDeleteCF(uint32_t column_family_id,
+				 const rocksdb::Slice& key) override {
+    return rocksdb::Status::OK();
+  }
+  rocksdb::Status DeleteRangeCF(uint32_t column_family_id,
+				const rocksdb::Slice& begin_key,
+				const rocksdb::Slice& end_key) override {
+    return rocksdb::Status::OK();
+  }
+  bool Continue() override {
+    return true;
+  }
+};
+
+/// Two pass WriteBatch rewriter used by coalesce_transactions().
+/// The scan pass records the position of the last Put of every key, the
+/// emit pass copies all operations into a new batch except those that
+/// such a later Put overrides. SingleDelete and DeleteRange are always
+/// kept: the former must keep matching a single Put, the latter is never
+/// overridden as a whole.
+class RocksWBCoalescer : public rocksdb::WriteBatch::Handler
+{
+  const RocksDBStore& db;
+  rocksdb::WriteBatch* out = nullptr; ///< null during the scan pass
+  std::unordered_map<std::string, size_t> last_put;
+  size_t pos = 0;
+  size_t overridden = 0;
+
+  static std::string _id(uint32_t column_family_id, const rocksdb::Slice& key) {
+    std::string id((const char*)&column_family_id, sizeof(column_family_id));
+    id.append(key.data(), key.size());
+    return id;
+  }
+  rocksdb::ColumnFamilyHandle* _cf(uint32_t column_family_id) const {
+    if (column_family_id == 0) {
+      return db.default_cf;
+    }
+    auto p = db.cf_ids_to_handle.find(column_family_id);
+    ceph_assert(p != db.cf_ids_to_handle.end());
+    return p->second;
+  }
+  /// true if op at the current position is overridden by a later Put
+  bool _skip(uint32_t column_family_id, const rocksdb::Slice& key) {
+    auto p = last_put.find(_id(column_family_id, key));
+    return p != last_put.end() && p->second > pos;
+  }
+
+public:
+  explicit RocksWBCoalescer(const RocksDBStore& db) : db(db) {}
+
+  /// switch from scan to emit pass; returns false if there is no gain
+  bool start_emit(rocksdb::WriteBatch* bat) {
+    if (!overridden) {
+      return false;
+    }
+    out = bat;
+    pos = 0;
+    return true;
+  }
+
+  rocksdb::Status PutCF(uint32_t column_family_id, const rocksdb::Slice& key,
+			const rocksdb::Slice& value) override {
+    ++pos;
+    if (!out) {
+      auto [p, inserted] = last_put.try_emplace(_id(column_family_id, key), pos);
+      if (!inserted) {
+	p->second = pos;
+	++overridden;
+      }
+      return rocksdb::Status::OK();
+    }
+    if (_skip(column_family_id, key)) {
+      return rocksdb::Status::OK();
+    }
+    return out->Put(_cf(column_family_id), key, value);
+  }
+  rocksdb::Status MergeCF(uint32_t column_family_id, const rocksdb::Slice& key,
+			  const rocksdb::Slice& value) override {
+    ++pos;
+    if (!out || _skip(column_family_id, key)) {
+      return rocksdb::Status::OK();
+    }
+    return out->Merge(_cf(column_family_id), key, value);
+  }
+  rocksdb::Status DeleteCF(uint32_t column_family_id,
+			   const rocksdb::Slice& key) override {
+    ++pos;
+    if (!out || _skip(column_family_id, key)) {
+      return rocksdb::Status::OK();
+    }
+    return out->Delete(_cf(column_family_id), key);
+  }
+  rocksdb::Status SingleDeleteCF(uint32_t column_family_id,
+				 const rocksdb::Slice& key) override {
+    ++pos;
+    if (!out) {
+      return rocksdb::Status::OK();
+    }
+    return out->SingleDelete(_cf(column_family_id), key);
+  }
+  rocksdb::Status DeleteRangeCF(uint32_t column_family_id,
+				const rocksdb::Slice& begin_key,
+				const rocksdb::Slice& end_key) override {
+    ++pos;
+    if (!out) {
+      return rocksdb::Status::OK();
+    }
+    return out->DeleteRange(_cf(column_family_id), begin_key, end_key);
+  }
+  bool Continue() override {
+    return true;
+  }
+};
+
+KeyValueDB::Transaction RocksDBStore::coalesce_transactions(
+  const std::vector<KeyValueDB::Transaction>& ts)
+{
+  if (ts.size() < 2) {
+    return nullptr;
+  }
+  RocksWBPutHasher hasher;
+  for (auto& t : ts) {
+    auto _t = static_cast<RocksDBTransactionImpl *>(t.get());
+    // anything the handlers do not know about (e.g. log data) makes
+    // Iterate() fail; leave such groups alone
+    if (!_t->bat.Iterate(&hasher).ok()) {
+      return nullptr;
+    }
+  }
+  if (!hasher.may_overlap()) {
+    return nullptr;
+  }
+  RocksWBCoalescer coalescer(*this);
+  for (auto& t : ts) {
+    auto _t = static_cast<RocksDBTransactionImpl *>(t.get());
+    rocksdb::Status s = _t->bat.Iterate(&coalescer);
+    ceph_assert(s.ok());
+  }
+  auto merged = std::make_shared<RocksDBTransactionImpl>(this);
+  if (!coalescer.start_emit(&merged->bat)) {
+    return nullptr;
+  }
+  for (auto& t : ts) {
+    auto _t = static_cast<RocksDBTransactionImpl *>(t.get());
+    rocksdb::Status s = _t->bat.Iterate(&coalescer);
+    ceph_assert(s.ok());
+  }
+  dout(20) << __func__ << " " << ts.size() << " txns, "
+	   << merged->get_count() << " ops, "
+	   << merged->get_size_bytes() << " bytes" << dendl;
+  return merged;
+}
+
 RocksDBStore::RocksDBTransactionImpl::RocksDBTransactionImpl(RocksDBStore *_db)
 {
   db = _db;
@@ -3807,6 +4068,7 @@ int RocksDBStore::reshard(const std::string& new_sharding, const RocksDBStore::r
 
   auto close_column_handles = make_scope_guard([this] {
     cf_handles.clear();
+    cf_ids_to_handle.clear();
     close();
   });
   columns_t to_process_columns;
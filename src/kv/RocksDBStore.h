@@ -83,6 +83,7 @@ inline rocksdb::Slice make_slice(const std::optional<std::string>& bound) {
  * Uses RocksDB to implement the KeyValueDB interface
  */
 struct RocksWBHandler;
+class RocksWBCoalescer;
 class RocksDBStore : public KeyValueDB {
   CephContext *cct;
   PerfCounters *logger;
@@ -102,6 +103,7 @@ class RocksDBStore : public KeyValueDB {
   friend class CFIteratorImpl;
   friend class WholeMergeIteratorImpl;
   friend struct RocksWBHandler;
+  friend class RocksWBCoalescer;
   /*
    *  See RocksDB's definition of a column family(CF) and how to use it.
    *  The interfaces of KeyValueDB is extended, when a column family is created.
@@ -135,6 +137,7 @@ private:
   std::unordered_map<std::string, prefix_shards> cf_handles;
   typedef decltype(cf_handles)::iterator cf_handles_iterator;
   std::unordered_map<uint32_t, std::string> cf_ids_to_prefix;
+  std::unordered_map<uint32_t, rocksdb::ColumnFamilyHandle*> cf_ids_to_handle;
   std::unordered_map<std::string, rocksdb::BlockBasedTableOptions> cf_bbt_opts;
   
   void add_column_family(const std::string& cf_name, uint32_t hash_l, uint32_t hash_h,
@@ -170,6 +173,7 @@ private:
   int apply_sharding(const rocksdb::Options& opt,
 		     const std::string& sharding_text);
   int verify_sharding(const rocksdb::Options& opt,
+		      const std::string& requested_sharding_text,
 		      std::vector<rocksdb::ColumnFamilyDescriptor>& existing_cfs,
 		      std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> >& existing_cfs_shard,
 		      std::vector<rocksdb::ColumnFamilyDescriptor>& missing_cfs,
@@ -186,6 +190,8 @@ private:
   int update_column_family_options(const std::string& base_name,
 				   const std::string& more_options,
 				   rocksdb::ColumnFamilyOptions* cf_opt);
+  int apply_column_family_profile(const std::string& base_name,
+				  rocksdb::ColumnFamilyOptions* cf_opt);
   // manage async compactions
   ceph::mutex compact_queue_lock =
     ceph::make_mutex("RocksDBStore::compact_thread_lock");
@@ -312,6 +318,10 @@ public:
     const std::string &property,
     uint64_t *out) final;
 
+  /// options the (first shard of the) column family is open with
+  int get_column_family_options(const std::string& prefix,
+				rocksdb::ColumnFamilyOptions *out);
+
   int64_t estimate_prefix_size(const std::string& prefix,
 			       const std::string& key_prefix) override;
   int64_t estimate_range_size(const std::string& prefix,
@@ -376,6 +386,8 @@ public:
 
   int submit_transaction(KeyValueDB::Transaction t) override;
   int submit_transaction_sync(KeyValueDB::Transaction t) override;
+  KeyValueDB::Transaction coalesce_transactions(
+    const std::vector<KeyValueDB::Transaction>& ts) override;
   int get(
     const std::string &prefix,
     const std::set<std::string> &key,
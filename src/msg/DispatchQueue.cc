@@ -17,6 +17,7 @@
 #include "DispatchQueue.h"
 #include "Messenger.h"
 #include "common/ceph_context.h"
+#include "common/perf_counters.h"
 
 #define dout_subsys ceph_subsys_ms
 #include "common/debug.h"
@@ -31,12 +32,152 @@ using ceph::ref_t;
 #undef dout_prefix
 #define dout_prefix *_dout << "-- " << msgr->get_myaddrs() << " "
 
+DispatchQueue::Shard::Shard(DispatchQueue *dq, const std::string &name)
+  : dq(dq),
+    lock(ceph::make_mutex("Messenger::DispatchQueue::lock" + name)),
+    mqueue(dq->cct->_conf->ms_pq_max_tokens_per_priority,
+           dq->cct->_conf->ms_pq_min_cost),
+    dispatch_thread(dq, this)
+{}
+
+DispatchQueue::Shard::~Shard()
+{
+  // items queued after the dispatch thread stopped
+  for (auto item = inbox.exchange(nullptr); item; ) {
+    auto next = item->next;
+    delete item;
+    item = next;
+  }
+  ceph_assert(mqueue.empty());
+  ceph_assert(marrival.empty());
+}
+
+void DispatchQueue::Shard::push(QueueItem *item)
+{
+  auto head = inbox.load(std::memory_order_relaxed);
+  do {
+    item->next = head;
+  } while (!inbox.compare_exchange_weak(head, item,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed));
+  if (!head) {
+    // the dispatch thread drains the whole inbox under the lock before
+    // it waits, so only the first item needs to wake it up
+    std::lock_guard l{lock};
+    cond.notify_all();
+  }
+}
+
+void DispatchQueue::Shard::drain_inbox()
+{
+  // reverse the list into the order the items were queued in
+  QueueItem *items = nullptr;
+  for (auto item = inbox.exchange(nullptr, std::memory_order_acquire); item; ) {
+    auto next = item->next;
+    item->next = items;
+    items = item;
+    item = next;
+  }
+  while (items) {
+    std::unique_ptr<QueueItem> item{items};
+    items = item->next;
+    if (dq->stop) {
+      // enqueue() raced with shutdown(); the dispatch thread may be gone
+      // already, so nothing must be left behind in mqueue
+      if (!item->is_code()) {
+        dq->logger->dec(l_dispatch_queue_len);
+        dq->dispatch_throttle_release(
+          item->get_message()->get_dispatch_throttle_size());
+      }
+      continue;
+    }
+    if (item->is_code()) {
+      mqueue.enqueue_strict(0, CEPH_MSG_PRIO_HIGHEST, std::move(*item));
+      continue;
+    }
+    add_arrival(*item);
+    auto id = item->id;
+    auto priority = item->priority;
+    if (priority >= CEPH_MSG_PRIO_LOW) {
+      mqueue.enqueue_strict(id, priority, std::move(*item));
+    } else {
+      auto cost = item->get_message()->get_cost();
+      mqueue.enqueue(id, priority, cost, std::move(*item));
+    }
+  }
+}
+
+int DispatchQueue::Shard::inbox_len() const
+{
+  // items only ever leave the inbox in drain_inbox() under #lock, so
+  // the list can be walked while producers keep pushing onto its head
+  int len = 0;
+  for (auto item = inbox.load(std::memory_order_acquire); item;
+       item = item->next) {
+    ++len;
+  }
+  return len;
+}
+
+DispatchQueue::DispatchQueue(CephContext *cct, Messenger *msgr,
+                             std::string &name)
+  : cct(cct), msgr(msgr),
+    next_id(1),
+    local_delivery_lock(ceph::make_mutex("Messenger::DispatchQueue::local_delivery_lock" + name)),
+    stop_local_delivery(false),
+    local_delivery_thread(this),
+    dispatch_throttler(cct, std::string("msgr_dispatch_throttler-") + name,
+                       cct->_conf->ms_dispatch_throttle_bytes),
+    stop(false)
+{
+  auto num_shards = std::max<uint64_t>(1, cct->_conf->ms_dispatch_shards);
+  for (uint64_t i = 0; i < num_shards; ++i) {
+    shards.emplace_back(std::make_unique<Shard>(
+      this, i ? name + "-" + std::to_string(i) : name));
+  }
+
+  PerfCountersBuilder b(cct, std::string("msgr_dispatch_queue-") + name,
+                        l_dispatch_queue_first, l_dispatch_queue_last);
+  b.add_u64(l_dispatch_queue_len, "queue_len",
+            "Messages waiting for dispatch");
+  b.add_time_avg(l_dispatch_queue_wait_lat_low, "wait_lat_low",
+                 "Queue wait time of messages below default priority");
+  b.add_time_avg(l_dispatch_queue_wait_lat_default, "wait_lat_default",
+                 "Queue wait time of messages of default priority");
+  b.add_time_avg(l_dispatch_queue_wait_lat_high, "wait_lat_high",
+                 "Queue wait time of messages of high priority");
+  b.add_time_avg(l_dispatch_queue_wait_lat_highest, "wait_lat_highest",
+                 "Queue wait time of messages of highest priority");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+DispatchQueue::~DispatchQueue()
+{
+  ceph_assert(local_messages.empty());
+  shards.clear();
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
+}
+
 double DispatchQueue::get_max_age(utime_t now) const {
-  std::lock_guard l{lock};
-  if (marrival.empty())
-    return 0;
-  else
-    return (now - *marrival.begin());
+  double max_age = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l{shard->lock};
+    if (!shard->marrival.empty()) {
+      max_age = std::max<double>(max_age, now - *shard->marrival.begin());
+    }
+  }
+  return max_age;
+}
+
+int DispatchQueue::get_queue_len() const {
+  int len = 0;
+  for (auto& shard : shards) {
+    std::lock_guard l{shard->lock};
+    len += shard->mqueue.length() + shard->inbox_len();
+  }
+  return len;
 }
 
 uint64_t DispatchQueue::pre_dispatch(const ref_t<Message>& m)
@@ -83,19 +224,23 @@ void DispatchQueue::fast_preprocess(const ref_t<Message>& m)
 
 void DispatchQueue::enqueue(const ref_t<Message>& m, int priority, uint64_t id)
 {
-  std::lock_guard l{lock};
   if (stop) {
     return;
   }
   ldout(cct,20) << "queue " << m << " prio " << priority << dendl;
-  QueueItem item{m};
-  add_arrival(item);
-  if (priority >= CEPH_MSG_PRIO_LOW) {
-    mqueue.enqueue_strict(id, priority, std::move(item));
-  } else {
-    mqueue.enqueue(id, priority, m->get_cost(), std::move(item));
+  auto item = new QueueItem{m};
+  item->priority = priority;
+  item->id = id;
+  logger->inc(l_dispatch_queue_len);
+  get_shard(m->get_connection().get()).push(item);
+}
+
+void DispatchQueue::queue_code(int code, Connection *con)
+{
+  if (stop) {
+    return;
   }
-  cond.notify_one();
+  get_shard(con).push(new QueueItem{code, con});
 }
 
 void DispatchQueue::local_delivery(const ref_t<Message>& m, int priority)
@@ -155,14 +300,28 @@ void DispatchQueue::dispatch_throttle_release(uint64_t msize)
  * end of the queue. If the queue is empty; it's removed.
  * The message is then delivered and the process starts again.
  */
-void DispatchQueue::entry()
+void DispatchQueue::entry(Shard &shard)
 {
-  std::unique_lock l{lock};
+  std::unique_lock l{shard.lock};
   while (true) {
-    while (!mqueue.empty()) {
-      QueueItem qitem = mqueue.dequeue();
-      if (!qitem.is_code())
-	remove_arrival(qitem);
+    shard.drain_inbox();
+    while (!shard.mqueue.empty()) {
+      QueueItem qitem = shard.mqueue.dequeue();
+      if (!qitem.is_code()) {
+	shard.remove_arrival(qitem);
+	logger->dec(l_dispatch_queue_len);
+	int idx;
+	if (qitem.priority < CEPH_MSG_PRIO_DEFAULT) {
+	  idx = l_dispatch_queue_wait_lat_low;
+	} else if (qitem.priority < CEPH_MSG_PRIO_HIGH) {
+	  idx = l_dispatch_queue_wait_lat_default;
+	} else if (qitem.priority < CEPH_MSG_PRIO_HIGHEST) {
+	  idx = l_dispatch_queue_wait_lat_high;
+	} else {
+	  idx = l_dispatch_queue_wait_lat_highest;
+	}
+	logger->tinc(idx, ceph::mono_clock::now() - qitem.stamp);
+      }
       l.unlock();
 
       if (qitem.is_code()) {
@@ -206,39 +365,54 @@ void DispatchQueue::entry()
       }
 
       l.lock();
+      shard.drain_inbox();
     }
     if (stop)
       break;
 
     // wait for something to be put on queue
-    cond.wait(l);
+    shard.cond.wait(l, [&shard, this] {
+      return shard.inbox.load(std::memory_order_relaxed) || stop;
+    });
   }
 }
 
 void DispatchQueue::discard_queue(uint64_t id) {
-  std::lock_guard l{lock};
-  std::list<QueueItem> removed;
-  mqueue.remove_by_class(id, &removed);
-  for (auto i = removed.begin(); i != removed.end(); ++i) {
-    ceph_assert(!(i->is_code())); // We don't discard id 0, ever!
-    const ref_t<Message>& m = i->get_message();
-    remove_arrival(*i);
-    dispatch_throttle_release(m->get_dispatch_throttle_size());
+  // the connection's items are all on one shard, but only its id is
+  // known here
+  for (auto& shard : shards) {
+    std::lock_guard l{shard->lock};
+    shard->drain_inbox();
+    std::list<QueueItem> removed;
+    shard->mqueue.remove_by_class(id, &removed);
+    for (auto i = removed.begin(); i != removed.end(); ++i) {
+      ceph_assert(!(i->is_code())); // We don't discard id 0, ever!
+      const ref_t<Message>& m = i->get_message();
+      shard->remove_arrival(*i);
+      logger->dec(l_dispatch_queue_len);
+      dispatch_throttle_release(m->get_dispatch_throttle_size());
+    }
   }
 }
 
 void DispatchQueue::start()
 {
   ceph_assert(!stop);
-  ceph_assert(!dispatch_thread.is_started());
-  dispatch_thread.create("ms_dispatch");
+  for (size_t i = 0; i < shards.size(); ++i) {
+    auto& thread = shards[i]->dispatch_thread;
+    ceph_assert(!thread.is_started());
+    thread.create(i ? ("ms_dispatch-" + std::to_string(i)).c_str()
+                    : "ms_dispatch");
+  }
   local_delivery_thread.create("ms_local");
 }
 
 void DispatchQueue::wait()
 {
   local_delivery_thread.join();
-  dispatch_thread.join();
+  for (auto& shard : shards) {
+    shard->dispatch_thread.join();
+  }
 }
 
 void DispatchQueue::discard_local()
@@ -254,10 +428,10 @@ void DispatchQueue::shutdown()
     stop_local_delivery = true;
     local_delivery_cond.notify_all();
   }
-  // stop my dispatch thread
-  {
-    std::scoped_lock l{lock};
-    stop = true;
-    cond.notify_all();
+  // stop my dispatch threads
+  stop = true;
+  for (auto& shard : shards) {
+    std::scoped_lock l{shard->lock};
+    shard->cond.notify_all();
   }
 }
@@ -17,13 +17,16 @@
 #define CEPH_DISPATCHQUEUE_H
 
 #include <atomic>
+#include <memory>
 #include <set>
 #include <queue>
+#include <vector>
 #include <boost/intrusive_ptr.hpp>
 #include "include/ceph_assert.h"
 #include "include/common_fwd.h"
 #include "common/Throttle.h"
 #include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
 #include "common/Thread.h"
 #include "common/PrioritizedQueue.h"
 
@@ -32,15 +35,28 @@
 class Messenger;
 struct Connection;
 
+enum {
+  l_dispatch_queue_first = 94100,
+  l_dispatch_queue_len,
+  l_dispatch_queue_wait_lat_low,
+  l_dispatch_queue_wait_lat_default,
+  l_dispatch_queue_wait_lat_high,
+  l_dispatch_queue_wait_lat_highest,
+  l_dispatch_queue_last,
+};
+
 /**
  * The DispatchQueue contains all the connections which have Messages
  * they want to be dispatched, carefully organized by Message priority
  * and permitted to deliver in a round-robin fashion.
  * See Messenger::dispatch_entry for details.
+ *
+ * Connections are spread over ms_dispatch_shards shards, each with its own
+ * queue and dispatch thread.  All messages and events of a connection go
+ * to the same shard, so they are still delivered in order.
  */
 class DispatchQueue {
   using ArrivalSet = std::multiset<double>;
-  ArrivalSet marrival;
 
   class QueueItem {
     int type;
@@ -66,43 +82,82 @@ class DispatchQueue {
     }
 
     /**
-     * An iterator into #marrival.  This field is only initialized if
+     * An iterator into Shard::marrival.  This field is only initialized if
      * `!is_code()`.  It is set by add_arrival() and used by
      * remove_arrival().
      */
     ArrivalSet::iterator arrival;
+
+    /// when the item was queued, for the wait time counters
+    ceph::mono_time stamp = ceph::mono_clock::now();
+    int priority = CEPH_MSG_PRIO_HIGHEST;
+    uint64_t id = 0;
+    /// link in Shard::inbox
+    QueueItem *next = nullptr;
   };
 
   CephContext *cct;
   Messenger *msgr;
-  mutable ceph::mutex lock;
-  ceph::condition_variable cond;
-
-  PrioritizedQueue<QueueItem, uint64_t> mqueue;
-
-  void add_arrival(QueueItem &item) {
-    item.arrival = marrival.insert(item.get_message()->get_recv_stamp());
-  }
-  void remove_arrival(QueueItem &item) {
-    marrival.erase(item.arrival);
-  }
 
   std::atomic<uint64_t> next_id;
 
   enum { D_CONNECT = 1, D_ACCEPT, D_BAD_REMOTE_RESET, D_BAD_RESET, D_CONN_REFUSED, D_NUM_CODES };
 
+  struct Shard;
+
   /**
-   * The DispatchThread runs dispatch_entry to empty out the dispatch_queue.
+   * The DispatchThread runs dispatch_entry to empty out its shard of the
+   * dispatch_queue.
    */
   class DispatchThread : public Thread {
     DispatchQueue *dq;
+    Shard *shard;
   public:
-    explicit DispatchThread(DispatchQueue *dq) : dq(dq) {}
+    DispatchThread(DispatchQueue *dq, Shard *shard) : dq(dq), shard(shard) {}
     void *entry() override {
-      dq->entry();
+      dq->entry(*shard);
       return 0;
     }
-  } dispatch_thread;
+  };
+
+  struct Shard {
+    DispatchQueue *dq;
+    mutable ceph::mutex lock;
+    ceph::condition_variable cond;
+    PrioritizedQueue<QueueItem, uint64_t> mqueue;
+    ArrivalSet marrival;
+    /// items queued without taking #lock, most recent first
+    std::atomic<QueueItem*> inbox = nullptr;
+    DispatchThread dispatch_thread;
+
+    Shard(DispatchQueue *dq, const std::string &name);
+    ~Shard();
+
+    /// queue an item, lock-free unless the shard has to be woken up
+    void push(QueueItem *item);
+    /// move the items of the inbox into #mqueue, or drop them once the
+    /// queue is stopped; #lock must be held
+    void drain_inbox();
+    /// number of items in the inbox, #lock must be held
+    int inbox_len() const;
+
+    void add_arrival(QueueItem &item) {
+      item.arrival = marrival.insert(item.get_message()->get_recv_stamp());
+    }
+    void remove_arrival(QueueItem &item) {
+      marrival.erase(item.arrival);
+    }
+  };
+  std::vector<std::unique_ptr<Shard>> shards;
+
+  Shard &get_shard(const Connection *con) {
+    // all items of a connection go to the same shard to keep them in order
+    return *shards[(reinterpret_cast<uintptr_t>(con) *
+                    0x9E3779B97F4A7C15ull >> 32) % shards.size()];
+  }
+  void queue_code(int code, Connection *con);
+
+  PerfCounters *logger = nullptr;
 
   ceph::mutex local_delivery_lock;
   ceph::condition_variable local_delivery_cond;
@@ -126,7 +181,7 @@ class DispatchQueue {
   /// Throttle preventing us from building up a big backlog waiting for dispatch
   Throttle dispatch_throttler;
 
-  bool stop;
+  std::atomic<bool> stop;
   void local_delivery(const ceph::ref_t<Message>& m, int priority);
   void local_delivery(Message* m, int priority) {
     return local_delivery(ceph::ref_t<Message>(m, false), priority); /* consume ref */
@@ -135,10 +190,7 @@ class DispatchQueue {
 
   double get_max_age(utime_t now) const;
 
-  int get_queue_len() const {
-    std::lock_guard l{lock};
-    return mqueue.length();
-  }
+  int get_queue_len() const;
 
   /**
    * Release memory accounting back to the dispatch throttler.
@@ -148,54 +200,19 @@ class DispatchQueue {
   void dispatch_throttle_release(uint64_t msize);
 
   void queue_connect(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_CONNECT, con));
-    cond.notify_all();
+    queue_code(D_CONNECT, con);
   }
   void queue_accept(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_ACCEPT, con));
-    cond.notify_all();
+    queue_code(D_ACCEPT, con);
   }
   void queue_remote_reset(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_BAD_REMOTE_RESET, con));
-    cond.notify_all();
+    queue_code(D_BAD_REMOTE_RESET, con);
   }
   void queue_reset(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_BAD_RESET, con));
-    cond.notify_all();
+    queue_code(D_BAD_RESET, con);
   }
   void queue_refused(Connection *con) {
-    std::lock_guard l{lock};
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_CONN_REFUSED, con));
-    cond.notify_all();
+    queue_code(D_CONN_REFUSED, con);
   }
 
   bool can_fast_dispatch(const ceph::cref_t<Message> &m) const;
@@ -214,30 +231,13 @@ class DispatchQueue {
     return next_id++;
   }
   void start();
-  void entry();
+  void entry(Shard &shard);
   void wait();
   void shutdown();
-  bool is_started() const {return dispatch_thread.is_started();}
-
-  DispatchQueue(CephContext *cct, Messenger *msgr, std::string &name)
-    : cct(cct), msgr(msgr),
-      lock(ceph::make_mutex("Messenger::DispatchQueue::lock" + name)),
-      mqueue(cct->_conf->ms_pq_max_tokens_per_priority,
-	     cct->_conf->ms_pq_min_cost),
-      next_id(1),
-      dispatch_thread(this),
-      local_delivery_lock(ceph::make_mutex("Messenger::DispatchQueue::local_delivery_lock" + name)),
-      stop_local_delivery(false),
-      local_delivery_thread(this),
-      dispatch_throttler(cct, std::string("msgr_dispatch_throttler-") + name,
-                         cct->_conf->ms_dispatch_throttle_bytes),
-      stop(false)
-    {}
-  ~DispatchQueue() {
-    ceph_assert(mqueue.empty());
-    ceph_assert(marrival.empty());
-    ceph_assert(local_messages.empty());
-  }
+  bool is_started() const {return shards[0]->dispatch_thread.is_started();}
+
+  DispatchQueue(CephContext *cct, Messenger *msgr, std::string &name);
+  ~DispatchQueue();
 };
 
 #endif
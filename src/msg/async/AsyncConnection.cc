@@ -26,6 +26,7 @@
 #include "common/iso_8601.h"
 #include "common/tcp_info.h"
 #include "include/Context.h"
+#include "include/crc32c.h"
 #include "include/msgr.h"
 #include "include/random.h"
 #include "common/errno.h"
@@ -204,6 +205,17 @@ ssize_t AsyncConnection::read(unsigned len, char *buffer,
   return r;
 }
 
+void AsyncConnection::copy_from_recv_buf(char *p, unsigned len,
+                                         unsigned needed)
+{
+  if (recv_want_crc32c && len == needed) {
+    recv_crc32c = ceph_crc32c_copy(-1, reinterpret_cast<unsigned char*>(p),
+      reinterpret_cast<unsigned char*>(recv_buf + recv_start), len);
+  } else {
+    memcpy(p, recv_buf + recv_start, len);
+  }
+}
+
 // Because this func will be called multi times to populate
 // the needed buffer, so the passed in bufferptr must be the same.
 // Normally, only "read_message" will pass existing bufferptr in
@@ -229,7 +241,7 @@ ssize_t AsyncConnection::read_until(unsigned len, char *p)
   uint64_t left = len - state_offset;
   if (recv_end > recv_start) {
     uint64_t to_read = std::min<uint64_t>(recv_end - recv_start, left);
-    memcpy(p, recv_buf+recv_start, to_read);
+    copy_from_recv_buf(p, to_read, len);
     recv_start += to_read;
     left -= to_read;
     ldout(async_msgr->cct, 25) << __func__ << " got " << to_read << " in buffer "
@@ -261,7 +273,11 @@ ssize_t AsyncConnection::read_until(unsigned len, char *p)
     } while (r > 0);
   } else {
     do {
-      r = read_bulk(recv_buf+recv_end, recv_max_prefetch);
+      uint64_t prefetch = recv_max_prefetch;
+      if (recv_prefetch_limit) {
+        prefetch = std::clamp<uint64_t>(*recv_prefetch_limit, left, prefetch);
+      }
+      r = read_bulk(recv_buf+recv_end, prefetch);
       ldout(async_msgr->cct, 25) << __func__ << " read_bulk recv_end is " << recv_end
                                  << " left is " << left << " got " << r << dendl;
       if (r < 0) {
@@ -270,8 +286,8 @@ ssize_t AsyncConnection::read_until(unsigned len, char *p)
       }
       recv_end += r;
       if (r >= static_cast<int>(left)) {
+        copy_from_recv_buf(p+state_offset, len - state_offset, len);
         recv_start = len - state_offset;
-        memcpy(p+state_offset, recv_buf, recv_start);
         state_offset = 0;
         return 0;
       }
@@ -308,6 +324,9 @@ ssize_t AsyncConnection::read_bulk(char *buf, unsigned len)
                               << cs.fd() << dendl;
     return -1;
   }
+  if (recv_prefetch_limit) {
+    *recv_prefetch_limit -= std::min<uint64_t>(*recv_prefetch_limit, nread);
+  }
   return nread;
 }
 
@@ -343,6 +362,7 @@ ssize_t AsyncConnection::_try_send(bool more)
   ssize_t r = 0;
   if (likely(!inject_network_congestion())) {
     r = cs.send(outgoing_bl, more);
+    logger->inc(l_msgr_send_calls);
   }
   if (r < 0) {
     ldout(async_msgr->cct, 1) << __func__ << " send error: " << cpp_strerror(r) << dendl;
@@ -625,6 +645,8 @@ void AsyncConnection::fault()
     delay_state->flush();
 
   recv_start = recv_end = 0;
+  recv_prefetch_limit.reset();
+  recv_want_crc32c = false;
   state_offset = 0;
   outgoing_bl.clear();
 }
@@ -56,6 +56,27 @@ class AsyncConnection : public Connection {
                std::function<void(char *, ssize_t)> callback);
   ssize_t read_until(unsigned needed, char *p);
   ssize_t read_bulk(char *buf, unsigned len);
+  // Don't let the prefetch read past the next @len bytes of the stream,
+  // so a large payload following them is read straight into its own
+  // (aligned) buffer instead of being copied out of recv_buf.
+  void set_prefetch_limit(uint64_t len) {
+    uint64_t buffered = recv_end - recv_start;
+    recv_prefetch_limit = len > buffered ? len - buffered : 0;
+  }
+  void clear_prefetch_limit() {
+    recv_prefetch_limit.reset();
+  }
+  // Compute crc32c(-1) of the next read() while copying it out of
+  // recv_buf. Only reads served from recv_buf in one go get a crc.
+  void want_read_crc32c() {
+    recv_want_crc32c = true;
+    recv_crc32c.reset();
+  }
+  std::optional<uint32_t> take_read_crc32c() {
+    recv_want_crc32c = false;
+    return std::exchange(recv_crc32c, std::nullopt);
+  }
+  void copy_from_recv_buf(char *p, unsigned len, unsigned needed);
 
   ssize_t write(ceph::buffer::list &bl, std::function<void(ssize_t)> callback,
                 bool more=false);
@@ -200,6 +221,9 @@ private:
   uint32_t recv_max_prefetch;
   uint32_t recv_start;
   uint32_t recv_end;
+  std::optional<uint64_t> recv_prefetch_limit; ///< socket bytes we may prefetch
+  bool recv_want_crc32c = false;
+  std::optional<uint32_t> recv_crc32c; ///< crc32c(-1) of the last read
   std::set<uint64_t> register_time_events; // need to delete it if stop
   ceph::coarse_mono_clock::time_point last_connect_started;
   ceph::coarse_mono_clock::time_point last_active;
@@ -377,6 +377,8 @@ AsyncMessenger::AsyncMessenger(CephContext *cct, entity_name_t name,
     transport_type = "dpdk";
   else if (type.find("smc") != std::string::npos)
     transport_type = "smc";
+  else if (type.find("io_uring") != std::string::npos)
+    transport_type = "io_uring";
 
   auto single = &cct->lookup_or_create_singleton_object<StackSingleton>(
     "AsyncMessenger::NetworkStack::" + transport_type, true, cct);
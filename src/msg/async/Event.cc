@@ -25,6 +25,10 @@
 #include "dpdk/EventDPDK.h"
 #endif
 
+#ifdef HAVE_LIBURING
+#include "EventIoUring.h"
+#endif
+
 #ifdef HAVE_EPOLL
 #include "EventEpoll.h"
 #else
@@ -131,6 +135,10 @@ int EventCenter::init(int nevent, unsigned center_id, const std::string &type)
   if (type == "dpdk") {
 #ifdef HAVE_DPDK
     driver = new DPDKDriver(cct);
+#endif
+  } else if (type == "io_uring") {
+#ifdef HAVE_LIBURING
+    driver = new IoUringDriver(cct);
 #endif
   } else {
 #ifdef HAVE_EPOLL
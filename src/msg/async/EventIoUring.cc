@@ -0,0 +1,188 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <poll.h>
+
+#include "common/errno.h"
+#include "EventIoUring.h"
+
+#define dout_subsys ceph_subsys_ms
+
+#undef dout_prefix
+#define dout_prefix *_dout << "IoUringDriver."
+
+// SQEs queued between two waits, interest changes beyond that force an
+// early submit
+static constexpr unsigned IO_URING_SQ_ENTRIES = 1024;
+
+int IoUringDriver::init(EventCenter *c, int nevent)
+{
+  struct io_uring_params params = {};
+  // multishot polls of all connections share the CQ, size it generously;
+  // overflowing CQEs are still kept by the kernel (IORING_FEAT_NODROP)
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = IO_URING_SQ_ENTRIES * 8;
+  int r = io_uring_queue_init_params(IO_URING_SQ_ENTRIES, &ring, &params);
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to init io_uring: "
+               << cpp_strerror(r) << dendl;
+    return r;
+  }
+  ring_inited = true;
+  fds.resize(nevent);
+  return 0;
+}
+
+struct io_uring_sqe *IoUringDriver::get_sqe()
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+  if (!sqe) {
+    io_uring_submit(&ring);
+    sqe = io_uring_get_sqe(&ring);
+    ceph_assert(sqe);
+  }
+  return sqe;
+}
+
+void IoUringDriver::arm(int fd, fd_state_t &s)
+{
+  unsigned poll_mask = 0;
+  if (s.mask & EVENT_READABLE)
+    poll_mask |= POLLIN;
+  if (s.mask & EVENT_WRITABLE)
+    poll_mask |= POLLOUT;
+  struct io_uring_sqe *sqe = get_sqe();
+  if (multishot) {
+    io_uring_prep_poll_multishot(sqe, fd, poll_mask);
+  } else {
+    io_uring_prep_poll_add(sqe, fd, poll_mask);
+  }
+  io_uring_sqe_set_data64(sqe, to_user_data(fd, s.gen));
+}
+
+void IoUringDriver::disarm(int fd, fd_state_t &s)
+{
+  struct io_uring_sqe *sqe = get_sqe();
+  io_uring_prep_poll_remove(sqe, to_user_data(fd, s.gen));
+  // completion of the removal itself is not interesting
+  io_uring_sqe_set_data64(sqe, 0);
+  s.gen = 0;
+}
+
+int IoUringDriver::add_event(int fd, int cur_mask, int add_mask)
+{
+  ldout(cct, 20) << __func__ << " add event fd=" << fd << " cur_mask=" << cur_mask
+                 << " add_mask=" << add_mask << dendl;
+  if ((size_t)fd >= fds.size()) {
+    lderr(cct) << __func__ << " fd=" << fd << " exceeds " << fds.size() << dendl;
+    return -ERANGE;
+  }
+  auto &s = fds[fd];
+  int mask = cur_mask | add_mask;
+  if (s.gen && s.mask == mask) {
+    return 0;
+  }
+  if (s.gen) {
+    disarm(fd, s);
+  }
+  if (++next_gen == 0) {
+    // 0 tags the requests whose completion we ignore
+    ++next_gen;
+  }
+  s.mask = mask;
+  s.gen = next_gen;
+  arm(fd, s);
+  return 0;
+}
+
+int IoUringDriver::del_event(int fd, int cur_mask, int delmask)
+{
+  ldout(cct, 20) << __func__ << " del event fd=" << fd << " cur_mask=" << cur_mask
+                 << " delmask=" << delmask << dendl;
+  if ((size_t)fd >= fds.size()) {
+    return 0;
+  }
+  auto &s = fds[fd];
+  int mask = cur_mask & (~delmask);
+  if (s.gen) {
+    disarm(fd, s);
+  }
+  s.mask = mask;
+  if (mask != EVENT_NONE) {
+    return add_event(fd, EVENT_NONE, mask);
+  }
+  return 0;
+}
+
+int IoUringDriver::resize_events(int newsize)
+{
+  fds.resize(newsize);
+  return 0;
+}
+
+int IoUringDriver::event_wait(std::vector<FiredFileEvent> &fired_events, struct timeval *tvp)
+{
+  struct io_uring_cqe *cqe = nullptr;
+  struct __kernel_timespec ts;
+  if (tvp) {
+    ts.tv_sec = tvp->tv_sec;
+    ts.tv_nsec = tvp->tv_usec * 1000;
+  }
+  // submits the queued interest changes and waits in the same syscall
+  int r = io_uring_submit_and_wait_timeout(&ring, &cqe, 1,
+                                           tvp ? &ts : nullptr, nullptr);
+  if (r < 0 && r != -ETIME && r != -EINTR) {
+    lderr(cct) << __func__ << " io_uring wait failed: " << cpp_strerror(r) << dendl;
+  }
+
+  fired_events.clear();
+  unsigned head, nr = 0;
+  io_uring_for_each_cqe(&ring, head, cqe) {
+    ++nr;
+    uint64_t user_data = io_uring_cqe_get_data64(cqe);
+    int fd = int(uint32_t(user_data));
+    uint32_t gen = user_data >> 32;
+    if (gen == 0 || (size_t)fd >= fds.size() || fds[fd].gen != gen) {
+      // removal completions and polls that were replaced meanwhile
+      continue;
+    }
+    auto &s = fds[fd];
+    if (cqe->res == -EINVAL && multishot) {
+      ldout(cct, 1) << __func__ << " multishot poll not supported,"
+                    << " falling back to one-shot polls" << dendl;
+      multishot = false;
+      arm(fd, s);
+      continue;
+    }
+    if (cqe->res >= 0) {
+      int mask = 0;
+      if (cqe->res & POLLIN) mask |= EVENT_READABLE;
+      if (cqe->res & POLLOUT) mask |= EVENT_WRITABLE;
+      if (cqe->res & (POLLERR | POLLHUP)) mask |= EVENT_READABLE|EVENT_WRITABLE;
+      fired_events.push_back({fd, mask & s.mask});
+    } else if (cqe->res != -ECANCELED) {
+      // let the handlers run into the error on the socket itself
+      ldout(cct, 1) << __func__ << " poll on fd=" << fd << " failed: "
+                    << cpp_strerror(cqe->res) << dendl;
+      fired_events.push_back({fd, s.mask});
+      s.gen = 0;
+      continue;
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+      // one-shot poll fired or multishot terminated (e.g. on CQ overflow)
+      arm(fd, s);
+    }
+  }
+  io_uring_cq_advance(&ring, nr);
+  return fired_events.size();
+}
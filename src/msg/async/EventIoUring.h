@@ -0,0 +1,66 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_EVENTIOURING_H
+#define CEPH_MSG_EVENTIOURING_H
+
+#include <vector>
+
+#include "liburing.h"
+
+#include "Event.h"
+
+/*
+ * IoUringDriver watches file descriptors with io_uring multishot polls.
+ *
+ * Interest changes are only queued as SQEs and get submitted together with
+ * the wait for completions, so an event loop iteration costs a single
+ * io_uring_enter() no matter how many fds were (re)armed.  Kernels without
+ * multishot poll support are handled by re-arming one-shot polls.
+ */
+class IoUringDriver : public EventDriver {
+  struct fd_state_t {
+    int mask = EVENT_NONE;
+    uint32_t gen = 0;       ///< generation of the armed poll, 0 if none
+  };
+
+  CephContext *cct;
+  struct io_uring ring;
+  bool ring_inited = false;
+  bool multishot = true;
+  uint32_t next_gen = 0;
+  std::vector<fd_state_t> fds;
+
+  static uint64_t to_user_data(int fd, uint32_t gen) {
+    return (uint64_t(gen) << 32) | uint32_t(fd);
+  }
+  struct io_uring_sqe *get_sqe();
+  void arm(int fd, fd_state_t &s);
+  void disarm(int fd, fd_state_t &s);
+
+ public:
+  explicit IoUringDriver(CephContext *c): cct(c) {}
+  ~IoUringDriver() override {
+    if (ring_inited)
+      io_uring_queue_exit(&ring);
+  }
+
+  int init(EventCenter *c, int nevent) override;
+  int add_event(int fd, int cur_mask, int add_mask) override;
+  int del_event(int fd, int cur_mask, int del_mask) override;
+  int resize_events(int newsize) override;
+  int event_wait(std::vector<FiredFileEvent> &fired_events,
+		 struct timeval *tp) override;
+};
+
+#endif
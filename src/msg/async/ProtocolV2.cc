@@ -565,7 +565,15 @@ ssize_t ProtocolV2::write_message(Message *m, bool more) {
                  << " off=" << header2.data_off
                  << dendl;
   ssize_t total_send_size = connection->outgoing_bl.length();
-  ssize_t rc = connection->_try_send(more);
+  ssize_t rc = 0;
+  if (more &&
+      uint64_t(total_send_size) < cct->_conf->ms_tcp_tx_batch_bytes) {
+    // the next queued message joins this write, see write_event()
+    ldout(cct, 20) << __func__ << " batching " << total_send_size
+                   << " bytes" << dendl;
+  } else {
+    rc = connection->_try_send(more);
+  }
   if (rc < 0) {
     ldout(cct, 1) << __func__ << " error sending " << m << ", "
                   << cpp_strerror(rc) << dendl;
@@ -603,6 +611,7 @@ bool ProtocolV2::append_frame(F& frame) {
   ldout(cct, 25) << __func__ << " assembled frame " << bl.length()
                  << " bytes " << tx_frame_asm << dendl;
   connection->outgoing_bl.claim_append(bl);
+  connection->logger->inc(l_msgr_send_frames);
   return true;
 }
 
@@ -664,7 +673,10 @@ void ProtocolV2::write_event() {
     auto start = ceph::mono_clock::now();
     bool more;
     do {
-      if (connection->is_queued()) {
+      // frames batched by write_message() stay queued until the batch
+      // is complete
+      if (connection->is_queued() &&
+          connection->outgoing_bl.length() >= cct->_conf->ms_tcp_tx_batch_bytes) {
 	if (r = connection->_try_send(); r!= 0) {
 	  // either fails to send or not all queued buffer is sent
 	  break;
@@ -1171,6 +1183,18 @@ CtPtr ProtocolV2::handle_read_frame_preamble_main(rx_buffer_t &&buffer, int r) {
       return _fault();
     }
     recv_stamp = ceph_clock_now();
+    if (cct->_conf->ms_tcp_rx_direct_data &&
+        rx_frame_asm.get_num_segments() > SegmentIndex::Msg::DATA &&
+        rx_frame_asm.get_segment_onwire_len(SegmentIndex::Msg::DATA) >
+          connection->recv_max_prefetch) {
+      // stop prefetching at the data segment, it is going to be read
+      // directly into its page aligned buffer
+      uint64_t head_len = 0;
+      for (size_t i = 0; i < SegmentIndex::Msg::DATA; ++i) {
+        head_len += rx_frame_asm.get_segment_onwire_len(i);
+      }
+      connection->set_prefetch_limit(head_len);
+    }
     state = THROTTLE_MESSAGE;
     return CONTINUE(throttle_message);
   } else {
@@ -1222,6 +1246,9 @@ CtPtr ProtocolV2::read_frame_segment() {
   size_t seg_idx = rx_segments_data.size();
   ldout(cct, 20) << __func__ << " seg_idx=" << seg_idx << dendl;
   rx_segments_data.emplace_back();
+  if (seg_idx == SegmentIndex::Msg::DATA) {
+    connection->clear_prefetch_limit();
+  }
 
   uint32_t onwire_len = rx_frame_asm.get_segment_onwire_len(seg_idx);
   if (onwire_len == 0) {
@@ -1242,18 +1269,27 @@ CtPtr ProtocolV2::read_frame_segment() {
     return _fault();
   }
 
+  if (!session_stream_handlers.rx && cct->_conf->ms_crc_data) {
+    // a segment that is already prefetched gets checksummed while it is
+    // copied out, the crc check of the frame then finds it cached
+    connection->want_read_crc32c();
+  }
   return READ_RXBUF(std::move(rx_buffer), handle_read_frame_segment);
 }
 
 CtPtr ProtocolV2::handle_read_frame_segment(rx_buffer_t &&rx_buffer, int r) {
   ldout(cct, 20) << __func__ << " r=" << r << dendl;
 
+  auto crc = connection->take_read_crc32c();
   if (r < 0) {
     ldout(cct, 1) << __func__ << " read frame segment failed r=" << r << " ("
                   << cpp_strerror(r) << ")" << dendl;
     return _fault();
   }
 
+  if (crc) {
+    rx_buffer->set_crc32c(-1, *crc);
+  }
   rx_segments_data.back().push_back(std::move(rx_buffer));
   return _handle_read_frame_segment();
 }
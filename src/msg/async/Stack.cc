@@ -69,6 +69,10 @@ std::shared_ptr<NetworkStack> NetworkStack::create(CephContext *c,
     stack.reset(new PosixNetworkStack(c, false));
   else if (t == "smc")
     stack.reset(new PosixNetworkStack(c, true));
+#ifdef HAVE_LIBURING
+  else if (t == "io_uring")
+    stack.reset(new PosixNetworkStack(c, false));
+#endif
 #ifdef HAVE_RDMA
   else if (t == "rdma")
     stack.reset(new RDMAStack(c));
@@ -225,6 +225,9 @@ enum {
   l_msgr_recv_encrypted_bytes,
   l_msgr_send_encrypted_bytes,
 
+  l_msgr_send_frames,
+  l_msgr_send_calls,
+
   l_msgr_last,
 };
 
@@ -283,6 +286,9 @@ class Worker {
     plb.add_u64_counter(l_msgr_recv_encrypted_bytes, "msgr_recv_encrypted_bytes", "Network received encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
     plb.add_u64_counter(l_msgr_send_encrypted_bytes, "msgr_send_encrypted_bytes", "Network sent encrypted bytes", NULL, 0, unit_t(UNIT_BYTES));
 
+    plb.add_u64_counter(l_msgr_send_frames, "msgr_send_frames", "Network sent msgr2 frames");
+    plb.add_u64_counter(l_msgr_send_calls, "msgr_send_calls", "Socket sends of queued outgoing data");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
 
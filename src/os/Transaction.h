@@ -633,6 +633,20 @@ public:
   uint64_t get_num_ops() {
     return data.ops;
   }
+  /// Calls f(op) for each OP_WRITE, without decoding any data
+  template <typename F>
+  void foreach_write_op(F&& f) {
+    if (!data.ops) {
+      return;
+    }
+    const char* p = op_bl.c_str();
+    for (uint64_t i = 0; i < data.ops; ++i, p += sizeof(Op)) {
+      auto op = reinterpret_cast<const Op*>(p);
+      if (op->op == OP_WRITE) {
+        f(*op);
+      }
+    }
+  }
 
   /**
    * iterator
@@ -10,6 +10,7 @@
 #include "BtreeAllocator.h"
 #include "Btree2Allocator.h"
 #include "HybridAllocator.h"
+#include "ShardedAllocator.h"
 #include "common/debug.h"
 #include "common/admin_socket.h"
 
@@ -60,6 +61,11 @@ Allocator *Allocator::create(
       cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
       cct->_conf.get_val<double>("bluestore_btree2_alloc_weight_factor"),
       name);
+  } else if (type == "hybrid_sharded") {
+    return new ShardedAllocator(cct, size, block_size,
+      cct->_conf.get_val<uint64_t>("bluestore_allocator_shards"),
+      cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
+      name);
   }
   if (alloc == nullptr) {
     lderr(cct) << "Allocator::" << __func__ << " unknown alloc type "
@@ -77,6 +83,51 @@ void Allocator::release(const PExtentVector& release_vec)
   release(release_set);
 }
 
+int64_t Allocator::allocate_batch(const std::vector<uint64_t>& wants,
+                                  uint64_t block_size,
+                                  uint64_t max_alloc_size, int64_t hint,
+                                  std::vector<PExtentVector> *extents)
+{
+  ceph_assert(extents);
+  extents->clear();
+  extents->resize(wants.size());
+  uint64_t total = 0;
+  for (auto w : wants) {
+    ceph_assert(w % block_size == 0);
+    total += w;
+  }
+  if (total == 0) {
+    return 0;
+  }
+  PExtentVector all;
+  int64_t r = allocate(total, block_size, max_alloc_size, hint, &all);
+  if (r < (int64_t)total) {
+    if (r > 0) {
+      release(all);
+    }
+    extents->clear();
+    return -ENOSPC;
+  }
+  // carve the extents into the individual requests, in order
+  auto p = all.begin();
+  uint64_t pos = 0;
+  for (size_t i = 0; i < wants.size(); ++i) {
+    uint64_t left = wants[i];
+    while (left > 0) {
+      ceph_assert(p != all.end());
+      uint64_t l = std::min<uint64_t>(left, p->length - pos);
+      (*extents)[i].emplace_back(p->offset + pos, l);
+      pos += l;
+      left -= l;
+      if (pos == p->length) {
+        ++p;
+        pos = 0;
+      }
+    }
+  }
+  return total;
+}
+
 /**
  * Gives fragmentation a numeric value.
  *
@@ -53,6 +53,19 @@ public:
     return allocate(want_size, block_size, want_size, hint, extents);
   }
 
+  /*
+   * Allocate space for a batch of requests at once, e.g. for all the writes
+   * of a transaction. wants[i] bytes are placed into (*extents)[i], each want
+   * has to be a multiple of block_size. Either everything is allocated and
+   * the total is returned, or nothing is and -ENOSPC is returned.
+   * The default implementation does a single allocate() call for the sum
+   * so the allocator is entered (and locked) only once per batch.
+   */
+  virtual int64_t allocate_batch(const std::vector<uint64_t>& wants,
+				 uint64_t block_size,
+				 uint64_t max_alloc_size, int64_t hint,
+				 std::vector<PExtentVector> *extents);
+
   /* Bulk release. Implementations may override this method to handle the whole
    * set at once. This could save e.g. unnecessary mutex dance. */
   virtual void release(const release_set_t& release_set) = 0;
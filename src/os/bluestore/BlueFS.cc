@@ -292,6 +292,11 @@ void BlueFS::_init_logger()
 		    PerfCountersBuilder::PRIO_CRITICAL, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluefs_files_written_wal, "files_written_wal",
 		    "Files written to WAL");
+  b.add_u64_counter(l_bluefs_wal_log_syncs_avoided, "wal_log_syncs_avoided",
+		    "WAL fsyncs that did not need a metadata log sync");
+  b.add_u64_counter(l_bluefs_wal_log_bytes_avoided, "wal_log_bytes_avoided",
+		    "Metadata log bytes not written thanks to envelope mode WAL",
+		    NULL, 0, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluefs_files_written_sst, "files_written_sst",
 		    "Files written to SSTs");
   b.add_u64_counter(l_bluefs_write_count_wal, "write_count_wal",
@@ -4463,6 +4468,7 @@ int BlueFS::_fsync(FileWriter *h, bool force_dirty)/*_F_D_LD_LNF_NF*/
   auto t0 = mono_clock::now();
   _maybe_check_vselector_LNF();
   uint64_t old_dirty_seq = 0;
+  uint64_t old_content_size = h->file->fnode.content_size;
   {
     dout(10) << __func__ << " " << h << " " << h->file->fnode
              << " dirty " << h->file->is_dirty << dendl;
@@ -4485,6 +4491,12 @@ int BlueFS::_fsync(FileWriter *h, bool force_dirty)/*_F_D_LD_LNF_NF*/
   }
   if (old_dirty_seq) {
     _flush_and_sync_log_LD(old_dirty_seq);
+  } else if (h->file->envelope_mode() &&
+	     h->file->fnode.content_size > old_content_size) {
+    // a plain file would have logged its new size, which costs at
+    // least one block appended to the log
+    logger->inc(l_bluefs_wal_log_syncs_avoided);
+    logger->inc(l_bluefs_wal_log_bytes_avoided, super.block_size);
   }
   _maybe_compact_log_LNF_NF_LD_D();
   logger->tinc_with_max(l_bluefs_fsync_lat, mono_clock::now() - t0);
@@ -4839,6 +4851,9 @@ int BlueFS::open_for_write(
     if (logger && !overwrite) {
       logger->inc(l_bluefs_files_written_wal);
     }
+    if (create && file->envelope_mode()) {
+      _preallocate_wal(file);
+    }
   } else if (boost::algorithm::ends_with(filename, ".sst")) {
     (*h)->writer_type = BlueFS::WRITER_SST;
     if (logger) {
@@ -4861,6 +4876,37 @@ int BlueFS::open_for_write(
   return 0;
 }
 
+// Give a new envelope mode WAL file all the space it is expected to use.
+// The extents are logged along with the file creation, and as envelope
+// appends do not touch metadata, later fsyncs never need the log until
+// the file outgrows the preallocation. Recycled WAL files keep their
+// extents, so they stay log free.
+void BlueFS::_preallocate_wal(FileRef file)
+{
+  ceph_assert(ceph_mutex_is_locked(log.lock));
+  ceph_assert(ceph_mutex_is_locked(nodes.lock));
+  uint64_t want = cct->_conf.get_val<Option::size_t>("bluefs_wal_envelope_prealloc");
+  uint64_t allocated = file->fnode.get_allocated();
+  if (want <= allocated) {
+    return;
+  }
+  int r = _allocate(vselector->select_prefer_bdev(file->vselector_hint),
+		    want - allocated,
+		    0,
+		    &file->fnode,
+		    [&](const bluefs_extent_t& e) {
+		      vselector->add_usage(file->vselector_hint, e);
+		    });
+  if (r < 0) {
+    // not fatal, the file will grow on demand
+    dout(1) << __func__ << " unable to preallocate 0x" << std::hex
+	    << want - allocated << std::dec << " for " << file->fnode
+	    << ": " << cpp_strerror(r) << dendl;
+    return;
+  }
+  dout(20) << __func__ << " " << file->fnode << dendl;
+}
+
 BlueFS::FileWriter *BlueFS::_create_writer(FileRef f)
 {
   FileWriter *w = new FileWriter(f, super.block_size);
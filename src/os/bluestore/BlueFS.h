@@ -88,6 +88,8 @@ enum {
   l_bluefs_wal_alloc_lat,
   l_bluefs_db_alloc_lat,
   l_bluefs_slow_alloc_lat,
+  l_bluefs_wal_log_syncs_avoided,
+  l_bluefs_wal_log_bytes_avoided,
   l_bluefs_last,
 };
 
@@ -700,6 +702,7 @@ private:
 
   typedef std::function<void(const bluefs_extent_t)> update_fn_t;
   void _update_allocate_stats(uint8_t id, const ceph::timespan& d);
+  void _preallocate_wal(FileRef file);
   int _allocate(uint8_t bdev, uint64_t len,
                 uint64_t alloc_unit,
 		bluefs_fnode_t* node,
@@ -143,6 +143,7 @@ const string PREFIX_DEFERRED = "L";    // id -> deferred_transaction_t
 const string PREFIX_ALLOC = "B";       // u64 offset -> u64 length (freelist)
 const string PREFIX_ALLOC_BITMAP = "b";// (see BitmapFreelistManager)
 const string PREFIX_SHARED_BLOB = "X"; // u64 SB id -> shared_blob_t
+const string PREFIX_ALLOC_DELTA = "D"; // u64 seq -> allocated, released extents
 
 const string BLUESTORE_GLOBAL_STATFS_KEY = "bluestore_statfs";
 
@@ -570,6 +571,11 @@ static void get_deferred_key(uint64_t seq, string *out)
   _key_encode_u64(seq, out);
 }
 
+static void get_alloc_delta_key(uint64_t seq, string *out)
+{
+  _key_encode_u64(seq, out);
+}
+
 static void get_pool_stat_key(int64_t pool_id, string *key)
 {
   key->clear();
@@ -1107,6 +1113,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     o->set_cached();
     if (o->pin_nref == 1) {
       (level > 0) ? lru.push_front(*o) : lru.push_back(*o);
+      o->in_lru = true;
       o->cache_age_bin = age_bins.front();
       *(o->cache_age_bin) += 1;
     }
@@ -1120,6 +1127,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     if (o->lru_item.is_linked()) {
       *(o->cache_age_bin) -= 1;
       lru.erase(lru.iterator_to(*o));
+      o->in_lru = false;
     }
     ceph_assert(num);
     --num;
@@ -1129,7 +1137,18 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
   void maybe_unpin(BlueStore::Onode* o) override
   {
     OnodeCacheShard* ocs = this;
-    ocs->lock.lock();
+    if (!ocs->lock.try_lock()) {
+      // The shard is busy. If the onode is still linked into the LRU
+      // the only thing left to do is to touch it, which is skipped
+      // rather than queueing up on the lock: a hot onode keeps its
+      // current position and will be touched by one of its next users.
+      // Eviction can't be missed here since _trim_to() unlinks first
+      // and checks the pin afterwards.
+      if (o->in_lru) {
+        return;
+      }
+      ocs->lock.lock();
+    }
     // It is possible that during waiting split_cache moved us to different OnodeCacheShard.
     while (ocs != o->c->get_onode_cache()) {
       ocs->lock.unlock();
@@ -1140,18 +1159,25 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
       if(!o->lru_item.is_linked()) {
         if (o->exists) {
 	  lru.push_front(*o);
+	  o->in_lru = true;
 	  o->cache_age_bin = age_bins.front();
 	  *(o->cache_age_bin) += 1;
 	  dout(20) << __func__ << " " << this << " " << o->oid << " unpinned"
                    << dendl;
         } else {
-	  ceph_assert(num);
-	  --num;
-	  o->clear_cached();
-	  dout(20) << __func__ << " " << this << " " << o->oid << " removed"
-                   << dendl;
-          // remove will also decrement nref
-          o->c->onode_space._remove(o->oid);
+          // releasing the detached ref will also decrement nref
+          auto detached = o->c->onode_space._detach_unpinned(o);
+          if (detached) {
+	    ceph_assert(num);
+	    --num;
+	    o->clear_cached();
+	    dout(20) << __func__ << " " << this << " " << o->oid << " removed"
+                     << dendl;
+          } else {
+            // lookup() has pinned it again, next unpin will take care
+	    dout(20) << __func__ << " " << this << " " << o->oid << " repinned"
+                     << dendl;
+          }
         }
       } else if (o->exists) {
         // move onode within LRU
@@ -1181,18 +1207,19 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     while (n-- > 0 && lru.size() > 0) {
       BlueStore::Onode *o = &lru.back();
       lru.pop_back();
+      o->in_lru = false;
 
       dout(20) << __func__ << "  rm " << o->oid << " "
                << o->nref << " " << o->cached << dendl;
 
       *(o->cache_age_bin) -= 1;
-      if (o->pin_nref > 1) {
+      auto detached = o->c->onode_space._detach_unpinned(o);
+      if (!detached) {
         dout(20) << __func__ << " " << this << " " << " " << " " << o->oid << dendl;
       } else {
 	ceph_assert(num);
         --num;
         o->clear_cached();
-        o->c->onode_space._remove(o->oid);
       }
     }
   }
@@ -1694,6 +1721,117 @@ BlueStore::BufferCacheShard *BlueStore::BufferCacheShard::create(
   return c;
 }
 
+// CompressedBlobCache
+
+#undef dout_prefix
+#define dout_prefix *_dout << "bluestore.CompressedBlobCache(" << this << ") "
+
+bool BlueStore::CompressedBlobCache::lookup(
+  const bluestore_blob_t& blob,
+  bufferlist* bl)
+{
+  auto& exts = blob.get_extents();
+  if (exts.size() != 1 || !exts.front().is_valid()) {
+    return false;
+  }
+  std::lock_guard l(lock);
+  auto p = entries.find(exts.front().offset);
+  if (p == entries.end() || p->second.disk_len != blob.get_ondisk_size()) {
+    return false;
+  }
+  Entry& e = p->second;
+  dout(20) << __func__ << " hit 0x" << std::hex << e.offset << "~"
+           << e.disk_len << std::dec << dendl;
+  lru.erase(lru.iterator_to(e));
+  lru.push_front(e);
+  if (e.cache_age_bin != age_bins.front()) {
+    *(e.cache_age_bin) -= e.bl.length();
+    e.cache_age_bin = age_bins.front();
+    *(e.cache_age_bin) += e.bl.length();
+  }
+  *bl = e.bl;
+  return true;
+}
+
+void BlueStore::CompressedBlobCache::add(
+  const bluestore_blob_t& blob,
+  const bufferlist& bl)
+{
+  auto& exts = blob.get_extents();
+  // only contiguous blobs, so that an entry covers offset~disk_len exactly
+  if (exts.size() != 1 || !exts.front().is_valid() || max == 0) {
+    return;
+  }
+  std::lock_guard l(lock);
+  auto [p, inserted] = entries.try_emplace(
+    exts.front().offset, exts.front().offset, blob.get_ondisk_size(), bl);
+  if (!inserted) {
+    return; // raced with another reader
+  }
+  Entry& e = p->second;
+  dout(20) << __func__ << " 0x" << std::hex << e.offset << "~"
+           << e.disk_len << std::dec << dendl;
+  e.bl.reassign_to_mempool(mempool::mempool_bluestore_cache_data);
+  lru.push_front(e);
+  e.cache_age_bin = age_bins.front();
+  *(e.cache_age_bin) += e.bl.length();
+  bytes += e.bl.length();
+  ++num;
+  _trim();
+}
+
+void BlueStore::CompressedBlobCache::invalidate(
+  const interval_set<uint64_t>& released)
+{
+  std::lock_guard l(lock);
+  if (entries.empty()) {
+    return;
+  }
+  for (auto r = released.begin(); r != released.end(); ++r) {
+    // an entry is keyed by its first offset, a blob starting before the
+    // released range may still cover it
+    auto p = entries.lower_bound(r.get_start());
+    if (p != entries.begin()) {
+      auto prev = std::prev(p);
+      if (prev->first + prev->second.disk_len > r.get_start()) {
+        p = prev;
+      }
+    }
+    while (p != entries.end() && p->first < r.get_end()) {
+      dout(20) << __func__ << " drop 0x" << std::hex << p->first << "~"
+               << p->second.disk_len << std::dec << dendl;
+      _rm(p++);
+    }
+  }
+}
+
+void BlueStore::CompressedBlobCache::_rm(decltype(entries)::iterator p)
+{
+  Entry& e = p->second;
+  lru.erase(lru.iterator_to(e));
+  *(e.cache_age_bin) -= e.bl.length();
+  ceph_assert(bytes >= e.bl.length());
+  bytes -= e.bl.length();
+  ceph_assert(num);
+  --num;
+  entries.erase(p);
+}
+
+void BlueStore::CompressedBlobCache::_trim_to(uint64_t new_bytes)
+{
+  while (bytes > new_bytes && !lru.empty()) {
+    _rm(entries.find(lru.back().offset));
+  }
+}
+
+void BlueStore::CompressedBlobCache::add_stats(uint64_t *blobs,
+                                               uint64_t *bytes_out)
+{
+  std::lock_guard l(lock);
+  *blobs += num;
+  *bytes_out += bytes;
+}
+
 // Buffer
 std::atomic<uint64_t> BlueStore::Buffer::total = 0;
 
@@ -2065,13 +2203,16 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add_onode(const ghobject_t& oid,
   OnodeRef& o)
 {
   std::lock_guard l(cache->lock);
-  // add entry or return existing one
-  auto p = onode_map.emplace(oid, o);
-  if (!p.second) {
-    ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
-			  << " raced, returning existing " << p.first->second
-			  << dendl;
-    return p.first->second;
+  {
+    std::unique_lock ml(map_lock);
+    // add entry or return existing one
+    auto p = onode_map.emplace(oid, o);
+    if (!p.second) {
+      ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
+			    << " raced, returning existing " << p.first->second
+			    << dendl;
+      return p.first->second;
+    }
   }
   ldout(cache->cct, 20) << __func__ << " " << oid << " " << o << dendl;
   cache->_add(o.get(), 1);
@@ -2079,10 +2220,20 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add_onode(const ghobject_t& oid,
   return o;
 }
 
-void BlueStore::OnodeSpace::_remove(const ghobject_t& oid)
+BlueStore::OnodeRef BlueStore::OnodeSpace::_detach_unpinned(Onode* o)
 {
-  ldout(cache->cct, 20) << __func__ << " " << oid << " " << dendl;
-  onode_map.erase(oid);
+  OnodeRef detached;
+  // lookup() pins under the shared map_lock, so pin_nref can't grow
+  // while we hold it exclusively.
+  std::unique_lock l(map_lock);
+  if (o->pin_nref == 1) {
+    auto p = onode_map.find(o->oid);
+    ceph_assert(p != onode_map.end() && p->second.get() == o);
+    ldout(cache->cct, 20) << __func__ << " " << o->oid << " " << dendl;
+    detached = std::move(p->second);
+    onode_map.erase(p);
+  }
+  return detached;
 }
 
 BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
@@ -2091,7 +2242,7 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
   OnodeRef o;
 
   {
-    std::lock_guard l(cache->lock);
+    std::shared_lock l(map_lock);
     auto p = onode_map.find(oid);
     if (p == onode_map.end()) {
       ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
@@ -2115,16 +2266,21 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 void BlueStore::OnodeSpace::clear()
 {
   std::lock_guard l(cache->lock);
-  ldout(cache->cct, 10) << __func__ << " " << onode_map.size()<< dendl;
-  for (auto &p : onode_map) {
-    cache->_rm(p.second.get());
+  // drop the references once map_lock is released
+  decltype(onode_map) to_release;
+  {
+    std::unique_lock ml(map_lock);
+    ldout(cache->cct, 10) << __func__ << " " << onode_map.size()<< dendl;
+    for (auto &p : onode_map) {
+      cache->_rm(p.second.get());
+    }
+    onode_map.swap(to_release);
   }
-  onode_map.clear();
 }
 
 bool BlueStore::OnodeSpace::empty()
 {
-  std::lock_guard l(cache->lock);
+  std::shared_lock l(map_lock);
   return onode_map.empty();
 }
 
@@ -2137,36 +2293,44 @@ void BlueStore::OnodeSpace::rename(
   std::lock_guard l(cache->lock);
   ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
 			<< dendl;
-  auto po = onode_map.find(old_oid);
-  auto pn = onode_map.find(new_oid);
-  ceph_assert(po != pn);
+  // released once map_lock is dropped
+  OnodeRef target;
+  OnodeRef o;
+  {
+    std::unique_lock ml(map_lock);
+    auto po = onode_map.find(old_oid);
+    auto pn = onode_map.find(new_oid);
+    ceph_assert(po != pn);
+
+    ceph_assert(po != onode_map.end());
+    if (pn != onode_map.end()) {
+      ldout(cache->cct, 30) << __func__ << "  removing target " << pn->second
+			    << dendl;
+      cache->_rm(pn->second.get());
+      target = std::move(pn->second);
+      onode_map.erase(pn);
+    }
+    o = po->second;
 
-  ceph_assert(po != onode_map.end());
-  if (pn != onode_map.end()) {
-    ldout(cache->cct, 30) << __func__ << "  removing target " << pn->second
-			  << dendl;
-    cache->_rm(pn->second.get());
-    onode_map.erase(pn);
-  }
-  OnodeRef o = po->second;
-
-  // install a non-existent onode at old location
-  oldo.reset(new Onode(o->c, old_oid, o->key));
-  po->second = oldo;
-  cache->_add(oldo.get(), 1);
-  // add at new position and fix oid, key.
-  // This will pin 'o' and implicitly touch cache
-  // when it will eventually become unpinned
-  onode_map.insert(make_pair(new_oid, o));
-
-  o->oid = new_oid;
-  o->key = new_okey;
+    // install a non-existent onode at old location
+    oldo.reset(new Onode(o->c, old_oid, o->key));
+    po->second = oldo;
+    cache->_add(oldo.get(), 1);
+    // add at new position and fix oid, key.
+    // This will pin 'o' and implicitly touch cache
+    // when it will eventually become unpinned
+    onode_map.insert(make_pair(new_oid, o));
+
+    o->oid = new_oid;
+    o->key = new_okey;
+  }
   cache->_trim_some();
 }
 
 bool BlueStore::OnodeSpace::map_any(std::function<bool(Onode*)> f)
 {
   std::lock_guard l(cache->lock);
+  std::shared_lock ml(map_lock);
   ldout(cache->cct, 20) << __func__ << dendl;
   for (auto& i : onode_map) {
     if (f(i.second.get())) {
@@ -5415,13 +5579,19 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
   int r = -ENOENT;
   Onode *on;
   if (!is_createop) {
-    r = store->db->get(PREFIX_OBJ, key.c_str(), key.size(), &v);
-    ldout(store->cct, 20) << " r " << r << " v.len " << v.length() << dendl;
+    if (!onode_filter_may_contain(key)) {
+      ldout(store->cct, 20) << " not in onode filter" << dendl;
+      store->logger->inc(l_bluestore_onode_filter_skips);
+    } else {
+      r = store->db->get(PREFIX_OBJ, key.c_str(), key.size(), &v);
+      ldout(store->cct, 20) << " r " << r << " v.len " << v.length() << dendl;
+    }
   }
   if (v.length() == 0) {
     ceph_assert(r == -ENOENT);
     if (!create)
       return OnodeRef();
+    onode_filter_insert(key);
   } else {
     ceph_assert(r >= 0);
   }
@@ -5432,6 +5602,46 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
   return onode_space.add_onode(oid, o);
 }
 
+// the filter never shrinks on its own; collections created at runtime
+// start with room for this many objects
+static constexpr size_t ONODE_FILTER_MIN_COUNT = 64 * 1024;
+
+static uint32_t onode_filter_hash(std::string_view key)
+{
+  return ceph_str_hash_rjenkins(key.data(), key.size());
+}
+
+void BlueStore::Collection::reset_onode_filter(size_t expected_count)
+{
+  onode_filter = std::make_unique<bloom_filter>(
+    std::max(expected_count, ONODE_FILTER_MIN_COUNT),
+    store->cct->_conf->bluestore_onode_miss_filter_fpp,
+    0);
+}
+
+void BlueStore::Collection::onode_filter_insert(std::string_view key)
+{
+  if (!onode_filter) {
+    return;
+  }
+  if (onode_filter->is_full()) {
+    // past its target count the filter lets most misses through anyway;
+    // fall back to plain lookups until it is rebuilt on the next mount
+    ldout(store->cct, 5) << __func__ << " " << cid << " onode filter full ("
+			 << onode_filter->element_count()
+			 << " keys), disabling" << dendl;
+    onode_filter.reset();
+    return;
+  }
+  onode_filter->insert(onode_filter_hash(key));
+}
+
+bool BlueStore::Collection::onode_filter_may_contain(
+  std::string_view key) const
+{
+  return !onode_filter || onode_filter->contains(onode_filter_hash(key));
+}
+
 void BlueStore::Collection::split_cache(
   Collection *dest)
 {
@@ -5446,6 +5656,9 @@ void BlueStore::Collection::split_cache(
   std::lock_guard l2(ocache_dest->lock, std::adopt_lock);
   std::lock_guard l3(cache->lock, std::adopt_lock);
   std::lock_guard l4(dest->cache->lock, std::adopt_lock);
+  // onode_map's map_lock isn't needed: lookups are fenced off by the
+  // exclusively held collection locks and all the other writers need
+  // the onode cache shard locks taken above.
 
   int destbits = dest->cnode.bits;
   spg_t destpg;
@@ -5575,6 +5788,9 @@ void *BlueStore::MempoolThread::entry()
     if (binned_kv_onode_cache != nullptr) {
       pcm->insert("kv_onode", binned_kv_onode_cache, true);
     }
+    if (store->compressed_cache) {
+      pcm->insert("compressed_data", compressed_data_cache, true);
+    }
   }
 
   utime_t next_balance = ceph_clock_now();
@@ -5616,6 +5832,9 @@ void *BlueStore::MempoolThread::entry()
       }
       meta_cache->import_bins(store->meta_bins);
       data_cache->import_bins(store->data_bins);
+      if (store->compressed_cache) {
+        compressed_data_cache->import_bins(store->data_bins);
+      }
 
       if (pcm != nullptr) {
         pcm->shift_bins();
@@ -5633,6 +5852,9 @@ void *BlueStore::MempoolThread::entry()
       }
       meta_cache->set_cache_ratio(store->cache_meta_ratio);
       data_cache->set_cache_ratio(store->cache_data_ratio);
+      if (store->compressed_cache) {
+        compressed_data_cache->set_cache_ratio(store->cache_compressed_ratio);
+      }
 
       // Log events at 5 instead of 20 when balance happens.
       interval_stats_trim = true;
@@ -5714,6 +5936,8 @@ void BlueStore::MempoolThread::_resize_shards(bool interval_stats)
      static_cast<int64_t>(store->cache_meta_ratio * cache_size);
   int64_t data_alloc =
      static_cast<int64_t>(store->cache_data_ratio * cache_size);
+  int64_t compressed_alloc =
+     static_cast<int64_t>(store->cache_compressed_ratio * cache_size);
 
   if (pcm != nullptr && binned_kv_cache != nullptr) {
     cache_size = pcm->get_tuned_mem();
@@ -5723,6 +5947,9 @@ void BlueStore::MempoolThread::_resize_shards(bool interval_stats)
     if (binned_kv_onode_cache != nullptr) {
       kv_onode_alloc = binned_kv_onode_cache->get_committed_size();
     }
+    if (store->compressed_cache) {
+      compressed_alloc = compressed_data_cache->get_committed_size();
+    }
   }
   
   if (interval_stats) {
@@ -5760,6 +5987,10 @@ void BlueStore::MempoolThread::_resize_shards(bool interval_stats)
   for (auto i : store->buffer_cache_shards) {
     i->set_max(max_shard_buffer);
   }
+  if (store->compressed_cache) {
+    dout(30) << __func__ << " compressed_alloc: " << compressed_alloc << dendl;
+    store->compressed_cache->set_max(compressed_alloc);
+  }
 }
 
 void BlueStore::MempoolThread::_update_cache_settings()
@@ -5829,6 +6060,7 @@ BlueStore::BlueStore(CephContext *cct,
   : ObjectStore(cct, path),
     throttle(cct),
     finisher(cct, "commit_finisher", "cfin"),
+    alloc_delta_finisher(cct, "alloc_delta_finisher", "bstore_adelta"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
     min_alloc_size(_min_alloc_size),
@@ -6223,20 +6455,46 @@ int BlueStore::_set_cache_sizes()
     return -EINVAL;
   }
 
+  cache_compressed_ratio =
+    cct->_conf.get_val<double>("bluestore_cache_compressed_ratio");
+  if (cache_compressed_ratio < 0 || cache_compressed_ratio > 1.0) {
+    derr << __func__ << " bluestore_cache_compressed_ratio ("
+         << cache_compressed_ratio
+         << ") must be in range [0,1.0]" << dendl;
+    return -EINVAL;
+  }
+
+  if (cache_meta_ratio + cache_kv_ratio + cache_kv_onode_ratio +
+      cache_compressed_ratio > 1.0) {
+    derr << __func__ << " bluestore_cache_compressed_ratio ("
+         << cache_compressed_ratio
+         << ") leaves no room in the cache; must be <= "
+         << 1.0 - cache_meta_ratio - cache_kv_ratio - cache_kv_onode_ratio
+         << dendl;
+    return -EINVAL;
+  }
+
   cache_data_ratio = (double)1.0 - 
                      (double)cache_meta_ratio - 
                      (double)cache_kv_ratio - 
-                     (double)cache_kv_onode_ratio;
+                     (double)cache_kv_onode_ratio -
+                     (double)cache_compressed_ratio;
   if (cache_data_ratio < 0) {
     // deal with floating point imprecision
     cache_data_ratio = 0;
   }
+  if (cache_compressed_ratio > 0) {
+    compressed_cache.reset(new CompressedBlobCache(cct));
+  } else {
+    compressed_cache.reset();
+  }
     
   dout(1) << __func__ << " cache_size " << cache_size
           << " meta " << cache_meta_ratio
 	  << " kv " << cache_kv_ratio
 	  << " kv_onode " << cache_kv_onode_ratio
 	  << " data " << cache_data_ratio
+	  << " compressed " << cache_compressed_ratio
 	  << dendl;
   return 0;
 }
@@ -6364,6 +6622,8 @@ void BlueStore::_init_logger()
 	    "au_b",
 	    PerfCountersBuilder::PRIO_CRITICAL,
 	    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_alloc_delta_compactions, "alloc_delta_compactions",
+		    "Count of allocation delta batches merged into one");
   //****************************************
 
   // Update op processing state latencies
@@ -6452,6 +6712,14 @@ void BlueStore::_init_logger()
   b.add_time_avg(l_bluestore_kv_final_lat, "kv_final_lat",
 		 "Average kv_finalize thread latency",
 		 "kfll", PerfCountersBuilder::PRIO_INTERESTING);
+  b.add_u64_counter(l_bluestore_kv_coalesced_txc, "kv_coalesced_txc",
+		    "Transactions submitted as part of a coalesced kv batch");
+  b.add_u64_counter(l_bluestore_kv_coalesce_saved_ops, "kv_coalesce_saved_ops",
+		    "Overridden kv operations dropped by batch coalescing");
+  b.add_u64_counter(l_bluestore_kv_coalesce_saved_bytes,
+		    "kv_coalesce_saved_bytes",
+		    "Bytes of kv writes saved by batch coalescing",
+		    NULL, 0, unit_t(UNIT_BYTES));
   //****************************************
 
   // write op stats
@@ -6576,6 +6844,8 @@ void BlueStore::_init_logger()
 	    "Number of blobs in cache");
   b.add_u64(l_bluestore_spanning_blobs, "onode_spanning_blobs",
             "Number of spanning blobs in loaded onodes");
+  b.add_u64_counter(l_bluestore_onode_filter_skips, "onode_filter_skips",
+		    "Count of onode lookups avoided by the onode miss filter");
   //****************************************
 
   // buffer cache stats
@@ -6597,6 +6867,17 @@ void BlueStore::_init_logger()
 	    NULL,
 	    PerfCountersBuilder::PRIO_DEBUGONLY,
 	    unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_compressed_cache_bytes, "compressed_cache_bytes",
+	    "Number of compressed blob bytes in cache",
+	    NULL,
+	    PerfCountersBuilder::PRIO_DEBUGONLY,
+	    unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_compressed_cache_hit_bytes,
+	    "compressed_cache_hit_bytes",
+	    "Sum for compressed bytes read from the compressed blob cache",
+	    NULL,
+	    PerfCountersBuilder::PRIO_DEBUGONLY,
+	    unit_t(UNIT_BYTES));
   //****************************************
 
   // internal stats
@@ -7500,6 +7781,7 @@ int BlueStore::_create_alloc()
 
 int BlueStore::_init_alloc()
 {
+  alloc_deltas = false;
   int r = _create_alloc();
   if (r < 0) {
     return r;
@@ -7540,6 +7822,9 @@ int BlueStore::_init_alloc()
         alloc->init_add_free(before_expansion_bdev_size,
                              bdev_label.size - before_expansion_bdev_size);
         need_to_destage_allocation_file = true;
+      } else {
+        // the file is a valid base, keep journaling on top of it
+        alloc_deltas = cct->_conf->bluestore_allocation_deltas;
       }
     } else {
       // This must mean that we had an unplanned shutdown and didn't manage to destage the allocator
@@ -7770,8 +8055,8 @@ bool BlueStore::_use_rotational_settings()
 
 bool BlueStore::is_statfs_recoverable() const
 {
-  // abuse fm for now
-  return has_null_manager();
+  // abuse fm for now, with allocation deltas statfs is persisted per txc
+  return has_null_manager() && !alloc_deltas;
 }
 
 bool BlueStore::test_mount_in_use()
@@ -8052,6 +8337,12 @@ int BlueStore::_open_db_and_around(bool read_only, bool to_repair)
     _main_bdev_label_try_reserve();
   }
 
+  // repair updates allocations behind the txc path, it has to go
+  // through a freshly stored allocation file
+  if (read_only || to_repair) {
+    alloc_deltas = false;
+  }
+
   // Re-open in the proper mode(s).
 
   // Can't simply bypass second open for read-only mode as we need to
@@ -8080,6 +8371,7 @@ int BlueStore::_open_db_and_around(bool read_only, bool to_repair)
       derr << __func__ << "::NCB::invalidate_allocation_file_on_bluefs() failed!" << dendl;
       goto out_alloc;
     }
+    purge_allocation_deltas();
   }
 
   // when function is called in repair mode (to_repair=true) we skip db->open()/create()
@@ -8369,7 +8661,8 @@ void BlueStore::_close_db()
            << " per_pool=" << per_pool_stat_collection
            << " pool stats=" << osd_pools.size()
            << dendl;
-  bool do_destage = !db_was_opened_read_only && need_to_destage_allocation_file;
+  bool do_destage = !db_was_opened_read_only && need_to_destage_allocation_file &&
+    !cct->_conf->bluestore_debug_skip_allocation_destage;
   if (do_destage && is_statfs_recoverable()) {
     auto t = db->get_transaction();
     store_statfs_t s;
@@ -8505,6 +8798,56 @@ int BlueStore::_open_collections()
   return 0;
 }
 
+void BlueStore::_build_onode_filters()
+{
+  dout(10) << __func__ << dendl;
+  auto start_time = mono_clock::now();
+  size_t total = 0;
+  std::vector<uint32_t> hashes;
+  for (auto& [cid, c] : coll_map) {
+    ghobject_t temp_start, temp_end, start, end;
+    get_coll_range(cid, c->cnode.bits, &temp_start, &temp_end, &start, &end,
+		   true);
+    hashes.clear();
+    auto scan = [&](const ghobject_t& low, const ghobject_t& high) {
+      if (low >= high) {
+	return;
+      }
+      // key prefixes only carry shard, pool and hash, so this may also
+      // pick up a few keys of the neighbouring collection; extra entries
+      // merely cost false positives.
+      std::string kv_low_key, kv_high_key;
+      _key_encode_prefix(low, &kv_low_key);
+      _key_encode_prefix(high, &kv_high_key);
+      kv_high_key.push_back('\xff');
+      auto it = db->get_iterator(
+	PREFIX_OBJ, KeyValueDB::ITERATOR_NOCACHE,
+	KeyValueDB::IteratorBounds{kv_low_key, kv_high_key});
+      for (it->lower_bound(kv_low_key); it->valid(); it->next()) {
+	string key = it->key();
+	if (!is_extent_shard_key(key)) {
+	  hashes.push_back(onode_filter_hash(key));
+	}
+      }
+    };
+    scan(temp_start, temp_end);
+    scan(start, end);
+
+    std::unique_lock l(c->lock);
+    // leave room for the collection to double before the filter fills up
+    c->reset_onode_filter(hashes.size() * 2);
+    for (auto h : hashes) {
+      c->onode_filter->insert(h);
+    }
+    dout(20) << __func__ << " " << cid << " " << hashes.size() << " onodes"
+	     << dendl;
+    total += hashes.size();
+  }
+  dout(1) << __func__ << " " << coll_map.size() << " collections, "
+	  << total << " onodes in "
+	  << timespan_str(mono_clock::now() - start_time) << dendl;
+}
+
 void BlueStore::_fsck_collections(int64_t* errors)
 {
   if (collections_had_errors) {
@@ -9721,6 +10064,10 @@ int BlueStore::_mount()
     }
   }
 
+  if (cct->_conf->bluestore_onode_miss_filter) {
+    _build_onode_filters();
+  }
+
   if (bluefs && cct->_conf.get_val<bool>("bluefs_spillover_cleaner")) {
     bluefs->spillover_cleaner_start();
   }
@@ -12662,6 +13009,12 @@ void BlueStore::refresh_perf_counters()
   logger->set(l_bluestore_blobs, num_blobs);
   logger->set(l_bluestore_buffers, num_buffers);
   logger->set(l_bluestore_buffer_bytes, num_buffer_bytes);
+  if (compressed_cache) {
+    uint64_t num_compressed_blobs = 0;
+    uint64_t num_compressed_bytes = 0;
+    compressed_cache->add_stats(&num_compressed_blobs, &num_compressed_bytes);
+    logger->set(l_bluestore_compressed_cache_bytes, num_compressed_bytes);
+  }
 }
 
 // ---------------
@@ -12994,7 +13347,8 @@ void BlueStore::_read_cache(
 int BlueStore::_prepare_read_ioc(
   blobs2read_t& blobs2read,
   vector<bufferlist>* compressed_blob_bls,
-  IOContext* ioc)
+  IOContext* ioc,
+  int read_cache_policy)
 {
   for (auto& p : blobs2read) {
     const BlobRef& bptr = p.first;
@@ -13009,6 +13363,12 @@ int BlueStore::_prepare_read_ioc(
       }
       compressed_blob_bls->push_back(bufferlist());
       bufferlist& bl = compressed_blob_bls->back();
+      if (compressed_cache &&
+          read_cache_policy != BufferSpace::BYPASS_CLEAN_CACHE &&
+          compressed_cache->lookup(bptr->get_blob(), &bl)) {
+        logger->inc(l_bluestore_compressed_cache_hit_bytes, bl.length());
+        continue;
+      }
       auto r = bptr->get_blob().map(
         0, bptr->get_blob().get_ondisk_size(),
         [&](uint64_t offset, uint64_t length) {
@@ -13067,6 +13427,7 @@ int BlueStore::_generate_read_result_bl(
   ready_regions_t& ready_regions,
   vector<bufferlist>& compressed_blob_bls,
   blobs2read_t& blobs2read,
+  const IOContext& ioc,
   bool buffered,
   bool* csum_error,
   bufferlist& bl)
@@ -13089,6 +13450,9 @@ int BlueStore::_generate_read_result_bl(
         *csum_error = true;
         return -EIO;
       }
+      if (buffered && compressed_cache && !ioc.skip_cache(compressed_bl)) {
+        compressed_cache->add(bptr->get_blob(), compressed_bl);
+      }
       bufferlist raw_bl;
       auto r = _decompress(compressed_bl, &raw_bl);
       if (r < 0)
@@ -13113,8 +13477,9 @@ int BlueStore::_generate_read_result_bl(
         }
 
         // prune and keep result
+        bool cache_req = buffered && !ioc.skip_cache(req.bl);
         for (const auto& r : req.regs) {
-          if (buffered) {
+          if (cache_req) {
             bufferlist region_buffer;
             region_buffer.substr_of(req.bl, r.front, r.length);
             // need offset before padding
@@ -13269,7 +13634,8 @@ int BlueStore::_do_read(
                              // The error isn't that much...
   vector<bufferlist> compressed_blob_bls;
   IOContext ioc(cct, NULL, !cct->_conf->bluestore_fail_eio);
-  r = _prepare_read_ioc(blobs2read, &compressed_blob_bls, &ioc);
+  r = _prepare_read_ioc(blobs2read, &compressed_blob_bls, &ioc,
+                        read_cache_policy);
   // we always issue aio for reading, so errors other than EIO are not allowed
   if (r < 0)
     return r;
@@ -13321,7 +13687,7 @@ int BlueStore::_do_read(
 
   bool csum_error = false;
   r = _generate_read_result_bl(o, offset, length, ready_regions,
-                              compressed_blob_bls, blobs2read,
+                              compressed_blob_bls, blobs2read, ioc,
                               buffered && !ioc.skip_cache(),
                               &csum_error, bl);
   if (csum_error) {
@@ -13678,7 +14044,8 @@ int BlueStore::_do_readv(
     raw_results.push_back({});
     _read_cache(o, p.get_start(), p.get_len(), read_cache_policy,
                 std::get<0>(raw_results[i]), std::get<2>(raw_results[i]));
-    r = _prepare_read_ioc(std::get<2>(raw_results[i]), &std::get<1>(raw_results[i]), &ioc);
+    r = _prepare_read_ioc(std::get<2>(raw_results[i]), &std::get<1>(raw_results[i]), &ioc,
+                          read_cache_policy);
     // we always issue aio for reading, so errors other than EIO are not allowed
     if (r < 0)
       return r;
@@ -13744,7 +14111,7 @@ int BlueStore::_do_readv(
                                  std::get<0>(raw_results[i]),
                                  std::get<1>(raw_results[i]),
                                  std::get<2>(raw_results[i]),
-                                 buffered, &csum_error, t);
+                                 ioc, buffered, &csum_error, t);
     if (csum_error) {
       // Handles spurious read errors caused by a kernel bug.
       // We sometimes get all-zero pages as a result of the read under
@@ -14964,11 +15331,47 @@ void BlueStore::_txc_finalize_kv(TransContext *txc, KeyValueDB::Transaction t)
 	       << "~" << p.get_len() << std::dec << dendl;
       fm->release(p.get_start(), p.get_len(), t);
     }
+  } else if (alloc_deltas &&
+	     (!txc->allocated.empty() || !txc->released.empty())) {
+    _txc_journal_alloc_delta(txc, t);
   }
 
   _txc_update_store_statfs(txc);
 }
 
+void BlueStore::_txc_journal_alloc_delta(TransContext *txc,
+					 KeyValueDB::Transaction t)
+{
+  // A txc can only reuse space released by a txc that has already
+  // committed, so numbering at this point orders the deltas causally.
+  bufferlist bl;
+  encode(txc->allocated, bl);
+  encode(txc->released, bl);
+  string key;
+  {
+    std::lock_guard l(alloc_delta_lock);
+    txc->alloc_delta_seq = ++alloc_delta_seq;
+    alloc_delta_uncommitted.insert(txc->alloc_delta_seq);
+  }
+  get_alloc_delta_key(txc->alloc_delta_seq, &key);
+  t->set(PREFIX_ALLOC_DELTA, key, bl);
+}
+
+void BlueStore::_txc_alloc_delta_committed(TransContext *txc)
+{
+  std::lock_guard l(alloc_delta_lock);
+  alloc_delta_uncommitted.erase(txc->alloc_delta_seq);
+  ++alloc_delta_pending;
+  if (!alloc_delta_compacting &&
+      alloc_delta_pending >=
+	cct->_conf->bluestore_allocation_deltas_compact_threshold * alloc_delta_backoff) {
+    alloc_delta_compacting = true;
+    alloc_delta_finisher.queue(new LambdaContext([this](int) {
+      compact_allocation_deltas();
+    }));
+  }
+}
+
 void BlueStore::_txc_apply_kv(TransContext *txc, bool sync_submit_transaction)
 {
   ceph_assert(txc->get_state() == TransContext::STATE_KV_QUEUED);
@@ -14985,11 +15388,6 @@ void BlueStore::_txc_apply_kv(TransContext *txc, bool sync_submit_transaction)
 
     int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction(txc->t);
     ceph_assert(r == 0);
-    txc->set_state(TransContext::STATE_KV_SUBMITTED);
-    if (txc->osr->kv_submitted_waiters) {
-      std::lock_guard l(txc->osr->qlock);
-      txc->osr->qcond.notify_all();
-    }
 
 #if defined(WITH_LTTNG)
     if (txc->tracing) {
@@ -15003,6 +15401,16 @@ void BlueStore::_txc_apply_kv(TransContext *txc, bool sync_submit_transaction)
     }
 #endif
   }
+  _txc_applied_kv(txc);
+}
+
+void BlueStore::_txc_applied_kv(TransContext *txc)
+{
+  txc->set_state(TransContext::STATE_KV_SUBMITTED);
+  if (txc->osr->kv_submitted_waiters) {
+    std::lock_guard l(txc->osr->qlock);
+    txc->osr->qcond.notify_all();
+  }
 
   for (auto ls : { &txc->onodes, &txc->modified_objects }) {
     for (auto& o : *ls) {
@@ -15016,10 +15424,66 @@ void BlueStore::_txc_apply_kv(TransContext *txc, bool sync_submit_transaction)
   }
 }
 
+// Submit the kv transactions of all queued txcs as one batch, leaving
+// out keys that a later txc in the group overwrites anyway (e.g. the
+// onode and extent shards of an object hit by a stream of small appends).
+// Returns false if nothing would be saved; the caller then applies the
+// txcs one by one.
+bool BlueStore::_txc_apply_kv_coalesced(const deque<TransContext*>& txcs)
+{
+  vector<KeyValueDB::Transaction> ts;
+  uint64_t ops = 0, bytes = 0;
+  for (auto txc : txcs) {
+    if (txc->get_state() == TransContext::STATE_KV_QUEUED) {
+      ts.push_back(txc->t);
+      ops += txc->t->get_count();
+      bytes += txc->t->get_size_bytes();
+    }
+  }
+  auto t = db->coalesce_transactions(ts);
+  if (!t) {
+    return false;
+  }
+  ceph_assert(ops >= t->get_count());
+  ceph_assert(bytes >= t->get_size_bytes());
+  dout(20) << __func__ << " " << ts.size() << " txcs, saved "
+	   << ops - t->get_count() << " ops, "
+	   << bytes - t->get_size_bytes() << " bytes" << dendl;
+  logger->inc(l_bluestore_kv_coalesced_txc, ts.size());
+  logger->inc(l_bluestore_kv_coalesce_saved_ops, ops - t->get_count());
+  logger->inc(l_bluestore_kv_coalesce_saved_bytes,
+	      bytes - t->get_size_bytes());
+
+#if defined(WITH_LTTNG)
+  auto start = mono_clock::now();
+#endif
+  int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction(t);
+  ceph_assert(r == 0);
+#if defined(WITH_LTTNG)
+  // every txc of the batch is reported with the latency of the batch
+  auto elapsed = ceph::to_seconds<double>(mono_clock::now() - start);
+  for (auto txc : txcs) {
+    if (txc->tracing && txc->get_state() == TransContext::STATE_KV_QUEUED) {
+      tracepoint(
+	bluestore,
+	transaction_kv_submit_latency,
+	txc->osr->get_sequencer_id(),
+	(uint64_t)txc,
+	false,
+	elapsed);
+    }
+  }
+#endif
+  return true;
+}
+
 void BlueStore::_txc_committed_kv(TransContext *txc)
 {
   dout(20) << __func__ << " txc " << txc << dendl;
   throttle.complete_kv(*txc);
+  if (txc->alloc_delta_seq) {
+    _txc_alloc_delta_committed(txc);
+  }
   {
     std::lock_guard l(txc->osr->qlock);
     txc->set_state(TransContext::STATE_KV_DONE);
@@ -15146,6 +15610,9 @@ void BlueStore::_txc_release_alloc(TransContext *txc)
                !alloc)) {
       goto out;
   }
+  if (compressed_cache) {
+    compressed_cache->invalidate(txc->released);
+  }
   discard_queued = bdev->try_discard(txc->released);
   // if async discard succeeded, will do alloc->release when discard callback
   // else we should release here
@@ -15316,6 +15783,7 @@ void BlueStore::_kv_start()
   dout(10) << __func__ << dendl;
 
   finisher.start();
+  alloc_delta_finisher.start();
   kv_sync_thread.create("bstore_kv_sync");
   kv_finalize_thread.create("bstore_kv_final");
 }
@@ -15353,6 +15821,8 @@ void BlueStore::_kv_stop()
   dout(10) << __func__ << " stopping finishers" << dendl;
   finisher.wait_for_empty();
   finisher.stop();
+  alloc_delta_finisher.wait_for_empty();
+  alloc_delta_finisher.stop();
   dout(10) << __func__ << " stopped" << dendl;
 }
 
@@ -15491,11 +15961,18 @@ void BlueStore::_kv_sync_thread()
 	dout(10) << __func__ << " new_blobid_max " << new_blobid_max << dendl;
       }
 
+      bool coalesced = kv_committing.size() > 1 &&
+	cct->_conf->bluestore_kv_sync_coalesce &&
+	_txc_apply_kv_coalesced(kv_committing);
       for (auto txc : kv_committing) {
 	throttle.log_state_latency(*txc, logger, l_bluestore_state_kv_queued_lat);
 	if (txc->get_state() == TransContext::STATE_KV_QUEUED) {
 	  ++kv_submitted;
-	  _txc_apply_kv(txc, false);
+	  if (coalesced) {
+	    _txc_applied_kv(txc);
+	  } else {
+	    _txc_apply_kv(txc, false);
+	  }
 	  --txc->osr->kv_committing_serially;
 	} else {
 	  ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
@@ -16067,10 +16544,14 @@ int BlueStore::queue_transactions(
   TransContext *txc = _txc_create(static_cast<Collection*>(ch.get()), osr,
 				  &on_commit, op);
 
+  if (use_write_v2) {
+    _txc_reserve_space(txc, tls);
+  }
   for (vector<Transaction>::iterator p = tls.begin(); p != tls.end(); ++p) {
     txc->bytes += (*p).get_num_bytes();
     _txc_add_transaction(txc, &(*p));
   }
+  _txc_release_reserved(txc);
   _txc_calc_cost(txc);
 
   _txc_write_nodes(txc, txc->t);
@@ -16164,6 +16645,82 @@ void BlueStore::_txc_aio_submit(TransContext *txc)
 }
 
 
+// Writes that large never go deferred, so they will likely need new
+// space. Get it for all of them with a single allocator call up front
+// rather than entering the allocator once per write. This happens
+// before the Writer sizes them, so the sizes are a prediction only: a
+// write may still land in already allocated blobs.
+// What the Writer doesn't take is released by _txc_release_reserved()
+// right after _txc_add_transaction(), before the txc is queued, so over
+// reserving only holds space for the time it takes to prepare the txc.
+// Writes that may get compressed are not predictable at all, and with
+// little free space left the reservation could starve other writers,
+// so neither case is reserved for.
+void BlueStore::_txc_reserve_space(TransContext *txc, vector<Transaction>& tls)
+{
+  auto cm = txc->ch->compression_mode.has_value() ?
+    *(txc->ch->compression_mode) :
+    comp_mode.load();
+  if (cm != Compressor::COMP_NONE) {
+    return;
+  }
+  uint64_t min_len = std::max<uint64_t>(prefer_deferred_size, min_alloc_size);
+  std::vector<uint64_t> wants;
+  uint64_t total = 0;
+  for (auto& t : tls) {
+    t.foreach_write_op([&](const Transaction::Op& op) {
+      if (op.len >= min_len) {
+        wants.push_back(p2roundup<uint64_t>(op.len, min_alloc_size));
+        total += wants.back();
+      }
+    });
+  }
+  if (wants.size() < 2 || alloc->get_free() < total * 4) {
+    return;
+  }
+  std::vector<PExtentVector> extents;
+  int64_t r = alloc->allocate_batch(wants, min_alloc_size, 0, 0, &extents);
+  dout(20) << __func__ << " " << wants.size() << " writes, r = " << r << dendl;
+  if (r <= 0) {
+    // let the writes allocate (and fail) on their own
+    return;
+  }
+  for (auto& v : extents) {
+    txc->reserved.insert(txc->reserved.end(), v.begin(), v.end());
+  }
+}
+
+uint64_t BlueStore::_txc_take_reserved(TransContext *txc, uint64_t want,
+				       PExtentVector *extents)
+{
+  uint64_t got = 0;
+  while (got < want && txc->reserved_pos < txc->reserved.size()) {
+    auto& e = txc->reserved[txc->reserved_pos];
+    uint64_t l = std::min<uint64_t>(e.length, want - got);
+    extents->emplace_back(e.offset, l);
+    got += l;
+    if (l == e.length) {
+      ++txc->reserved_pos;
+    } else {
+      e.offset += l;
+      e.length -= l;
+    }
+  }
+  return got;
+}
+
+void BlueStore::_txc_release_reserved(TransContext *txc)
+{
+  if (txc->reserved_pos < txc->reserved.size()) {
+    PExtentVector left(txc->reserved.begin() + txc->reserved_pos,
+		       txc->reserved.end());
+    dout(20) << __func__ << " unused " << left << dendl;
+    alloc->release(left);
+  }
+  txc->reserved.clear();
+  txc->reserved_pos = 0;
+}
+
 void BlueStore::_txc_add_transaction(TransContext *txc, Transaction *t)
 {
   BLUE_SCOPE(txc_add_transaction);
@@ -18966,6 +19523,7 @@ int BlueStore::_rename(TransContext *txc,
 
   newo = oldo;
   txc->write_onode(newo);
+  c->onode_filter_insert(new_okey);
 
   // this adjusts oldo->{oid,key}, and reset oldo to a fresh empty
   // Onode in the old slot
@@ -19008,6 +19566,11 @@ int BlueStore::_create_collection(
     coll_map[cid] = *c;
     new_coll_map.erase(p);
   }
+  if (cct->_conf->bluestore_onode_miss_filter) {
+    // a new collection is empty, so an empty filter is exact
+    std::unique_lock l((*c)->lock);
+    (*c)->reset_onode_filter(0);
+  }
   encode((*c)->cnode, bl);
   txc->t->set(PREFIX_COLL, stringify(cid), bl);
   r = 0;
@@ -19129,6 +19692,13 @@ int BlueStore::_split_collection(TransContext *txc,
 
   c->split_cache(d.get());
 
+  // the child starts out with a subset of the parent's objects
+  if (c->onode_filter) {
+    d->onode_filter = std::make_unique<bloom_filter>(*c->onode_filter);
+  } else {
+    d->onode_filter.reset();
+  }
+
   // adjust bits.  note that this will be redundant for all but the first
   // split call for this parent (first child).
   c->cnode.bits = bits;
@@ -19183,6 +19753,10 @@ int BlueStore::_merge_collection(
   // behavior depends on target (d) bits, so this after that is updated.
   (*c)->split_cache(d.get());
 
+  // the source's objects are not in the target's filter and bloom filters
+  // can't be merged; rely on plain lookups until the next mount
+  d->onode_filter.reset();
+
   // remove source collection
   {
     std::unique_lock l3(coll_lock);
@@ -19585,7 +20159,8 @@ void BlueStore::generate_db_histogram(Formatter *f)
     } else if (key.first == PREFIX_DEFERRED) {
 	hist.update_hist_entry(hist.key_hist, PREFIX_DEFERRED, key_size, value_size);
 	num_deferred++;
-    } else if (key.first == PREFIX_ALLOC || key.first == PREFIX_ALLOC_BITMAP) {
+    } else if (key.first == PREFIX_ALLOC || key.first == PREFIX_ALLOC_BITMAP ||
+	       key.first == PREFIX_ALLOC_DELTA) {
 	hist.update_hist_entry(hist.key_hist, PREFIX_ALLOC, key_size, value_size);
 	num_alloc++;
     } else if (key.first == PREFIX_SHARED_BLOB) {
@@ -19630,6 +20205,9 @@ void BlueStore::_shutdown_cache()
     i->flush();
     ceph_assert(i->empty());
   }
+  if (compressed_cache) {
+    compressed_cache->flush();
+  }
   for (auto& p : coll_map) {
     // Clear deferred write buffers before clearing up Onodes
     std::unique_lock l(p.second->lock);
@@ -20155,24 +20733,29 @@ static uint32_t    s_serial         = 0x01;
 #endif
 
 // 48 Bytes header for on-disk alloator image
+// The offsets are those of the encoding, which has no padding. In memory
+// delta_seq is aligned to 0x18, which makes the struct 0x38 bytes.
 const uint64_t ALLOCATOR_IMAGE_VALID_SIGNATURE = 0x1FACE0FF;
 struct allocator_image_header {
   uint32_t format_version;	// 0x00
   uint32_t valid_signature;	// 0x04
   utime_t  timestamp;		// 0x08
   uint32_t serial;		// 0x10
-  uint32_t pad[0x7];		// 0x14
+  uint64_t delta_seq;		// 0x14 (last allocation delta included, was pad[0-1])
+  uint32_t pad[0x5];		// 0x1C
 
   allocator_image_header() {
     memset((char*)this, 0, sizeof(allocator_image_header));
   }
 
   // create header in CEPH format
-  allocator_image_header(utime_t timestamp, uint32_t format_version, uint32_t serial) {
+  allocator_image_header(utime_t timestamp, uint32_t format_version, uint32_t serial,
+			 uint64_t delta_seq = 0) {
     this->format_version  = format_version;
     this->timestamp       = timestamp;
     this->valid_signature = ALLOCATOR_IMAGE_VALID_SIGNATURE;
     this->serial          = serial;
+    this->delta_seq       = delta_seq;
     memset(this->pad, 0, sizeof(this->pad));
   }
 
@@ -20181,6 +20764,7 @@ struct allocator_image_header {
     out << "valid_signature = " << header.valid_signature << "/" << ALLOCATOR_IMAGE_VALID_SIGNATURE << std::endl;
     out << "timestamp       = " << header.timestamp << std::endl;
     out << "serial          = " << header.serial << std::endl;
+    out << "delta_seq       = " << header.delta_seq << std::endl;
     for (unsigned i = 0; i < sizeof(header.pad)/sizeof(uint32_t); i++) {
       if (header.pad[i]) {
 	out << "header.pad[" << i << "] = " << header.pad[i] << std::endl;
@@ -20195,6 +20779,7 @@ struct allocator_image_header {
     denc(v.timestamp.tv.tv_sec, p);
     denc(v.timestamp.tv.tv_nsec, p);
     denc(v.serial, p);
+    denc(v.delta_seq, p);
     for (auto& pad: v.pad) {
       denc(pad, p);
     }
@@ -20218,6 +20803,7 @@ struct allocator_image_header {
   }
 };
 WRITE_CLASS_DENC(allocator_image_header)
+static_assert(sizeof(allocator_image_header) == 0x38);
 
 // 56 Bytes trailer for on-disk alloator image
 struct allocator_image_trailer {
@@ -20341,6 +20927,10 @@ int BlueStore::invalidate_allocation_file_on_bluefs()
   // mark that allocation-file was invalidated and we should destage a new copy whne closing db
   need_to_destage_allocation_file = true;
   dout(10) << __func__ << " need_to_destage_allocation_file was set" << dendl;
+  if (alloc_deltas) {
+    // the file is the base the journaled deltas apply to
+    return 0;
+  }
 
   BlueFS::FileWriter *p_handle = nullptr;
   if (!bluefs->dir_exists(allocator_dir)) {
@@ -20489,10 +21079,38 @@ int BlueStore::store_allocator(Allocator* src_allocator)
   }
 
   // store all extents (except for the bluefs extents we removed) in a single flat file
+  ret = write_allocator_image(
+    p_handle,
+    [&](std::function<void(uint64_t, uint64_t)> notify) {
+      allocator->foreach(notify);
+    },
+    alloc_delta_seq);
+  if (ret != 0) {
+    bluefs->close_writer(p_handle);
+    return -1;
+  }
+
+  utime_t duration = ceph_clock_now() - start_time;
+  dout(5) <<"p_handle->pos=" << p_handle->get_pos() << " WRITE-duration=" << duration << " seconds" << dendl;
+
+  bluefs->close_writer(p_handle);
+  need_to_destage_allocation_file = false;
+  return 0;
+}
+
+// write the free extents reported by foreach_free as an allocator image,
+// stamped with the last allocation delta it includes
+//-----------------------------------------------------------------------------------
+int BlueStore::write_allocator_image(
+  BlueFS::FileWriter *p_handle,
+  const std::function<void(std::function<void(uint64_t, uint64_t)>)>& foreach_free,
+  uint64_t delta_seq)
+{
+  int ret = 0;
   utime_t                 timestamp = ceph_clock_now();
   uint32_t                crc       = -1;
   {
-    allocator_image_header  header(timestamp, s_format_version, s_serial);
+    allocator_image_header  header(timestamp, s_format_version, s_serial, delta_seq);
     bufferlist              header_bl;
     encode(header, header_bl);
     crc = header_bl.crc32c(crc);
@@ -20523,13 +21141,12 @@ int BlueStore::store_allocator(Allocator* src_allocator)
       p_curr = buffer; // recycle the buffer
     }
   };
-  allocator->foreach(iterated_allocation);
+  foreach_free(iterated_allocation);
   // if got null extent -> fail the operation
   if (ret != 0) {
     derr << "Illegal extent, fail store operation" << dendl;
     derr << "invalidate using bluefs->truncate(p_handle, 0)" << dendl;
     bluefs->truncate(p_handle, 0);
-    bluefs->close_writer(p_handle);
     return -1;
   }
 
@@ -20552,12 +21169,8 @@ int BlueStore::store_allocator(Allocator* src_allocator)
   bluefs->truncate(p_handle, p_handle->get_pos());
   bluefs->fsync(p_handle);
 
-  utime_t duration = ceph_clock_now() - start_time;
-  dout(5) <<"WRITE-extent_count=" << extent_count << ", allocation_size=" << allocation_size << ", serial=" << s_serial << dendl;
-  dout(5) <<"p_handle->pos=" << p_handle->get_pos() << " WRITE-duration=" << duration << " seconds" << dendl;
-
-  bluefs->close_writer(p_handle);
-  need_to_destage_allocation_file = false;
+  dout(5) <<"WRITE-extent_count=" << extent_count << ", allocation_size=" << allocation_size
+	  << ", serial=" << s_serial << ", delta_seq=" << delta_seq << dendl;
   return 0;
 }
 
@@ -20585,6 +21198,8 @@ size_t calc_allocator_image_header_size()
   uint32_t crc = -1;
   crc = header_bl.crc32c(crc);
   encode(crc, header_bl);
+  // the header is still 48 bytes on disk
+  ceph_assert(header_bl.length() == 0x30 + sizeof(crc));
 
   return header_bl.length();
 }
@@ -20605,8 +21220,12 @@ int calc_allocator_image_trailer_size()
   return trailer_bl.length();
 }
 
+static void copy_simple_bitmap_to_allocator(SimpleBitmap* sbmap, Allocator* dest_alloc, uint64_t alloc_size);
+
 //-----------------------------------------------------------------------------------
-int BlueStore::__restore_allocator(Allocator* allocator, uint64_t *num, uint64_t *bytes)
+int BlueStore::__restore_allocator(const std::string& file,
+				   const std::function<void(uint64_t, uint64_t)>& add_free,
+				   uint64_t *num, uint64_t *bytes, uint64_t *delta_seq)
 {
   if (cct->_conf->bluestore_debug_inject_allocation_from_file_failure > 0) {
      boost::mt11213b rng(time(NULL));
@@ -20618,7 +21237,7 @@ int BlueStore::__restore_allocator(Allocator* allocator, uint64_t *num, uint64_t
   }
   utime_t start_time = ceph_clock_now();
   BlueFS::FileReader *p_temp_handle = nullptr;
-  int ret = bluefs->open_for_read(allocator_dir, allocator_file, &p_temp_handle, false);
+  int ret = bluefs->open_for_read(allocator_dir, file, &p_temp_handle, false);
   if (ret != 0) {
     dout(1) << "Failed open_for_read with error-code " << ret << dendl;
     return -1;
@@ -20694,7 +21313,7 @@ int BlueStore::__restore_allocator(Allocator* allocator, uint64_t *num, uint64_t
       read_alloc_size += length;
 
       if (length > 0) {
-	allocator->init_add_free(offset, length);
+	add_free(offset, length);
 	extent_count ++;
       } else {
 	derr << "extent with zero length at idx=" << extent_count << dendl;
@@ -20757,8 +21376,9 @@ int BlueStore::__restore_allocator(Allocator* allocator, uint64_t *num, uint64_t
   dout(5) << "READ--extent_count=" << extent_count << ", read_alloc_size=  "
 	    << read_alloc_size << ", file_size=" << file_size << dendl;
   dout(5) << "READ duration=" << duration << " seconds, s_serial=" << header.serial << dendl;
-  *num   = extent_count;
-  *bytes = read_alloc_size;
+  *num       = extent_count;
+  *bytes     = read_alloc_size;
+  *delta_seq = header.delta_seq;
   return 0;
 }
 
@@ -20766,20 +21386,260 @@ int BlueStore::__restore_allocator(Allocator* allocator, uint64_t *num, uint64_t
 int BlueStore::restore_allocator(Allocator* dest_allocator, uint64_t *num, uint64_t *bytes)
 {
   utime_t    start = ceph_clock_now();
-  auto temp_allocator = unique_ptr<Allocator>(create_bitmap_allocator(bdev->get_size()));
-  int ret = __restore_allocator(temp_allocator.get(), num, bytes);
-  if (ret != 0) {
-    return ret;
+  uint64_t last_delta = 0;
+  {
+    auto it = db->get_iterator(PREFIX_ALLOC_DELTA, KeyValueDB::ITERATOR_NOCACHE);
+    it->seek_to_last();
+    if (it->valid()) {
+      const char *p = it->key().c_str();
+      _key_decode_u64(p, &last_delta);
+    }
   }
+  // never hand out a seq that might still be on disk
+  alloc_delta_seq = last_delta;
 
-  uint64_t num_entries = 0;
-  dout(5) << " calling copy_allocator(bitmap_allocator -> shared_alloc.a)" << dendl;
-  copy_allocator(temp_allocator.get(), dest_allocator, &num_entries);
-  utime_t duration = ceph_clock_now() - start;
-  dout(5) << "restored in " << duration << " seconds, num_entries=" << num_entries << dendl;
+  uint64_t file_seq = 0;
+  int ret = 0;
+  if (last_delta == 0) {
+    auto temp_allocator = unique_ptr<Allocator>(create_bitmap_allocator(bdev->get_size()));
+    ret = __restore_allocator(
+      allocator_file,
+      [&](uint64_t offset, uint64_t length) {
+	temp_allocator->init_add_free(offset, length);
+      },
+      num, bytes, &file_seq);
+    if (ret != 0) {
+      return ret;
+    }
+
+    uint64_t num_entries = 0;
+    dout(5) << " calling copy_allocator(bitmap_allocator -> shared_alloc.a)" << dendl;
+    copy_allocator(temp_allocator.get(), dest_allocator, &num_entries);
+    utime_t duration = ceph_clock_now() - start;
+    dout(5) << "restored in " << duration << " seconds, num_entries=" << num_entries << dendl;
+  } else {
+    // the file is a base image, allocations made after it was written
+    // are journaled as deltas in the kv store
+    SimpleBitmap sbmap(cct, (bdev->get_size() / min_alloc_size));
+    sbmap.set_all();
+    ret = __restore_allocator(
+      allocator_file,
+      [&](uint64_t offset, uint64_t length) {
+	uint64_t first = p2roundup(offset, min_alloc_size) >> min_alloc_size_order;
+	uint64_t last = std::min(p2align(offset + length, min_alloc_size) >> min_alloc_size_order,
+				 sbmap.get_size());
+	if (first < last) {
+	  sbmap.clr(first, last - first);
+	}
+      },
+      num, bytes, &file_seq);
+    if (ret != 0) {
+      return ret;
+    }
+    uint64_t replayed_seq = 0, count = 0;
+    ret = replay_allocation_deltas(&sbmap, file_seq, last_delta, &replayed_seq, &count);
+    if (ret != 0) {
+      return ret;
+    }
+    alloc_delta_pending = count;
+    *num = 0;
+    *bytes = 0;
+    copy_simple_bitmap_to_allocator(&sbmap, dest_allocator, min_alloc_size);
+    dest_allocator->foreach([&](uint64_t offset, uint64_t length) {
+      ++(*num);
+      *bytes += length;
+    });
+    utime_t duration = ceph_clock_now() - start;
+    dout(5) << "restored in " << duration << " seconds, base seq=" << file_seq
+	    << ", replayed " << count << " deltas up to " << replayed_seq << dendl;
+  }
+  alloc_delta_seq = std::max(file_seq, last_delta);
+  alloc_delta_base = file_seq;
+  alloc_delta_merged = 0;
   return ret;
 }
 
+// apply the allocation deltas in (from_seq, to_seq] to sbmap
+//-----------------------------------------------------------------------------------
+int BlueStore::replay_allocation_deltas(SimpleBitmap *sbmap,
+					uint64_t from_seq, uint64_t to_seq,
+					uint64_t *last_seq, uint64_t *count)
+{
+  *last_seq = from_seq;
+  *count = 0;
+  auto to_bits = [&](uint64_t offset, uint64_t length, bool outward,
+		     uint64_t *start, uint64_t *end) {
+    if (outward) {
+      *start = p2align(offset, min_alloc_size) >> min_alloc_size_order;
+      *end = p2roundup(offset + length, min_alloc_size) >> min_alloc_size_order;
+    } else {
+      *start = p2roundup(offset, min_alloc_size) >> min_alloc_size_order;
+      *end = p2align(offset + length, min_alloc_size) >> min_alloc_size_order;
+    }
+    *end = std::min(*end, sbmap->get_size());
+    return *start < *end;
+  };
+
+  string from_key;
+  get_alloc_delta_key(from_seq + 1, &from_key);
+  auto it = db->get_iterator(PREFIX_ALLOC_DELTA, KeyValueDB::ITERATOR_NOCACHE);
+  for (it->lower_bound(from_key); it->valid(); it->next()) {
+    uint64_t seq;
+    const char *p = it->key().c_str();
+    _key_decode_u64(p, &seq);
+    if (seq > to_seq) {
+      break;
+    }
+    interval_set<uint64_t> allocated, released;
+    try {
+      auto bp = it->value().cbegin();
+      decode(allocated, bp);
+      decode(released, bp);
+    } catch (ceph::buffer::error& e) {
+      derr << __func__ << " failed to decode allocation delta " << seq << dendl;
+      return -EIO;
+    }
+    uint64_t start, end;
+    for (auto& [offset, length] : allocated) {
+      if (to_bits(offset, length, true, &start, &end)) {
+	sbmap->set(start, end - start);
+      }
+    }
+    for (auto& [offset, length] : released) {
+      if (to_bits(offset, length, false, &start, &end)) {
+	sbmap->clr(start, end - start);
+      }
+    }
+    *last_seq = seq;
+    ++(*count);
+  }
+  dout(10) << __func__ << " replayed " << *count << " deltas in ("
+	   << from_seq << ", " << *last_seq << "]" << dendl;
+  return 0;
+}
+
+// drop leftover deltas once they are no longer journaled, the allocation
+// file is invalidated and rebuilt at umount in that mode
+//-----------------------------------------------------------------------------------
+void BlueStore::purge_allocation_deltas()
+{
+  if (alloc_deltas) {
+    return;
+  }
+  auto it = db->get_iterator(PREFIX_ALLOC_DELTA, KeyValueDB::ITERATOR_NOCACHE);
+  it->lower_bound(string());
+  if (it->valid()) {
+    auto t = db->get_transaction();
+    t->rmkeys_by_prefix(PREFIX_ALLOC_DELTA);
+    int r = db->submit_transaction_sync(t);
+    ceph_assert(r == 0);
+  }
+  alloc_delta_seq = alloc_delta_base = alloc_delta_merged = 0;
+}
+
+// merge a batch of committed deltas into one delta keyed by the last seq
+// of the batch. A pass reads and rewrites at most
+// bluestore_allocation_deltas_compact_threshold deltas, whatever the
+// size of the device. The allocation file itself is only rewritten at
+// umount, and the deltas it covers are trimmed by the next pass.
+//-----------------------------------------------------------------------------------
+void BlueStore::compact_allocation_deltas()
+{
+  uint64_t upto;
+  {
+    std::lock_guard l(alloc_delta_lock);
+    upto = alloc_delta_uncommitted.empty() ?
+      alloc_delta_seq : *alloc_delta_uncommitted.begin() - 1;
+  }
+  uint64_t count = 0;
+  bool merged = false;
+  auto done = make_scope_guard([&] {
+    std::lock_guard l(alloc_delta_lock);
+    if (merged) {
+      alloc_delta_pending -= std::min(alloc_delta_pending, count);
+      alloc_delta_backoff = 1;
+    } else if (alloc_delta_backoff < MAX_ALLOC_DELTA_BACKOFF) {
+      // don't retry on every commit: wait for twice as many deltas each
+      // time it fails
+      if (alloc_delta_backoff == 1) {
+	derr << __func__ << " failed, backing off; the deltas are kept and"
+	     << " replayed on the next mount" << dendl;
+      }
+      alloc_delta_backoff *= 2;
+    }
+    alloc_delta_compacting = false;
+  });
+  const uint64_t from = std::max(alloc_delta_base, alloc_delta_merged);
+  if (upto <= from) {
+    merged = true;
+    return;
+  }
+
+  utime_t start = ceph_clock_now();
+  const uint64_t max_count = cct->_conf->bluestore_allocation_deltas_compact_threshold;
+  interval_set<uint64_t> allocated, released;
+  uint64_t last_seq = from;
+  string from_key;
+  get_alloc_delta_key(from + 1, &from_key);
+  auto it = db->get_iterator(PREFIX_ALLOC_DELTA, KeyValueDB::ITERATOR_NOCACHE);
+  for (it->lower_bound(from_key); it->valid() && count < max_count; it->next()) {
+    uint64_t seq;
+    const char *p = it->key().c_str();
+    _key_decode_u64(p, &seq);
+    if (seq > upto) {
+      break;
+    }
+    interval_set<uint64_t> a, r;
+    try {
+      auto bp = it->value().cbegin();
+      decode(a, bp);
+      decode(r, bp);
+    } catch (ceph::buffer::error& e) {
+      derr << __func__ << " failed to decode allocation delta " << seq << dendl;
+      return;
+    }
+    // what a later delta does to some space overrides the earlier ones,
+    // so allocated and released stay disjoint
+    interval_set<uint64_t> overlap;
+    overlap.intersection_of(released, a);
+    released.subtract(overlap);
+    allocated.union_of(a);
+    overlap.intersection_of(allocated, r);
+    allocated.subtract(overlap);
+    released.union_of(r);
+    last_seq = seq;
+    ++count;
+  }
+  if (count == 0) {
+    merged = true;
+    return;
+  }
+
+  bufferlist bl;
+  encode(allocated, bl);
+  encode(released, bl);
+  auto t = db->get_transaction();
+  string end_key, last_key;
+  if (from == alloc_delta_base) {
+    // deltas already included in the allocation file
+    get_alloc_delta_key(alloc_delta_base + 1, &end_key);
+    t->rm_range_keys(PREFIX_ALLOC_DELTA, string(), end_key);
+  }
+  get_alloc_delta_key(last_seq, &last_key);
+  t->rm_range_keys(PREFIX_ALLOC_DELTA, from_key, last_key);
+  t->set(PREFIX_ALLOC_DELTA, last_key, bl);
+  int r = db->submit_transaction_sync(t);
+  ceph_assert(r == 0);
+  alloc_delta_merged = last_seq;
+  merged = true;
+  logger->inc(l_bluestore_alloc_delta_compactions);
+  dout(5) << __func__ << " merged " << count << " deltas in (" << from
+	  << ", " << last_seq << "] into " << allocated.num_intervals()
+	  << " allocated and " << released.num_intervals()
+	  << " released extents in " << (ceph_clock_now() - start)
+	  << " seconds" << dendl;
+}
+
 //-----------------------------------------------------------------------------------
 void BlueStore::set_allocation_in_simple_bmap(SimpleBitmap* sbmap, uint64_t offset, uint64_t length)
 {
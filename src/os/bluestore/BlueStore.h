@@ -91,6 +91,7 @@ enum {
   l_bluestore_omap,
   l_bluestore_fragmentation,
   l_bluestore_alloc_unit,
+  l_bluestore_alloc_delta_compactions,
   //****************************************
 
   // Update op processing state latencies
@@ -134,6 +135,9 @@ enum {
   l_bluestore_kv_commit_lat,
   l_bluestore_kv_sync_lat,
   l_bluestore_kv_final_lat,
+  l_bluestore_kv_coalesced_txc,
+  l_bluestore_kv_coalesce_saved_ops,
+  l_bluestore_kv_coalesce_saved_bytes,
   //****************************************
 
   // write op stats
@@ -186,6 +190,7 @@ enum {
   l_bluestore_extents,
   l_bluestore_blobs,
   l_bluestore_spanning_blobs,
+  l_bluestore_onode_filter_skips,
   //****************************************
 
   // buffer cache stats
@@ -194,6 +199,8 @@ enum {
   l_bluestore_buffer_bytes,
   l_bluestore_buffer_hit_bytes,
   l_bluestore_buffer_miss_bytes,
+  l_bluestore_compressed_cache_bytes,
+  l_bluestore_compressed_cache_hit_bytes,
   //****************************************
 
   // internal stats
@@ -1394,6 +1401,8 @@ public:
     bool cached;              ///< Onode is logically in the cache
                               /// (it can be pinned and hence physically out
                               /// of it at the moment though)
+    std::atomic_bool in_lru = false; ///< lru_item is linked; may be
+                                     /// peeked at without the shard lock
     uint16_t prev_spanning_cnt = 0; /// spanning blobs count
     ExtentMap extent_map;
     BufferSpace bc;             ///< buffer cache
@@ -1678,17 +1687,83 @@ public:
     }
   };
 
+  /// Cache of compressed blob payloads, still compressed.
+  ///
+  /// Sits behind the buffer cache: a read of a compressed blob that misses
+  /// there is served from here and only pays for decompression instead of
+  /// a device read. Keeping the data compressed lets the same amount of
+  /// memory cover considerably more objects than the buffer cache does.
+  /// Only blobs occupying a single physical extent are cached. Entries are
+  /// keyed by that extent's offset and are dropped as soon as any of it is
+  /// released; compressed blobs are never overwritten in place.
+  struct CompressedBlobCache : public CacheShard {
+    struct Entry {
+      boost::intrusive::list_member_hook<> lru_item;
+      uint64_t offset;     ///< physical offset of the blob
+      uint32_t disk_len;   ///< blob's ondisk size
+      ceph::buffer::list bl;
+      std::shared_ptr<int64_t> cache_age_bin;
+
+      Entry(uint64_t offset, uint32_t disk_len, const ceph::buffer::list& bl)
+	: offset(offset), disk_len(disk_len), bl(bl) {}
+    };
+    typedef boost::intrusive::list<
+      Entry,
+      boost::intrusive::member_hook<
+        Entry,
+        boost::intrusive::list_member_hook<>,
+        &Entry::lru_item> > list_t;
+
+  private:
+    mempool::bluestore_cache_other::map<uint64_t, Entry> entries;
+    list_t lru;
+    uint64_t bytes = 0;
+
+    void _rm(decltype(entries)::iterator p);
+
+  public:
+    CompressedBlobCache(CephContext* cct) : CacheShard(cct) {}
+    ~CompressedBlobCache() {
+      std::lock_guard l(lock);
+      _trim_to(0);
+    }
+
+    /// fill *bl with the payload of blob if cached
+    bool lookup(const bluestore_blob_t& blob, ceph::buffer::list* bl);
+    /// remember the (verified) payload of blob
+    void add(const bluestore_blob_t& blob, const ceph::buffer::list& bl);
+    /// forget everything overlapping the released space
+    void invalidate(const interval_set<uint64_t>& released);
+
+    uint64_t _get_bytes() const {
+      return bytes;
+    }
+    void _trim_to(uint64_t new_bytes) override;
+    void add_stats(uint64_t *blobs, uint64_t *bytes);
+
+#ifdef DEBUG_CACHE
+    void _audit(const char *s) override {}
+#endif
+  };
+
   struct OnodeSpace {
     OnodeCacheShard *cache;
 
   private:
+    /// protect onode_map.  Cache hits in lookup() only take this shared,
+    /// so concurrent readers never serialize on the cache shard lock.
+    /// Writers hold cache->lock first and then this exclusively.
+    ceph::shared_mutex map_lock =
+      ceph::make_shared_mutex("BlueStore::OnodeSpace::map_lock");
     /// forward lookups
     mempool::bluestore_cache_meta::unordered_map<ghobject_t,OnodeRef> onode_map;
 
     friend struct Collection; // for split_cache()
     friend struct Onode; // for put()
     friend struct LruOnodeCacheShard;
-    void _remove(const ghobject_t& oid);
+    /// detach o from onode_map unless somebody else has it pinned;
+    /// the map's reference is handed over to the caller
+    OnodeRef _detach_unpinned(Onode* o);
   public:
     OnodeSpace(OnodeCacheShard *c) : cache(c) {}
     ~OnodeSpace() {
@@ -1746,6 +1821,15 @@ public:
     std::atomic<uint64_t> static_frag_score{0};
     std::atomic<uint64_t> object_read_samples{0};
 
+    /// probabilistic set of the onode keys in this collection, see
+    /// bluestore_onode_miss_filter.  a miss means the onode does not
+    /// exist; null means unknown.  modified under the exclusive lock.
+    std::unique_ptr<bloom_filter> onode_filter;
+
+    void reset_onode_filter(size_t expected_count);
+    void onode_filter_insert(std::string_view key);
+    bool onode_filter_may_contain(std::string_view key) const;
+
     OnodeCacheShard* get_onode_cache() const {
       return onode_space.cache;
     }
@@ -1986,6 +2070,9 @@ public:
     bluestore_deferred_transaction_t *deferred_txn = nullptr; ///< if any
 
     interval_set<uint64_t> allocated, released;
+    PExtentVector reserved;     ///< batch allocated ahead for the writes
+    size_t reserved_pos = 0;    ///< first reserved extent not taken yet
+    uint64_t alloc_delta_seq = 0;  ///< allocation delta journaled by us, if any
     volatile_statfs statfs_delta;	   ///< overall store statistics delta
     uint64_t osd_pool_id = META_POOL_ID;    ///< osd pool id we're operating on
 
@@ -2434,6 +2521,18 @@ private:
   bool db_was_opened_read_only = true;
   bool need_to_destage_allocation_file = false;
 
+  // allocation deltas, see bluestore_allocation_deltas
+  bool alloc_deltas = false;        ///< journal txc allocations to the kv store
+  ceph::mutex alloc_delta_lock = ceph::make_mutex("BlueStore::alloc_delta_lock");
+  uint64_t alloc_delta_seq = 0;     ///< last assigned delta seq
+  uint64_t alloc_delta_base = 0;    ///< last delta included in the allocation file
+  uint64_t alloc_delta_merged = 0;  ///< last delta merged since mount
+  uint64_t alloc_delta_pending = 0; ///< committed deltas not merged yet
+  std::set<uint64_t> alloc_delta_uncommitted; ///< assigned, not yet committed
+  bool alloc_delta_compacting = false;
+  static constexpr unsigned MAX_ALLOC_DELTA_BACKOFF = 1024;
+  unsigned alloc_delta_backoff = 1; ///< compact threshold multiplier, doubled per failed compaction
+
   ///< rwlock to protect coll_map/new_coll_map
   ceph::shared_mutex coll_lock = ceph::make_shared_mutex("BlueStore::coll_lock");
   mempool::bluestore_cache_other::unordered_map<coll_t, CollectionRef> coll_map;
@@ -2442,6 +2541,7 @@ private:
 
   mempool::bluestore_cache_buffer::vector<BufferCacheShard*> buffer_cache_shards;
   mempool::bluestore_cache_onode::vector<OnodeCacheShard*> onode_cache_shards;
+  std::unique_ptr<CompressedBlobCache> compressed_cache; ///< null if disabled
 
   /// protect zombie_osr_set
   ceph::mutex zombie_osr_lock = ceph::make_mutex("BlueStore::zombie_osr_lock");
@@ -2461,6 +2561,7 @@ private:
   std::atomic_int deferred_queue_size = {0};         ///< num txc's queued across all osrs
   std::atomic_int deferred_aggressive = {0}; ///< aggressive wakeup of kv thread
   Finisher  finisher;
+  Finisher  alloc_delta_finisher; ///< merges allocation deltas
   utime_t  deferred_last_submitted = utime_t();
 
   KVSyncThread kv_sync_thread;
@@ -2551,6 +2652,7 @@ private:
   double cache_kv_ratio = 0;     ///< cache ratio dedicated to kv (e.g., rocksdb)
   double cache_kv_onode_ratio = 0; ///< cache ratio dedicated to kv onodes (e.g., rocksdb onode CF)
   double cache_data_ratio = 0;   ///< cache ratio dedicated to object data
+  double cache_compressed_ratio = 0; ///< cache ratio dedicated to compressed blobs
   bool cache_autotune = false;   ///< cache autotune setting
   double cache_age_bin_interval = 0; ///< time to wait between cache age bin rotations
   double cache_autotune_interval = 0; ///< time to wait between cache rebalancing
@@ -2800,11 +2902,37 @@ private:
     };
     std::shared_ptr<DataCache> data_cache;
 
+    struct CompressedDataCache : public MempoolCache {
+      CompressedDataCache(BlueStore *s) : MempoolCache(s) {};
+
+      virtual uint32_t get_bin_count() const {
+        return store->compressed_cache->get_bin_count();
+      }
+      virtual void set_bin_count(uint32_t count) {
+        store->compressed_cache->set_bin_count(count);
+      }
+      virtual uint64_t _get_used_bytes() const {
+        return store->compressed_cache->_get_bytes();
+      }
+      virtual void shift_bins() {
+        store->compressed_cache->shift_bins();
+      }
+      virtual uint64_t _sum_bins(uint32_t start, uint32_t end) const {
+        return store->compressed_cache->sum_bins(start, end);
+      }
+      virtual std::string get_cache_name() const {
+        return "BlueStore Compressed Data Cache";
+      }
+    };
+    /// only used when store->compressed_cache is enabled
+    std::shared_ptr<CompressedDataCache> compressed_data_cache;
+
   public:
     explicit MempoolThread(BlueStore *s)
       : store(s),
         meta_cache(new MetaCache(s)),
-        data_cache(new DataCache(s)) {}
+        data_cache(new DataCache(s)),
+        compressed_data_cache(new CompressedDataCache(s)) {}
 
     void *entry() override;
     void init() {
@@ -2896,6 +3024,7 @@ private:
   void _close_alloc();
   int _open_collections();
   void _fsck_collections(int64_t* errors);
+  void _build_onode_filters();
   void _close_collections();
 
   int _setup_block_symlink_or_file(std::string name, std::string path, uint64_t size,
@@ -2959,6 +3088,10 @@ private:
 			    TrackedOpRef osd_op=TrackedOpRef());
   void _txc_update_store_statfs(TransContext *txc);
   void _txc_add_transaction(TransContext *txc, Transaction *t);
+  void _txc_reserve_space(TransContext *txc, std::vector<Transaction>& tls);
+  uint64_t _txc_take_reserved(TransContext *txc, uint64_t want,
+			      PExtentVector *extents);
+  void _txc_release_reserved(TransContext *txc);
   void _txc_calc_cost(TransContext *txc);
   void _txc_write_nodes(TransContext *txc, KeyValueDB::Transaction t);
   void _txc_state_proc(TransContext *txc);
@@ -2971,6 +3104,8 @@ private:
   void _txc_finish_io(TransContext *txc);
   void _txc_finalize_kv(TransContext *txc, KeyValueDB::Transaction t);
   void _txc_apply_kv(TransContext *txc, bool sync_submit_transaction);
+  void _txc_applied_kv(TransContext *txc);
+  bool _txc_apply_kv_coalesced(const std::deque<TransContext*>& txcs);
   void _txc_committed_kv(TransContext *txc);
   void _txc_finish(TransContext *txc);
   void _txc_release_alloc(TransContext *txc);
@@ -3359,7 +3494,8 @@ private:
   int _prepare_read_ioc(
     blobs2read_t& blobs2read,
     std::vector<ceph::buffer::list>* compressed_blob_bls,
-    IOContext* ioc);
+    IOContext* ioc,
+    int read_cache_policy = 0);
 
   int _generate_read_result_bl(
     OnodeRef& o,
@@ -3368,6 +3504,7 @@ private:
     ready_regions_t& ready_regions,
     std::vector<ceph::buffer::list>& compressed_blob_bls,
     blobs2read_t& blobs2read,
+    const IOContext& ioc,
     bool buffered,
     bool* csum_error,
     ceph::buffer::list& bl);
@@ -4252,9 +4389,20 @@ private:
 
   int  copy_allocator(Allocator* src_alloc, Allocator *dest_alloc, uint64_t* p_num_entries);
   int  store_allocator(Allocator* allocator);
+  int  write_allocator_image(BlueFS::FileWriter *p_handle,
+			     const std::function<void(std::function<void(uint64_t, uint64_t)>)>& foreach_free,
+			     uint64_t delta_seq);
   int  invalidate_allocation_file_on_bluefs();
-  int  __restore_allocator(Allocator* allocator, uint64_t *num, uint64_t *bytes);
+  int  __restore_allocator(const std::string& file,
+			   const std::function<void(uint64_t, uint64_t)>& add_free,
+			   uint64_t *num, uint64_t *bytes, uint64_t *delta_seq);
   int  restore_allocator(Allocator* allocator, uint64_t *num, uint64_t *bytes);
+  int  replay_allocation_deltas(SimpleBitmap *sbmap, uint64_t from_seq, uint64_t to_seq,
+				uint64_t *last_seq, uint64_t *count);
+  void purge_allocation_deltas();
+  void compact_allocation_deltas();
+  void _txc_journal_alloc_delta(TransContext *txc, KeyValueDB::Transaction t);
+  void _txc_alloc_delta_committed(TransContext *txc);
   int  read_allocation_from_drive_on_startup();
   int  reconstruct_allocations(SimpleBitmap *smbmp, read_alloc_stats_t &stats);
   int  read_allocation_from_onodes(SimpleBitmap *smbmp, read_alloc_stats_t& stats);
@@ -198,6 +198,7 @@ class BlueStore::OnodeScanMT {
   uint32_t chunk_pos = 0;
   uint64_t total = 0;
   uint64_t interval = 1'000'000;
+  static constexpr size_t chunks_per_thread = 4;
   ceph::mutex lock = ceph::make_mutex("BlueStore::OnodeScanMT::lock");
   void report_progress(uint32_t thread_no, uint64_t no_completed) {
     auto &cct = store.cct;
@@ -224,6 +225,7 @@ class BlueStore::OnodeScanMT {
   }
 
   int scan_onodes_range(
+    uint32_t thread_no,
     read_alloc_stats_t& stats,
     const string& start_key,
     const string& upper_bound_key)
@@ -249,7 +251,7 @@ class BlueStore::OnodeScanMT {
     // iterate over all onodes in requested range
     for (; it->valid(); it->next(), kv_count++) {
       if (kv_count && (kv_count % count_interval == 0)) {
-        report_progress(0, kv_count - last_completed);
+        report_progress(thread_no, kv_count - last_completed);
         last_completed = kv_count;
       }
       auto key = it->key();
@@ -291,22 +293,25 @@ class BlueStore::OnodeScanMT {
         ++stats.shard_count;
       }
     }
-    report_progress(0, kv_count - last_completed);
+    report_progress(thread_no, kv_count - last_completed);
     return 0;
   }
 
   void scanner_thread(
     uint32_t thread_no,
-    read_alloc_stats_t& stats)
+    read_alloc_stats_t& stats,
+    double& busy)
   {
     [[maybe_unused]] auto& cct = store.cct;
     string start_key;
     string upper_bound_key;
+    auto start = ceph::mono_clock::now();
     while(ask_for_work(start_key, upper_bound_key)) {
       dout(10) << "thread " << thread_no << " runs: " << pretty_binary_string(start_key)
         << "..." << pretty_binary_string(upper_bound_key) << dendl;
-      scan_onodes_range(stats, start_key, upper_bound_key);
+      scan_onodes_range(thread_no, stats, start_key, upper_bound_key);
     }
+    busy = std::chrono::duration<double>(ceph::mono_clock::now() - start).count();
   }
 
 public:
@@ -322,8 +327,12 @@ public:
     size_t num_threads = cct->_conf.get_val<uint64_t>("bluestore_allocation_recovery_threads");
     ceph_assert(num_threads > 0);
     std::vector<double> timers;
+    // Size estimates are not exact and onode density varies a lot between
+    // pools, so with a single chunk per thread one slow range keeps the whole
+    // recovery waiting. Cut finer and let idle threads pick up the rest.
+    size_t num_chunks = num_threads > 1 ? num_threads * chunks_per_thread : 1;
     store.db->util_divide_key_range(
-      PREFIX_OBJ, "", string(100, '\377'), num_threads, 50'000'000, 0.05, chunks);
+      PREFIX_OBJ, "", string(100, '\377'), num_chunks, 50'000'000, 0.05, chunks);
     for (size_t i = 0; i < chunks.size(); i++) {
       dout(10) << i << ": " << pretty_binary_string(chunks[i].first_key)
         << "..." << pretty_binary_string(chunks[i].upper_bound) << dendl;
@@ -335,10 +344,14 @@ public:
     timers.resize(num_threads);
     for (size_t i = 0; i < num_threads; i++) {
       thr[i] = std::thread(
-        &BlueStore::OnodeScanMT::scanner_thread, this, i, std::ref(thr_stats[i]));
+        &BlueStore::OnodeScanMT::scanner_thread, this, i, std::ref(thr_stats[i]),
+        std::ref(timers[i]));
     }
     for (size_t i = 0; i < num_threads; i++) {
       thr[i].join();
+      dout(5) << __func__ << " thread " << i << " scanned "
+        << thr_stats[i].onode_count << " onodes in " << timers[i] << "s"
+        << dendl;
       stats.onode_count += thr_stats[i].onode_count;
       stats.shard_count += thr_stats[i].shard_count;
       stats.shared_blob_count += thr_stats[i].shared_blob_count;
@@ -0,0 +1,243 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "ShardedAllocator.h"
+#include "include/intarith.h"
+#include "common/debug.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef  dout_prefix
+#define dout_prefix *_dout << "ShardedAllocator "
+
+static uint64_t calc_shard_size(uint64_t device_size, uint64_t block_size,
+                                uint64_t num_shards)
+{
+  uint64_t align = round_up_to(ShardedAllocator::SHARD_ALIGNMENT, block_size);
+  uint64_t s = div_round_up(device_size, std::max<uint64_t>(num_shards, 1));
+  return std::max(round_up_to(s, align), align);
+}
+
+ShardedAllocator::ShardedAllocator(CephContext* _cct,
+                                   int64_t device_size,
+                                   int64_t _block_size,
+                                   uint64_t num_shards,
+                                   uint64_t max_mem,
+                                   std::string_view name)
+  : AllocatorBase(name, device_size, _block_size),
+    cct(_cct),
+    shard_size(calc_shard_size(device_size, _block_size, num_shards)),
+    shards(std::max<uint64_t>(1, div_round_up(device_size, shard_size)))
+{
+  for (size_t i = 0; i < shards.size(); i++) {
+    auto& s = shards[i];
+    s.base = i * shard_size;
+    uint64_t len = i + 1 < shards.size() ?
+      shard_size : device_size - s.base;
+    s.alloc.reset(new HybridAvlAllocator(cct, len, _block_size,
+      max_mem / shards.size(),
+      name.empty() ? std::string() : std::string(name) + "." + std::to_string(i)));
+  }
+  ldout(cct, 10) << __func__ << std::hex
+    << " size 0x" << device_size
+    << " shard_size 0x" << shard_size
+    << std::dec << " shards " << shards.size() << dendl;
+}
+
+size_t ShardedAllocator::_get_home_shard() const
+{
+  // spread threads over the shards round robin, by the order they
+  // first allocated in
+  static std::atomic<size_t> next_slot = 0;
+  thread_local size_t slot = next_slot++;
+  return slot % shards.size();
+}
+
+int64_t ShardedAllocator::_allocate_from(shard_t& s,
+  uint64_t want,
+  uint64_t unit,
+  uint64_t max_alloc_size,
+  int64_t  hint,
+  PExtentVector* extents)
+{
+  auto orig_size = extents->size();
+  // a negative hint asks for the allocator's own cursor, keep it
+  int64_t hint_rel = hint < 0 ? hint : 0;
+  if (hint > 0 && (uint64_t)hint >= s.base &&
+      (uint64_t)hint - s.base < (uint64_t)s.alloc->get_capacity()) {
+    hint_rel = hint - s.base;
+  }
+  int64_t r = s.alloc->allocate(want, unit, max_alloc_size, hint_rel, extents);
+  if (r <= 0) {
+    return 0;
+  }
+  for (auto p = extents->begin() + orig_size; p != extents->end(); ++p) {
+    p->offset += s.base;
+  }
+  s.free -= r;
+  return r;
+}
+
+int64_t ShardedAllocator::allocate(
+  uint64_t want,
+  uint64_t unit,
+  uint64_t max_alloc_size,
+  int64_t  hint,
+  PExtentVector* extents)
+{
+  ldout(cct, 10) << __func__ << std::hex
+    << " 0x" << want
+    << "/" << unit
+    << "," << max_alloc_size
+    << "," << hint
+    << std::dec << dendl;
+  ceph_assert(want % unit == 0);
+  ceph_assert(shard_size % unit == 0);
+
+  // Prefer the shard of the hint (for locality), then the home one of
+  // this thread. If that doesn't have enough free space take the one
+  // with the most, there is no point to fragment an almost full shard.
+  size_t first = hint > 0 && (uint64_t)hint < (uint64_t)get_capacity() ?
+    _get_shard(hint) : _get_home_shard();
+  if (shards[first].free < want) {
+    for (size_t i = 0; i < shards.size(); i++) {
+      if (shards[i].free > shards[first].free) {
+        first = i;
+      }
+    }
+  }
+  uint64_t allocated = 0;
+  for (size_t n = 0; n < shards.size() && allocated < want; n++) {
+    auto& s = shards[(first + n) % shards.size()];
+    if (n > 0 && s.free < unit) {
+      continue;
+    }
+    allocated += _allocate_from(s, want - allocated, unit, max_alloc_size,
+                                hint, extents);
+  }
+  if (allocated == 0) {
+    return -ENOSPC;
+  }
+  return allocated;
+}
+
+void ShardedAllocator::release(const release_set_t& release_set)
+{
+  if (shards.size() == 1) {
+    shards[0].alloc->release(release_set);
+    shards[0].free += release_set.size();
+    return;
+  }
+  std::vector<release_set_t> per_shard(shards.size());
+  for (auto p = release_set.begin(); p != release_set.end(); ++p) {
+    _foreach_shard_part(p.get_start(), p.get_len(),
+      [&](shard_t& s, uint64_t o, uint64_t l) {
+        per_shard[&s - &shards[0]].insert(o, l);
+      });
+  }
+  for (size_t i = 0; i < shards.size(); i++) {
+    if (!per_shard[i].empty()) {
+      shards[i].alloc->release(per_shard[i]);
+      shards[i].free += per_shard[i].size();
+    }
+  }
+}
+
+uint64_t ShardedAllocator::get_free()
+{
+  uint64_t res = 0;
+  for (auto& s : shards) {
+    res += s.alloc->get_free();
+  }
+  return res;
+}
+
+double ShardedAllocator::get_fragmentation()
+{
+  double res = 0;
+  uint64_t total = 0;
+  for (auto& s : shards) {
+    uint64_t f = s.alloc->get_free();
+    res += s.alloc->get_fragmentation() * f;
+    total += f;
+  }
+  return total ? res / total : 0.0;
+}
+
+void ShardedAllocator::dump()
+{
+  for (auto& s : shards) {
+    ldout(cct, 0) << __func__ << std::hex
+      << " shard at 0x" << s.base
+      << " free 0x" << s.alloc->get_free()
+      << std::dec << dendl;
+    s.alloc->dump();
+  }
+}
+
+void ShardedAllocator::foreach(
+  std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  // report free space spanning a shard boundary as a single extent, as
+  // any other allocator would
+  uint64_t pend_offset = 0, pend_length = 0;
+  for (auto& s : shards) {
+    s.alloc->foreach([&](uint64_t o, uint64_t l) {
+      if (pend_length && pend_offset + pend_length == s.base + o) {
+        pend_length += l;
+        return;
+      }
+      if (pend_length) {
+        notify(pend_offset, pend_length);
+      }
+      pend_offset = s.base + o;
+      pend_length = l;
+    });
+  }
+  if (pend_length) {
+    notify(pend_offset, pend_length);
+  }
+}
+
+void ShardedAllocator::init_add_free(uint64_t offset, uint64_t length)
+{
+  ldout(cct, 10) << __func__ << std::hex
+    << " offset 0x" << offset
+    << " length 0x" << length
+    << std::dec << dendl;
+  _foreach_shard_part(offset, length,
+    [&](shard_t& s, uint64_t o, uint64_t l) {
+      s.alloc->init_add_free(o, l);
+      s.free += l;
+    });
+}
+
+void ShardedAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  ldout(cct, 10) << __func__ << std::hex
+    << " offset 0x" << offset
+    << " length 0x" << length
+    << std::dec << dendl;
+  _foreach_shard_part(offset, length,
+    [&](shard_t& s, uint64_t o, uint64_t l) {
+      s.alloc->init_rm_free(o, l);
+      s.free -= l;
+    });
+}
+
+void ShardedAllocator::expand(int64_t new_size)
+{
+  ceph_assert(new_size >= get_capacity());
+  // the last shard takes all the new space
+  auto& s = shards.back();
+  s.alloc->expand(new_size - s.base);
+  Allocator::expand(new_size);
+}
+
+void ShardedAllocator::shutdown()
+{
+  for (auto& s : shards) {
+    s.alloc->shutdown();
+    s.free = 0;
+  }
+}
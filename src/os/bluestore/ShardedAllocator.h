@@ -0,0 +1,103 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "AllocatorBase.h"
+#include "HybridAllocator.h"
+
+/*
+ * ShardedAllocator splits the device into a few contiguous ranges, each
+ * one managed by its own HybridAvlAllocator (and hence having its own lock).
+ * Threads allocate from their "home" range first and only go to the other
+ * ranges when it runs short, so concurrent kv_sync/finisher threads don't
+ * serialize on a single allocator lock.
+ * Range boundaries are aligned to SHARD_ALIGNMENT which keeps the extents
+ * allocated within a range aligned to any practical allocation unit.
+ */
+class ShardedAllocator : public AllocatorBase {
+public:
+  static constexpr uint64_t SHARD_ALIGNMENT = 1ull << 30; // 1G
+
+private:
+  struct shard_t {
+    uint64_t base = 0;   ///< device offset the range starts at
+    std::atomic<uint64_t> free = 0; ///< tracked here to pick shards w/o locking
+    std::unique_ptr<HybridAvlAllocator> alloc;
+  };
+
+  CephContext* cct;
+  const uint64_t shard_size;
+  std::vector<shard_t> shards;
+
+  size_t _get_shard(uint64_t offset) const {
+    return std::min<uint64_t>(offset / shard_size, shards.size() - 1);
+  }
+  size_t _get_home_shard() const;
+
+  // calls f(shard, shard relative offset, length) for each part
+  // of the given extent
+  template <typename F>
+  void _foreach_shard_part(uint64_t offset, uint64_t length, F&& f) {
+    while (length > 0) {
+      size_t i = _get_shard(offset);
+      auto& s = shards[i];
+      uint64_t l = length;
+      if (i + 1 < shards.size()) {
+        l = std::min(l, s.base + shard_size - offset);
+      }
+      f(s, offset - s.base, l);
+      offset += l;
+      length -= l;
+    }
+  }
+
+  int64_t _allocate_from(shard_t& s,
+    uint64_t want,
+    uint64_t unit,
+    uint64_t max_alloc_size,
+    int64_t  hint,
+    PExtentVector* extents);
+
+public:
+  ShardedAllocator(CephContext* cct,
+    int64_t device_size,
+    int64_t _block_size,
+    uint64_t num_shards,
+    uint64_t max_mem,
+    std::string_view name);
+
+  const char* get_type() const override {
+    return "hybrid_sharded";
+  }
+
+  int64_t allocate(
+    uint64_t want,
+    uint64_t unit,
+    uint64_t max_alloc_size,
+    int64_t  hint,
+    PExtentVector *extents) override;
+  void release(const release_set_t& release_set) override;
+  using Allocator::release;
+
+  uint64_t get_free() override;
+  double get_fragmentation() override;
+
+  void dump() override;
+  void foreach(
+    std::function<void(uint64_t offset, uint64_t length)> notify) override;
+
+  void init_add_free(uint64_t offset, uint64_t length) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+
+  void expand(int64_t new_size) override;
+  void shutdown() override;
+
+  size_t get_num_shards() const {
+    return shards.size();
+  }
+};
@@ -1327,7 +1327,14 @@ void BlueStore::Writer::_defer_or_allocate(uint32_t need_size)
     statfs_delta.allocated() += need_size;
     disk_allocs.pos = 0;
   } else {
-    int64_t new_alloc_size = bstore->alloc->allocate(need_size, au_size, 0, 0, &allocated);
+    int64_t new_alloc_size =
+      bstore->_txc_take_reserved(txc, need_size, &allocated);
+    if (new_alloc_size < need_size) {
+      int64_t r = bstore->alloc->allocate(need_size - new_alloc_size, au_size,
+                                          0, 0, &allocated);
+      ceph_assert(r > 0);
+      new_alloc_size += r;
+    }
     ceph_assert(need_size == new_alloc_size);
     statfs_delta.allocated() += new_alloc_size;
     disk_allocs.it = allocated.begin();
@@ -0,0 +1,70 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+#include "include/types.h"
+
+/**
+ * MapRefCache
+ *
+ * A small lock free cache of references to the most recent epochs of a
+ * map (T needs get_epoch()), indexed by epoch modulo Slots.  It sits in
+ * front of a bigger, lock protected cache (e.g. OSDService::map_cache):
+ * every OSDShard has its own, so that looking up the current and recent
+ * epochs from the op and peering paths doesn't serialize the shards on
+ * a single mutex.
+ *
+ * A slot never goes back to an older epoch, so the cache converges to
+ * the newest Slots epochs and lookups of older ones simply miss.
+ */
+template <typename T, unsigned Slots = 16>
+class MapRefCache {
+public:
+  using Ref = std::shared_ptr<const T>;
+
+private:
+  std::array<std::atomic<Ref>, Slots> slots;
+  std::atomic<uint64_t> hits = 0;
+  std::atomic<uint64_t> misses = 0;
+
+public:
+  Ref lookup(epoch_t e) {
+    Ref r = slots[e % Slots].load(std::memory_order_acquire);
+    if (r && r->get_epoch() == e) {
+      hits.fetch_add(1, std::memory_order_relaxed);
+      return r;
+    }
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return Ref();
+  }
+
+  void add(const Ref& r) {
+    auto& slot = slots[r->get_epoch() % Slots];
+    Ref cur = slot.load(std::memory_order_relaxed);
+    do {
+      if (cur && cur->get_epoch() >= r->get_epoch()) {
+        return;
+      }
+    } while (!slot.compare_exchange_weak(cur, r,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+  }
+
+  void clear() {
+    for (auto& slot : slots) {
+      slot.store(Ref(), std::memory_order_relaxed);
+    }
+  }
+
+  uint64_t get_hits() const {
+    return hits.load(std::memory_order_relaxed);
+  }
+  uint64_t get_misses() const {
+    return misses.load(std::memory_order_relaxed);
+  }
+};
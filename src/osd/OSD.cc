@@ -1679,7 +1679,7 @@ void OSDService::handle_misdirected_op(PG *pg, OpRequestRef op)
        * them without an error (the client will resend anyway).
        */
     ceph_assert(m->get_map_epoch() <= superblock.get_newest_map());
-    OSDMapRef opmap = try_get_map(m->get_map_epoch());
+    OSDMapRef opmap = pg->osd_shard->try_get_map(m->get_map_epoch());
     if (!opmap) {
       dout(7) << __func__ << ": " << *pg << " no longer have map for "
 	      << m->get_map_epoch() << ", dropping" << dendl;
@@ -2609,9 +2609,6 @@ int OSD::set_numa_affinity()
       if (front_node == back_node &&
 	  front_node == store_node) {
 	dout(1) << " objectstore and network numa nodes all match" << dendl;
-	if (g_conf().get_val<bool>("osd_numa_auto_affinity")) {
-	  numa_node = front_node;
-	}
       } else if (front_node != back_node) {
         dout(1) << __func__ << " public and cluster network numa nodes do not match"
                 << dendl;
@@ -2633,10 +2630,11 @@ int OSD::set_numa_affinity()
     derr << __func__ << " unable to identify public interface '" << front_iface
 	 << "' numa node: " << cpp_strerror(r) << dendl;
   }
-  if (int node = g_conf().get_val<int64_t>("osd_numa_node"); node >= 0) {
-    // this takes precedence over the automagic logic above
-    numa_node = node;
-  }
+  numa_node = pick_numa_node(
+    store_node, front_node, back_node,
+    g_conf().get_val<bool>("osd_numa_auto_affinity"),
+    g_conf().get_val<bool>("osd_numa_prefer_storage"),
+    g_conf().get_val<int64_t>("osd_numa_node"));
   if (numa_node >= 0) {
     int r = get_numa_node_cpu_set(numa_node, &numa_cpu_set_size, &numa_cpu_set);
     if (r < 0) {
@@ -4828,6 +4826,7 @@ int OSD::shutdown()
   for (auto s : shards) {
     std::lock_guard l(s->osdmap_lock);
     s->shard_osdmap = OSDMapRef();
+    s->map_cache.clear();
   }
   service.shutdown();
 
@@ -6437,6 +6436,15 @@ void OSD::tick_without_osd_lock()
   logger->set(l_osd_cached_crc, ceph::buffer::get_cached_crc());
   logger->set(l_osd_cached_crc_adjusted, ceph::buffer::get_cached_crc_adjusted());
   logger->set(l_osd_missed_crc, ceph::buffer::get_missed_crc());
+  // the shards count their map cache lookups themselves, so that the
+  // lookups don't all hit the same counter
+  uint64_t shard_map_cache_hits = 0, shard_map_cache_misses = 0;
+  for (auto shard : shards) {
+    shard_map_cache_hits += shard->map_cache.get_hits();
+    shard_map_cache_misses += shard->map_cache.get_misses();
+  }
+  logger->set(l_osd_map_shard_cache_hit, shard_map_cache_hits);
+  logger->set(l_osd_map_shard_cache_miss, shard_map_cache_misses);
 
   // refresh osd stats
   struct store_statfs_t stbuf;
@@ -9026,7 +9034,7 @@ bool OSD::advance_pg(
   for (epoch_t next_epoch = first_new_epoch;
        next_epoch <= osd_epoch;
        ++next_epoch) {
-    OSDMapRef nextmap = service.try_get_map(next_epoch);
+    OSDMapRef nextmap = pg->osd_shard->try_get_map(next_epoch);
     if (!nextmap) {
       dout(20) << __func__ << " missing map " << next_epoch << dendl;
       continue;
@@ -10742,6 +10750,18 @@ epoch_t OSDShard::get_max_waiting_epoch()
   return r;
 }
 
+OSDMapRef OSDShard::try_get_map(epoch_t e)
+{
+  OSDMapRef r = map_cache.lookup(e);
+  if (!r) {
+    r = osd->service.try_get_map(e);
+    if (r) {
+      map_cache.add(r);
+    }
+  }
+  return r;
+}
+
 void OSDShard::consume_map(
   const OSDMapRef& new_osdmap,
   unsigned *pushes_to_free)
@@ -10753,6 +10773,7 @@ void OSDShard::consume_map(
     old_osdmap = std::move(shard_osdmap);
     shard_osdmap = new_osdmap;
   }
+  map_cache.add(new_osdmap);
   dout(10) << new_osdmap->get_epoch()
            << " (was " << (old_osdmap ? old_osdmap->get_epoch() : 0) << ")"
 	   << dendl;
@@ -37,6 +37,7 @@
 #include "include/CompatSet.h"
 #include "include/common_fwd.h"
 
+#include "MapRefCache.h"
 #include "OpRequest.h"
 #include "Session.h"
 
@@ -1002,6 +1003,12 @@ struct OSDShard {
     return shard_osdmap;
   }
 
+  /// recent maps, in front of OSDService::map_cache
+  MapRefCache<OSDMap> map_cache;
+
+  /// OSDService::try_get_map() going through this shard's map_cache first
+  OSDMapRef try_get_map(epoch_t e);
+
   std::string shard_lock_name;
   ceph::mutex shard_lock;   ///< protects remaining members below
 
@@ -24,6 +24,7 @@
 #include <optional>
 #include <random>
 #include <sstream>
+#include <thread>
 #include <fmt/format.h>
 
 #include <boost/algorithm/string.hpp>
@@ -2394,6 +2395,10 @@ int OSDMap::apply_incremental(const Incremental &inc)
     return 0;
   }
 
+  if (pg_mapping_cache.is_enabled()) {
+    _update_pg_mapping_cache(inc);
+  }
+
   // nope, incremental.
   if (inc.new_flags >= 0) {
     flags = inc.new_flags;
@@ -3140,6 +3145,337 @@ void OSDMap::pg_to_raw_up(pg_t pg, vector<int> *up, int *primary) const
   _apply_primary_affinity(pps, *pool, up, primary);
 }
 
+// ---------------------------
+// PGMappingCache
+
+bool PGMappingCache::get(pg_t pg,
+			 vector<int> *up,
+			 int *up_primary,
+			 vector<int> *acting,
+			 int *acting_primary) const
+{
+  auto p = pools.find(pg.pool());
+  if (p == pools.end() || pg.ps() >= p->second.pg_num ||
+      std::atomic_ref(p->second.state[pg.ps()]).load(
+	std::memory_order_acquire) != ROW_VALID) {
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  auto& t = p->second;
+  const int32_t *row = &t.table[t.row_size() * pg.ps()];
+  if (up_primary) {
+    *up_primary = row[0];
+  }
+  if (acting_primary) {
+    *acting_primary = row[1];
+  }
+  if (up) {
+    up->assign(row + 5, row + 5 + row[2]);
+  }
+  if (acting) {
+    acting->assign(row + 5 + t.size, row + 5 + t.size + row[3]);
+  }
+  hits.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void PGMappingCache::put(pg_t pg,
+			 const vector<int>& raw,
+			 const vector<int>& up,
+			 int up_primary,
+			 const vector<int>& acting,
+			 int acting_primary) const
+{
+  auto p = pools.find(pg.pool());
+  if (p == pools.end() || pg.ps() >= p->second.pg_num) {
+    return;
+  }
+  auto& t = p->second;
+  if (raw.size() > t.size || up.size() > t.size || acting.size() > t.size) {
+    // e.g. an oversized pg_temp, keep computing this one
+    return;
+  }
+  // whoever gets to fill the row first does it, the others (computing
+  // the same result) just return theirs
+  std::atomic_ref state(t.state[pg.ps()]);
+  uint8_t expected = ROW_EMPTY;
+  if (!state.compare_exchange_strong(expected, ROW_FILLING,
+				     std::memory_order_acquire)) {
+    return;
+  }
+  int32_t *row = &t.table[t.row_size() * pg.ps()];
+  row[0] = up_primary;
+  row[1] = acting_primary;
+  row[2] = up.size();
+  row[3] = acting.size();
+  row[4] = raw.size();
+  std::copy(up.begin(), up.end(), row + 5);
+  std::copy(acting.begin(), acting.end(), row + 5 + t.size);
+  std::copy(raw.begin(), raw.end(), row + 5 + 2 * t.size);
+  state.store(ROW_VALID, std::memory_order_release);
+}
+
+void PGMappingCache::reset_pool(int64_t pool, unsigned size, unsigned pg_num)
+{
+  pools.erase(pool);
+  pools.emplace(std::piecewise_construct,
+		std::forward_as_tuple(pool),
+		std::forward_as_tuple(size, pg_num));
+}
+
+void PGMappingCache::invalidate(pg_t pg)
+{
+  auto p = pools.find(pg.pool());
+  if (p != pools.end() && pg.ps() < p->second.pg_num) {
+    p->second.state[pg.ps()] = ROW_EMPTY;
+  }
+}
+
+void PGMappingCache::invalidate_pool(int64_t pool)
+{
+  auto p = pools.find(pool);
+  if (p != pools.end()) {
+    std::fill(p->second.state.begin(), p->second.state.end(), ROW_EMPTY);
+  }
+}
+
+void PGMappingCache::invalidate_osds(const set<int>& osds)
+{
+  if (osds.empty()) {
+    return;
+  }
+  auto affected = [&](const int32_t *v, int32_t n) {
+    for (int32_t i = 0; i < n; ++i) {
+      if (osds.count(v[i])) {
+	return true;
+      }
+    }
+    return false;
+  };
+  for (auto& [pool, t] : pools) {
+    for (unsigned ps = 0; ps < t.pg_num; ++ps) {
+      if (t.state[ps] != ROW_VALID) {
+	continue;
+      }
+      const int32_t *row = &t.table[t.row_size() * ps];
+      // up is a subset of raw
+      if (affected(row + 5 + t.size, row[3]) ||
+	  affected(row + 5 + 2 * t.size, row[4])) {
+	t.state[ps] = ROW_EMPTY;
+      }
+    }
+  }
+}
+
+void PGMappingCache::invalidate_all()
+{
+  for (auto& [pool, t] : pools) {
+    std::fill(t.state.begin(), t.state.end(), ROW_EMPTY);
+  }
+}
+
+uint64_t PGMappingCache::get_num_cached() const
+{
+  uint64_t n = 0;
+  for (auto& [pool, t] : pools) {
+    n += std::count(t.state.begin(), t.state.end(), ROW_VALID);
+  }
+  return n;
+}
+
+void OSDMap::enable_pg_mapping_cache(bool enable)
+{
+  pg_mapping_cache.set_enabled(enable);
+  if (enable) {
+    _reset_pg_mapping_cache();
+  }
+}
+
+void OSDMap::_reset_pg_mapping_cache()
+{
+  if (!pg_mapping_cache.is_enabled()) {
+    return;
+  }
+  pg_mapping_cache.set_enabled(false); // drops all tables
+  pg_mapping_cache.set_enabled(true);
+  for (auto& [id, pool] : pools) {
+    pg_mapping_cache.reset_pool(id, pool.get_size(), pool.get_pg_num());
+  }
+}
+
+// Called before the incremental gets applied: drop whatever it can
+// change. A new crush map, max_osd or osd existence invalidates all the
+// rows, up/down and primary affinity changes only the rows the osd shows
+// up in, and pg_temp/upmap changes only the pgs they are about.
+//
+// An osd whose weight drops is rejected by CRUSH more often, which only
+// changes the pgs it was mapped to. An osd whose weight grows may now be
+// accepted by any pg whose rule can reach it, so the pools using such a
+// rule are dropped, along with the pgs upmapped to it.
+void OSDMap::_update_pg_mapping_cache(const Incremental& inc)
+{
+  bool all = inc.crush.length() ||
+    inc.change_stretch_mode ||
+    (inc.new_max_osd >= 0 && inc.new_max_osd != max_osd);
+  set<int> osds;
+  set<int> weight_up_osds;
+  for (auto& [osd, w] : inc.new_weight) {
+    if (osd >= max_osd) {
+      all = true;
+    } else if (w < osd_weight[osd]) {
+      osds.insert(osd);
+    } else if (w > osd_weight[osd]) {
+      weight_up_osds.insert(osd);
+    }
+  }
+  for (auto& [osd, state] : inc.new_state) {
+    int s = state ? state : CEPH_OSD_UP;
+    if (s & CEPH_OSD_EXISTS) {
+      all = true;
+    } else if (s & CEPH_OSD_UP) {
+      osds.insert(osd);
+    }
+  }
+  for (auto& [osd, addrs] : inc.new_up_client) {
+    if (!exists(osd)) {
+      all = true;
+    } else if (is_down(osd)) {
+      osds.insert(osd);
+    }
+  }
+  for (auto& [osd, a] : inc.new_primary_affinity) {
+    if (osd >= max_osd || get_primary_affinity(osd) != a) {
+      osds.insert(osd);
+    }
+  }
+
+  for (auto& id : inc.old_pools) {
+    pg_mapping_cache.remove_pool(id);
+  }
+  for (auto& [id, pool] : inc.new_pools) {
+    auto p = pools.find(id);
+    if (p == pools.end() ||
+	p->second.get_pg_num() != pool.get_pg_num() ||
+	p->second.get_pgp_num() != pool.get_pgp_num() ||
+	p->second.get_size() != pool.get_size() ||
+	p->second.get_crush_rule() != pool.get_crush_rule() ||
+	p->second.get_type() != pool.get_type() ||
+	p->second.get_flags() != pool.get_flags() ||
+	p->second.nonprimary_shards != pool.nonprimary_shards) {
+      pg_mapping_cache.reset_pool(id, pool.get_size(), pool.get_pg_num());
+    }
+  }
+  if (all) {
+    pg_mapping_cache.invalidate_all();
+    return;
+  }
+
+  if (!weight_up_osds.empty()) {
+    map<int,bool> rule_reaches; // by crush rule
+    for (auto& [id, pool] : pools) {
+      int rule = pool.get_crush_rule();
+      auto [r, inserted] = rule_reaches.emplace(rule, false);
+      if (inserted) {
+	set<int> takes;
+	crush->find_takes_by_rule(rule, &takes);
+	for (auto take : takes) {
+	  for (auto osd : weight_up_osds) {
+	    if (crush->subtree_contains(take, osd)) {
+	      r->second = true;
+	    }
+	  }
+	}
+      }
+      if (r->second) {
+	pg_mapping_cache.invalidate_pool(id);
+      }
+    }
+    // upmaps to an out osd are ignored until it comes back in
+    for (auto& [pg, v] : pg_upmap) {
+      for (auto osd : v) {
+	if (weight_up_osds.count(osd)) {
+	  pg_mapping_cache.invalidate(pg);
+	  break;
+	}
+      }
+    }
+    for (auto& [pg, v] : pg_upmap_items) {
+      for (auto& [from, to] : v) {
+	if (weight_up_osds.count(to)) {
+	  pg_mapping_cache.invalidate(pg);
+	  break;
+	}
+      }
+    }
+    for (auto& [pg, osd] : pg_upmap_primaries) {
+      if (weight_up_osds.count(osd)) {
+	pg_mapping_cache.invalidate(pg);
+      }
+    }
+  }
+
+  for (auto& [pg, v] : inc.new_pg_temp) {
+    pg_mapping_cache.invalidate(pg);
+  }
+  for (auto& [pg, v] : inc.new_primary_temp) {
+    pg_mapping_cache.invalidate(pg);
+  }
+  for (auto& [pg, v] : inc.new_pg_upmap) {
+    pg_mapping_cache.invalidate(pg);
+  }
+  for (auto& pg : inc.old_pg_upmap) {
+    pg_mapping_cache.invalidate(pg);
+  }
+  for (auto& [pg, v] : inc.new_pg_upmap_items) {
+    pg_mapping_cache.invalidate(pg);
+  }
+  for (auto& pg : inc.old_pg_upmap_items) {
+    pg_mapping_cache.invalidate(pg);
+  }
+  for (auto& [pg, v] : inc.new_pg_upmap_primary) {
+    pg_mapping_cache.invalidate(pg);
+  }
+  for (auto& pg : inc.old_pg_upmap_primary) {
+    pg_mapping_cache.invalidate(pg);
+  }
+
+  if (!osds.empty()) {
+    pg_mapping_cache.invalidate_osds(osds);
+    // down osds are filtered out of the cached acting sets
+    for (const auto& [pg, v] : *pg_temp) {
+      for (auto osd : v) {
+	if (osds.count(osd)) {
+	  pg_mapping_cache.invalidate(pg);
+	  break;
+	}
+      }
+    }
+  }
+}
+
+void OSDMap::prime_pg_mapping_cache(unsigned num_threads) const
+{
+  ceph_assert(pg_mapping_cache.is_enabled());
+  vector<pg_t> pgs;
+  for (auto& [id, pool] : pools) {
+    for (unsigned ps = 0; ps < pool.get_pg_num(); ++ps) {
+      pgs.emplace_back(ps, id);
+    }
+  }
+  num_threads = std::max(1u, num_threads);
+  vector<std::thread> threads;
+  for (unsigned t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      for (size_t i = t; i < pgs.size(); i += num_threads) {
+	_pg_to_up_acting_osds(pgs[i], nullptr, nullptr, nullptr, nullptr);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
 void OSDMap::_pg_to_up_acting_osds(
   const pg_t& pg, vector<int> *up, int *up_primary,
   vector<int> *acting, int *acting_primary,
@@ -3158,6 +3494,12 @@ void OSDMap::_pg_to_up_acting_osds(
       *acting_primary = -1;
     return;
   }
+  bool use_cache = pg_mapping_cache.is_enabled() &&
+    pg.ps() < pool->get_pg_num();
+  if (use_cache &&
+      pg_mapping_cache.get(pg, up, up_primary, acting, acting_primary)) {
+    return;
+  }
   vector<int> raw;
   vector<int> _up;
   vector<int> _acting;
@@ -3165,7 +3507,7 @@ void OSDMap::_pg_to_up_acting_osds(
   int _acting_primary;
   ps_t pps;
   _get_temp_osds(*pool, pg, &_acting, &_acting_primary);
-  if (_acting.empty() || up || up_primary) {
+  if (_acting.empty() || up || up_primary || use_cache) {
     _pg_to_raw_osds(*pool, pg, &raw, &pps);
     _apply_upmap(*pool, pg, &raw);
     _raw_to_up_osds(*pool, raw, &_up);
@@ -3177,6 +3519,10 @@ void OSDMap::_pg_to_up_acting_osds(
         _acting_primary = _up_primary;
       }
     }
+    if (use_cache) {
+      pg_mapping_cache.put(pg, raw, _up, _up_primary, _acting,
+			   _acting_primary);
+    }
   
     if (up)
       up->swap(_up);
@@ -3993,6 +4339,7 @@ void OSDMap::post_decode()
 
   calc_num_osds();
   _calc_up_osd_features();
+  _reset_pg_mapping_cache();
 }
 
 void OSDMap::dump_erasure_code_profiles(
@@ -25,6 +25,7 @@
  *   disks, disk groups, total # osds,
  *
  */
+#include <atomic>
 #include <vector>
 #include <list>
 #include <set>
@@ -358,6 +359,110 @@ struct PGTempMap {
 };
 WRITE_CLASS_ENCODER(PGTempMap)
 
+/**
+ * PGMappingCache
+ *
+ * Optional cache of the up/acting sets of every PG, owned by an OSDMap.
+ * Unlike OSDMapMapping it is not computed up front: rows are filled by
+ * the lookups themselves (lock free, so concurrent readers fill it in
+ * parallel), and it survives OSDMap::apply_incremental(), which only
+ * invalidates the rows the incremental may have changed.
+ * Tables are only (re)sized while the owning map is being modified.
+ */
+class PGMappingCache {
+public:
+  MEMPOOL_CLASS_HELPERS();
+private:
+  enum : uint8_t {
+    ROW_EMPTY = 0,
+    ROW_FILLING,
+    ROW_VALID,
+  };
+
+  struct PoolTable {
+    MEMPOOL_CLASS_HELPERS();
+
+    unsigned size = 0;    ///< max number of osds in a set a row holds
+    unsigned pg_num = 0;
+    mutable mempool::osdmap_mapping::vector<uint8_t> state;
+    mutable mempool::osdmap_mapping::vector<int32_t> table;
+
+    size_t row_size() const {
+      return
+	1 + // up_primary
+	1 + // acting_primary
+	1 + // num up
+	1 + // num acting
+	1 + // num raw
+	size + // up
+	size + // acting
+	size;  // raw (after upmap, before dropping down osds)
+    }
+
+    PoolTable(unsigned s, unsigned p)
+      : size(s),
+	pg_num(p),
+	state(p, ROW_EMPTY),
+	table(p * row_size()) {
+    }
+  };
+
+  bool enabled = false;
+  mempool::osdmap_mapping::map<int64_t,PoolTable> pools;
+  mutable std::atomic<uint64_t> hits = 0, misses = 0;
+
+public:
+  PGMappingCache() = default;
+  // a copied map starts without a cache of its own
+  PGMappingCache(const PGMappingCache&) {}
+  PGMappingCache& operator=(const PGMappingCache&) {
+    enabled = false;
+    pools.clear();
+    return *this;
+  }
+
+  bool is_enabled() const {
+    return enabled;
+  }
+  void set_enabled(bool e) {
+    enabled = e;
+    if (!enabled) {
+      pools.clear();
+    }
+  }
+
+  bool get(pg_t pg,
+	   std::vector<int> *up,
+	   int *up_primary,
+	   std::vector<int> *acting,
+	   int *acting_primary) const;
+  void put(pg_t pg,
+	   const std::vector<int>& raw,
+	   const std::vector<int>& up,
+	   int up_primary,
+	   const std::vector<int>& acting,
+	   int acting_primary) const;
+
+  /// (re)create the (empty) table of a pool
+  void reset_pool(int64_t pool, unsigned size, unsigned pg_num);
+  void remove_pool(int64_t pool) {
+    pools.erase(pool);
+  }
+  void invalidate(pg_t pg);
+  void invalidate_pool(int64_t pool);
+  /// invalidate the pgs any of the osds is mapped to
+  void invalidate_osds(const std::set<int>& osds);
+  void invalidate_all();
+
+  uint64_t get_hits() const {
+    return hits;
+  }
+  uint64_t get_misses() const {
+    return misses;
+  }
+  uint64_t get_num_cached() const;
+};
+
 /** OSDMap
  */
 class OSDMap {
@@ -683,6 +788,11 @@ private:
 private:
   uint32_t crush_version = 1;
 
+  PGMappingCache pg_mapping_cache;
+
+  void _reset_pg_mapping_cache();
+  void _update_pg_mapping_cache(const Incremental& inc);
+
   friend class OSDMonitor;
 
  public:
@@ -1321,6 +1431,19 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+
+  /**
+   * Cache the up/acting sets of the pgs across lookups and epochs, see
+   * PGMappingCache. Meant for long lived maps which are updated in place
+   * by apply_incremental(), e.g. the Objecter's. Copies of the map don't
+   * inherit it.
+   */
+  void enable_pg_mapping_cache(bool enable = true);
+  const PGMappingCache& get_pg_mapping_cache() const {
+    return pg_mapping_cache;
+  }
+  /// fill the pg mapping cache for all pgs using the given number of threads
+  void prime_pg_mapping_cache(unsigned num_threads) const;
   bool pg_is_ec(pg_t pg) const {
     auto i = pools.find(pg.pool());
     ceph_assert(i != pools.end());
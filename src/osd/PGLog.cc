@@ -46,10 +46,8 @@ void PGLog::IndexedLog::split_out_child(
   unsigned split_bits,
   PGLog::IndexedLog *target)
 {
-  unindex();
   *target = IndexedLog(pg_log_t::split_out_child(child_pgid, split_bits));
-  index();
-  target->index();
+  reindex();
   reset_rollback_info_trimmed_to_riter();
 }
 
@@ -691,6 +689,7 @@ void PGLog::write_log_and_missing(
       dirty_to_dups,
       dirty_from_dups,
       write_from_dups,
+      cct ? cct->_conf->osd_pg_log_trim_range_min : 0,
       &may_include_deletes_in_missing_dirty,
       (pg_log_debug ? &log_keys_debug : nullptr),
       this);
@@ -742,9 +741,43 @@ void PGLog::write_log_and_missing(
     eversion_t::max(),
     eversion_t(),
     eversion_t(),
+    0,
     may_include_deletes_in_missing_dirty, nullptr, dpp);
 }
 
+namespace {
+// the encoded entries only live until the transaction they are queued
+// on has been applied, so carve them out of a per-thread arena instead
+// of allocating a buffer for each of them
+ceph::buffer::arena& log_encode_arena()
+{
+  static thread_local ceph::buffer::arena arena;
+  return arena;
+}
+
+// the entries are visited in key order, the returned iterator is meant
+// to be the hint for inserting the next one
+map<string,bufferlist>::iterator encode_log_key(
+  map<string,bufferlist> *km,
+  map<string,bufferlist>::iterator hint,
+  const pg_log_entry_t& entry)
+{
+  bufferlist bl(sizeof(entry) * 2, log_encode_arena());
+  entry.encode_with_checksum(bl);
+  return km->insert_or_assign(hint, entry.get_key_name(), std::move(bl));
+}
+
+map<string,bufferlist>::iterator encode_log_key(
+  map<string,bufferlist> *km,
+  map<string,bufferlist>::iterator hint,
+  const pg_log_dup_t& entry)
+{
+  bufferlist bl(sizeof(entry) * 2, log_encode_arena());
+  encode(entry, bl);
+  return km->insert_or_assign(hint, entry.get_key_name(), std::move(bl));
+}
+} // anonymous namespace
+
 // static
 void PGLog::_write_log_and_missing_wo_missing(
   ObjectStore::Transaction& t,
@@ -785,22 +818,20 @@ void PGLog::_write_log_and_missing_wo_missing(
     clear_after(log_keys_debug, dirty_from.get_key_name());
   }
 
+  auto hint = km->end();
   for (auto p = log.log.begin();
        p != log.log.end() && p->version <= dirty_to;
        ++p) {
-    bufferlist bl(sizeof(*p) * 2);
-    p->encode_with_checksum(bl);
-    (*km)[p->get_key_name()] = std::move(bl);
+    hint = std::next(encode_log_key(km, hint, *p));
   }
 
+  hint = km->end();
   for (auto p = log.log.rbegin();
        p != log.log.rend() &&
 	 (p->version >= dirty_from || p->version >= writeout_from) &&
 	 p->version >= dirty_to;
        ++p) {
-    bufferlist bl(sizeof(*p) * 2);
-    p->encode_with_checksum(bl);
-    (*km)[p->get_key_name()] = std::move(bl);
+    hint = encode_log_key(km, hint, *p);
   }
 
   if (log_keys_debug) {
@@ -839,12 +870,11 @@ void PGLog::_write_log_and_missing_wo_missing(
 
   ldpp_dout(dpp, 10) << __func__ << " going to encode log.dups.size()="
 		     << log.dups.size() << dendl;
+  hint = km->end();
   for (const auto& entry : log.dups) {
     if (entry.version > dirty_to_dups)
       break;
-    bufferlist bl;
-    encode(entry, bl);
-    (*km)[entry.get_key_name()] = std::move(bl);
+    hint = std::next(encode_log_key(km, hint, entry));
   }
   ldpp_dout(dpp, 10) << __func__ << " 1st round encoded log.dups.size()="
 		     << log.dups.size() << dendl;
@@ -853,9 +883,7 @@ void PGLog::_write_log_and_missing_wo_missing(
 	 (p->version >= dirty_from_dups || p->version >= write_from_dups) &&
 	 p->version >= dirty_to_dups;
        ++p) {
-    bufferlist bl;
-    encode(*p, bl);
-    (*km)[p->get_key_name()] = std::move(bl);
+    hint = encode_log_key(km, hint, *p);
   }
   ldpp_dout(dpp, 10) << __func__ << " 2st round encoded log.dups.size()="
 		     << log.dups.size() << dendl;
@@ -894,6 +922,7 @@ void PGLog::_write_log_and_missing(
   eversion_t dirty_to_dups,
   eversion_t dirty_from_dups,
   eversion_t write_from_dups,
+  uint64_t trim_range_min,
   bool *may_include_deletes_in_missing_dirty, // in/out param
   set<string> *log_keys_debug,
   const DoutPrefixProvider *dpp
@@ -903,21 +932,51 @@ void PGLog::_write_log_and_missing(
 		     << " dirty_from_dups=" << dirty_from_dups
 		     << " write_from_dups=" << write_from_dups
 		     << " trimmed_dups.size()=" << trimmed_dups.size() << dendl;
+  if (touch_log)
+    t.touch(coll, log_oid);
+
+  // trimming only ever drops the oldest entries and dups, and the keys
+  // of both sort by version, so there is nothing but trimmed keys
+  // between the first and the last of them.  a range removal saves a
+  // key per trimmed version, but RocksDB iterates over short ranges to
+  // delete their keys, i.e. reads where blind deletes would do, so only
+  // large trims are removed as ranges.
+  auto remove_as_range = [trim_range_min](size_t n) {
+    return trim_range_min && n >= trim_range_min;
+  };
   set<string> to_remove;
-  to_remove.swap(trimmed_dups);
-  for (auto& t : trimmed) {
-    string key = t.get_key_name();
+  if (!trimmed.empty()) {
     if (log_keys_debug) {
-      auto it = log_keys_debug->find(key);
-      ceph_assert(it != log_keys_debug->end());
-      log_keys_debug->erase(it);
+      for (auto& v : trimmed) {
+	auto it = log_keys_debug->find(v.get_key_name());
+	ceph_assert(it != log_keys_debug->end());
+	log_keys_debug->erase(it);
+      }
+    }
+    if (remove_as_range(trimmed.size())) {
+      t.omap_rmkeyrange(
+	coll, log_oid,
+	trimmed.begin()->get_key_name(),
+	trimmed.rbegin()->get_key_name() + '\0');
+    } else {
+      for (auto& v : trimmed) {
+	to_remove.emplace(v.get_key_name());
+      }
+    }
+    trimmed.clear();
+  }
+  if (!trimmed_dups.empty()) {
+    if (remove_as_range(trimmed_dups.size())) {
+      t.omap_rmkeyrange(
+	coll, log_oid,
+	*trimmed_dups.begin(),
+	*trimmed_dups.rbegin() + '\0');
+    } else {
+      to_remove.merge(trimmed_dups);
     }
-    to_remove.emplace(std::move(key));
+    trimmed_dups.clear();
   }
-  trimmed.clear();
 
-  if (touch_log)
-    t.touch(coll, log_oid);
   if (dirty_to != eversion_t()) {
     t.omap_rmkeyrange(
       coll, log_oid,
@@ -933,22 +992,20 @@ void PGLog::_write_log_and_missing(
     clear_after(log_keys_debug, dirty_from.get_key_name());
   }
 
+  auto hint = km->end();
   for (auto p = log.log.begin();
        p != log.log.end() && p->version <= dirty_to;
        ++p) {
-    bufferlist bl(sizeof(*p) * 2);
-    p->encode_with_checksum(bl);
-    (*km)[p->get_key_name()] = std::move(bl);
+    hint = std::next(encode_log_key(km, hint, *p));
   }
 
+  hint = km->end();
   for (auto p = log.log.rbegin();
        p != log.log.rend() &&
 	 (p->version >= dirty_from || p->version >= writeout_from) &&
 	 p->version >= dirty_to;
        ++p) {
-    bufferlist bl(sizeof(*p) * 2);
-    p->encode_with_checksum(bl);
-    (*km)[p->get_key_name()] = std::move(bl);
+    hint = encode_log_key(km, hint, *p);
   }
 
   if (log_keys_debug) {
@@ -987,12 +1044,11 @@ void PGLog::_write_log_and_missing(
 
   ldpp_dout(dpp, 10) << __func__ << " going to encode log.dups.size()="
 		     << log.dups.size() << dendl;
+  hint = km->end();
   for (const auto& entry : log.dups) {
     if (entry.version > dirty_to_dups)
       break;
-    bufferlist bl;
-    encode(entry, bl);
-    (*km)[entry.get_key_name()] = std::move(bl);
+    hint = std::next(encode_log_key(km, hint, entry));
   }
   ldpp_dout(dpp, 10) << __func__ << " 1st round encoded log.dups.size()="
 		     << log.dups.size() << dendl;
@@ -1002,9 +1058,7 @@ void PGLog::_write_log_and_missing(
 	 (p->version >= dirty_from_dups || p->version >= write_from_dups) &&
 	 p->version >= dirty_to_dups;
        ++p) {
-    bufferlist bl;
-    encode(*p, bl);
-    (*km)[p->get_key_name()] = std::move(bl);
+    hint = encode_log_key(km, hint, *p);
   }
   ldpp_dout(dpp, 10) << __func__ << " 2st round encoded log.dups.size()="
 		     << log.dups.size() << dendl;
@@ -122,6 +122,11 @@ constexpr auto PGLOG_INDEXED_ALL              = PGLOG_INDEXED_OBJECTS
                                               | PGLOG_INDEXED_CALLER_OPS 
                                               | PGLOG_INDEXED_EXTRA_CALLER_OPS 
                                               | PGLOG_INDEXED_DUPS;
+// the reqid indices are only needed to detect dup ops on the primary and
+// are as big as the log (and the dups) themselves, so a freshly loaded,
+// split, merged or claimed log only indexes its objects and leaves the
+// rest to the first lookup that needs them
+constexpr auto PGLOG_INDEXED_ON_LOAD          = PGLOG_INDEXED_OBJECTS;
 
 struct PGLog : DoutPrefixProvider {
   std::ostream& gen_prefix(std::ostream& out) const override {
@@ -169,10 +174,10 @@ public:
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    mutable std::unordered_map<hobject_t, pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable std::unordered_map<osd_reqid_t, pg_log_entry_t*> caller_ops;
-    mutable std::unordered_multimap<osd_reqid_t, pg_log_entry_t*> extra_caller_ops;
-    mutable std::unordered_map<osd_reqid_t, pg_log_dup_t*> dup_index;
+    mutable mempool::osd_pglog::unordered_map<hobject_t, pg_log_entry_t*> objects;  // ptrs into log.  be careful!
+    mutable mempool::osd_pglog::unordered_map<osd_reqid_t, pg_log_entry_t*> caller_ops;
+    mutable mempool::osd_pglog::unordered_multimap<osd_reqid_t, pg_log_entry_t*> extra_caller_ops;
+    mutable mempool::osd_pglog::unordered_map<osd_reqid_t, pg_log_dup_t*> dup_index;
 
     // recovery pointers
     std::list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -249,7 +254,7 @@ public:
       rollback_info_trimmed_to_riter(log.rbegin())
     {
       reset_rollback_info_trimmed_to_riter();
-      index();
+      index(PGLOG_INDEXED_ON_LOAD);
     }
 
     IndexedLog(const IndexedLog &rhs) :
@@ -301,7 +306,7 @@ public:
 
     mempool::osd_pglog::list<pg_log_entry_t> rewind_from_head(eversion_t newhead, bool *dirty_log = nullptr) {
       auto divergent = pg_log_t::rewind_from_head(newhead, dirty_log);
-      index();
+      reindex();
       reset_rollback_info_trimmed_to_riter();
       return divergent;
     }
@@ -330,7 +335,6 @@ public:
       *this = IndexedLog(o);
 
       skip_can_rollback_to_to_head();
-      index();
     }
 
     void split_out_child(
@@ -561,6 +565,12 @@ public:
       indexed_data |= to_index;
     }
 
+    /// rebuild the indices built so far, plus those built on load, after
+    /// entries were moved around
+    void reindex() const {
+      index(indexed_data | PGLOG_INDEXED_ON_LOAD);
+    }
+
     void index_objects() const {
       index(PGLOG_INDEXED_OBJECTS);
     }
@@ -952,7 +962,6 @@ public:
   void merge_from(
     const std::vector<PGLog*>& sources,
     eversion_t last_update) {
-    unindex();
     missing.clear();
 
     std::vector<pg_log_t*> slogs;
@@ -961,7 +970,7 @@ public:
     }
     log.merge_from(slogs, last_update);
 
-    index();
+    log.reindex();
 
     mark_log_for_rewrite();
   }
@@ -1557,6 +1566,7 @@ public:
     eversion_t dirty_to_dups,
     eversion_t dirty_from_dups,
     eversion_t write_from_dups,
+    uint64_t trim_range_min,
     bool *may_include_deletes_in_missing_dirty,
     std::set<std::string> *log_keys_debug,
     const DoutPrefixProvider *dpp = nullptr
@@ -269,6 +269,12 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_avg(
     l_osd_map_cache_miss_low_avg, "osd_map_cache_miss_low_avg",
     "osdmap cache miss, avg distance below cache lower bound");
+  osd_plb.add_u64_counter(
+    l_osd_map_shard_cache_hit, "osd_map_shard_cache_hit",
+    "osdmap per-shard cache hit (summed up every tick)");
+  osd_plb.add_u64_counter(
+    l_osd_map_shard_cache_miss, "osd_map_shard_cache_miss",
+    "osdmap per-shard cache miss (summed up every tick)");
   osd_plb.add_u64_counter(
     l_osd_map_bl_cache_hit, "osd_map_bl_cache_hit",
     "OSDMap buffer cache hits");
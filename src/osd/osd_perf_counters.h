@@ -100,6 +100,8 @@ enum osd_counter_idx_t {
   l_osd_map_cache_miss,
   l_osd_map_cache_miss_low,
   l_osd_map_cache_miss_low_avg,
+  l_osd_map_shard_cache_hit,
+  l_osd_map_shard_cache_miss,
   l_osd_map_bl_cache_hit,
   l_osd_map_bl_cache_miss,
 
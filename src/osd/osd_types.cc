@@ -5056,10 +5056,14 @@ string pg_log_entry_t::get_key_name() const
 void pg_log_entry_t::encode_with_checksum(ceph::buffer::list& bl) const
 {
   using ceph::encode;
-  ceph::buffer::list ebl(sizeof(*this)*2);
-  this->encode(ebl);
-  __u32 crc = ebl.crc32c(0);
-  encode(ebl, bl);
+  // same layout as encode(ebl, bl); encode(crc32c(ebl), bl), but encode
+  // in place instead of through a temporary bufferlist
+  auto filler = bl.append_hole(sizeof(ceph_le32));
+  const unsigned start = bl.length();
+  this->encode(bl);
+  ceph_le32 len(bl.length() - start);
+  filler.copy_in(sizeof(len), reinterpret_cast<const char*>(&len));
+  __u32 crc = bl.cbegin(start).crc32c(bl.length() - start, 0);
   encode(crc, bl);
 }
 
@@ -1286,6 +1286,8 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	else if (m->maps.count(e)) {
 	  ldout(cct, 3) << "handle_osd_map decoding full epoch " << e << dendl;
           auto new_osdmap = std::make_unique<OSDMap>();
+          new_osdmap->enable_pg_mapping_cache(
+            osdmap->get_pg_mapping_cache().is_enabled());
           new_osdmap->decode(m->maps[e]);
 
           emit_blocklist_events(*osdmap, *new_osdmap);
@@ -5474,6 +5476,9 @@ Objecter::Objecter(CephContext *cct,
     ldout(cct, 20) << __func__ << ": read policy: balance" << dendl;
     extra_read_flags = CEPH_OSD_FLAG_BALANCE_READS;
   }
+  if (cct->_conf->objecter_cache_pg_mapping) {
+    osdmap->enable_pg_mapping_cache();
+  }
 }
 
 Objecter::~Objecter()
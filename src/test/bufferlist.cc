@@ -25,6 +25,7 @@
 #include <sys/uio.h>
 
 #include <iostream> // for std::cout
+#include <thread>
 
 #include "include/buffer.h"
 #include "include/buffer_raw.h"
@@ -1355,6 +1356,85 @@ TEST(BufferList, append_after_move) {
   EXPECT_EQ(0, ::memcmp("ABC123", moved_to_bl.c_str(), 6));
 }
 
+TEST(BufferArena, create) {
+  std::vector<bufferptr> ptrs;
+  {
+    buffer::arena a(4096);
+    // enough to span several chunks, plus one that doesn't fit any
+    for (unsigned i = 0; i < 200; ++i) {
+      bufferptr p(a.create(i % 64 + 1));
+      memset(p.c_str(), i, p.length());
+      ptrs.push_back(std::move(p));
+    }
+    bufferptr big(a.create(8192));
+    memset(big.c_str(), 0xff, big.length());
+    ptrs.push_back(std::move(big));
+  }
+  for (unsigned i = 0; i < 200; ++i) {
+    ASSERT_EQ(i % 64 + 1, ptrs[i].length());
+    for (unsigned j = 0; j < ptrs[i].length(); ++j) {
+      ASSERT_EQ((char)i, ptrs[i][j]);
+    }
+  }
+  ASSERT_EQ(8192u, ptrs.back().length());
+  // release out of order
+  for (unsigned i = 0; i < ptrs.size(); i += 2) {
+    ptrs[i] = bufferptr();
+  }
+  ptrs.clear();
+}
+
+TEST(BufferArena, reserve) {
+  buffer::arena a;
+  bufferlist bl(40, a);
+  bl.append("ABC", 3);
+  encode(uint64_t(42), bl);
+  EXPECT_EQ(1, bl.get_num_buffers());
+  EXPECT_EQ(40u - 11u, bl.get_append_buffer_unused_tail_length());
+  bufferlist copy;
+  copy.append(bl);
+  auto p = copy.cbegin();
+  p += 3;
+  uint64_t v;
+  decode(v, p);
+  EXPECT_EQ(42u, v);
+}
+
+void bench_small_encode(const char *name, unsigned num,
+                        std::function<void(bufferlist&)> reserve)
+{
+  utime_t start = ceph_clock_now();
+  for (unsigned i = 0; i < num; ++i) {
+    std::map<std::string, bufferlist> km;
+    for (unsigned j = 0; j < 64; ++j) {
+      bufferlist bl;
+      reserve(bl);
+      encode(uint64_t(i), bl);
+      encode(std::string("0000000042.00000000000000000042"), bl);
+      km[std::to_string(j)] = std::move(bl);
+    }
+  }
+  utime_t end = ceph_clock_now();
+  cout << name << ": " << num * 64 << " small encodes in " << (end - start)
+       << " (" << (double)(end - start) * 1e9 / (num * 64) << " ns each)"
+       << std::endl;
+}
+
+TEST(BufferArena, BenchSmallEncode) {
+  const unsigned n = asan_bench_rounds(100000);
+  bench_small_encode("append", n, [](bufferlist&) {});
+  bench_small_encode("reserve", n, [](bufferlist& bl) { bl.reserve(64); });
+  bench_small_encode("old reserve", n, [](bufferlist& bl) {
+    auto ptr = buffer::ptr_node::create(buffer::create_small_page_aligned(64));
+    ptr->set_length(0);
+    bl.push_back(std::move(ptr));
+  });
+  {
+    buffer::arena a;
+    bench_small_encode("arena", n, [&a](bufferlist& bl) { bl.reserve(64, a); });
+  }
+}
+
 void bench_bufferlist_alloc(int size, int num, int per)
 {
   utime_t start = ceph_clock_now();
@@ -1368,6 +1448,32 @@ void bench_bufferlist_alloc(int size, int num, int per)
        << " in " << (end - start) << std::endl;
 }
 
+// run with CEPH_BUFFER_NO_CACHE=1 to compare against the system allocator
+TEST(BufferList, BenchPageAlignedAlloc) {
+  const unsigned n = asan_bench_rounds(1000000);
+  for (unsigned size = 4096; size <= 65536; size *= 2) {
+    utime_t start = ceph_clock_now();
+    for (unsigned i = 0; i < n; ++i) {
+      bufferptr p(buffer::create_page_aligned(size));
+    }
+    utime_t end = ceph_clock_now();
+    cout << n << " page aligned alloc/free of size " << size
+         << " in " << (end - start) << std::endl;
+  }
+  // producer/consumer: buffers allocated here are freed by another thread
+  std::vector<bufferptr> bufs;
+  utime_t start = ceph_clock_now();
+  for (unsigned i = 0; i < n / 256; ++i) {
+    for (unsigned j = 0; j < 256; ++j) {
+      bufs.emplace_back(buffer::create_page_aligned(4096));
+    }
+    std::thread([&bufs] { bufs.clear(); }).join();
+  }
+  utime_t end = ceph_clock_now();
+  cout << n / 256 * 256 << " page aligned alloc/remote free of size 4096"
+       << " in " << (end - start) << std::endl;
+}
+
 TEST(BufferList, BenchAlloc) {
   const int n = asan_bench_rounds(100000);
   bench_bufferlist_alloc(32768, n, 16);
@@ -2605,6 +2711,31 @@ TEST(BufferList, crc32c_append) {
   ASSERT_EQ(bl1.crc32c(0), bl2.crc32c(0));
 }
 
+TEST(BufferList, crc32c_copy) {
+  char buffer[10000];
+  for (size_t i = 0; i < sizeof(buffer); i++) {
+    buffer[i] = i * 7;
+  }
+  bufferptr p(sizeof(buffer));
+  uint32_t crc = ceph_crc32c_copy(-1, (unsigned char*)p.c_str(),
+                                  (unsigned char*)buffer, sizeof(buffer));
+  EXPECT_EQ(0, memcmp(p.c_str(), buffer, sizeof(buffer)));
+  p.set_crc32c(-1, crc);
+
+  buffer::track_cached_crc(true);
+  int base_cached = buffer::get_cached_crc();
+  int base_cached_adjusted = buffer::get_cached_crc_adjusted();
+
+  bufferlist bl;
+  bl.push_back(p);
+  EXPECT_EQ(ceph_crc32c(-1, (unsigned char*)buffer, sizeof(buffer)),
+            bl.crc32c(-1));
+  EXPECT_EQ(1 + base_cached, buffer::get_cached_crc());
+  EXPECT_EQ(ceph_crc32c(111, (unsigned char*)buffer, sizeof(buffer)),
+            bl.crc32c(111));
+  EXPECT_EQ(1 + base_cached_adjusted, buffer::get_cached_crc_adjusted());
+}
+
 TEST(BufferList, crc32c_zeros) {
   char buffer[4*1024];
   for (size_t i=0; i < sizeof(buffer); i++)
@@ -123,6 +123,8 @@
      --set-subtree-class <bucket-name> <class>
                            set class for all items beneath bucket-name
      --compare <otherfile> compare two maps using --test parameters
+     --compare-simd        compare the batch (SIMD) mapping with the scalar
+                           one using --test parameters
   
   Options for the output stage
   
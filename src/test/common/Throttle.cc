@@ -215,6 +215,68 @@ TEST_F(ThrottleTest, wait) {
   } while(!waited);
 }
 
+TEST_F(ThrottleTest, concurrent_get_put) {
+  const int64_t throttle_max = 4;
+  Throttle throttle(g_ceph_context, "throttle", throttle_max);
+  std::atomic<int64_t> holders = 0;
+  std::atomic<unsigned> overruns = 0;
+  vector<std::thread> threads;
+  for (unsigned t = 0; t < 8; ++t) {
+    threads.emplace_back([&] {
+      for (unsigned i = 0; i < 100000; ++i) {
+	if (i % 2) {
+	  throttle.get(1);
+	} else if (!throttle.get_or_fail(1)) {
+	  continue;
+	}
+	if (++holders > throttle_max) {
+	  ++overruns;
+	}
+	--holders;
+	throttle.put(1);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(0u, overruns);
+  ASSERT_EQ(0, throttle.get_current());
+}
+
+static void bench_throttle(unsigned nthreads, int64_t throttle_max)
+{
+  constexpr unsigned ops = 1000000;
+  Throttle throttle(g_ceph_context, "throttle_bench", throttle_max);
+  vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&] {
+      for (unsigned i = 0; i < ops / nthreads; ++i) {
+	throttle.get(1);
+	throttle.put(1);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+    std::chrono::steady_clock::now() - start;
+  cout << "threads " << nthreads << " max " << throttle_max
+       << " get+put " << elapsed.count() / ops << " ns" << std::endl;
+}
+
+// prints timings only, run with --gtest_also_run_disabled_tests
+TEST(ThrottleBench, DISABLED_get_put) {
+  for (unsigned nthreads = 1; nthreads <= 16; nthreads *= 2) {
+    // rarely full, the lock-free path
+    bench_throttle(nthreads, 1024);
+    // contended, getters queue up
+    bench_throttle(nthreads, 2);
+  }
+}
+
 std::pair<double, std::chrono::duration<double> > test_backoff(
   double low_threshhold,
   double high_threshhold,
@@ -378,6 +440,44 @@ TEST(BackoffThrottle, oversaturated)
   ASSERT_GT(results.second.count(), 0.0005);
 }
 
+TEST(BackoffThrottle, concurrent_get_put)
+{
+  // the delays are negligible, and getters now and then hold their
+  // slots across a yield, so current keeps crossing low_threshold and
+  // getters move between the lock-free path and the waiter queue
+  const uint64_t throttle_max = 16;
+  BackoffThrottle throttle(g_ceph_context, "backoff_throttle_concurrent", 5);
+  bool valid = throttle.set_params(0.4, 0.6, 1e9, 2, 10, throttle_max, 0);
+  ASSERT_TRUE(valid);
+
+  std::atomic<uint64_t> held = 0;
+  std::atomic<unsigned> overruns = 0;
+  vector<std::thread> threads;
+  for (unsigned t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 gen(t);
+      std::uniform_int_distribution<uint64_t> dis(1, 4);
+      for (unsigned i = 0; i < 20000; ++i) {
+	uint64_t c = dis(gen);
+	throttle.get(c);
+	if ((held += c) > throttle_max) {
+	  ++overruns;
+	}
+	if (i % 8 == 0) {
+	  std::this_thread::yield();
+	}
+	held -= c;
+	throttle.put(c);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(0u, overruns);
+  ASSERT_EQ(0u, throttle.get_current());
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ;
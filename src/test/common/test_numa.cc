@@ -70,3 +70,24 @@ TEST(cpu_set, round_trip_list)
   }
 }
 
+
+TEST(numa, pick_node)
+{
+  // storage and both networks on node 1
+  ASSERT_EQ(1, pick_numa_node(1, 1, 1, true, false, -1));
+  ASSERT_EQ(-1, pick_numa_node(1, 1, 1, false, false, -1));
+
+  // network elsewhere or unknown: only bound if the storage node is preferred
+  ASSERT_EQ(-1, pick_numa_node(1, 0, 0, true, false, -1));
+  ASSERT_EQ(-1, pick_numa_node(1, -1, -1, true, false, -1));
+  ASSERT_EQ(-1, pick_numa_node(1, 1, 0, true, false, -1));
+  ASSERT_EQ(1, pick_numa_node(1, 0, 0, true, true, -1));
+  ASSERT_EQ(1, pick_numa_node(1, -2, -1, false, true, -1));
+
+  // unknown storage node
+  ASSERT_EQ(-1, pick_numa_node(-1, 0, 0, true, true, -1));
+
+  // osd_numa_node takes precedence
+  ASSERT_EQ(0, pick_numa_node(1, 1, 1, true, true, 0));
+  ASSERT_EQ(2, pick_numa_node(-1, -1, -1, false, false, 2));
+}
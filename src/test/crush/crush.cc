@@ -19,6 +19,7 @@
 #include "common/ceph_argparse.h"
 #include "common/common_init.h"
 #include "common/JSONFormatter.h"
+#include "include/scope_guard.h"
 #include "include/stringify.h"
 
 #include "crush/CrushWrapper.h"
@@ -1558,3 +1559,52 @@ TEST_F(CRUSHTest, msr_multi_root) {
     }
   }
 }
+
+TEST_F(CRUSHTest, straw2_batch) {
+  // the batch (SIMD) straw2 path must pick exactly what the scalar one does
+  std::unique_ptr<CrushWrapper> c(new CrushWrapper);
+  const int ROOT_TYPE = 1;
+  c->set_type_name(ROOT_TYPE, "root");
+  const int OSD_TYPE = 0;
+  c->set_type_name(OSD_TYPE, "osd");
+
+  int n = 301;
+  vector<int> items(n), weights(n);
+  for (int i = 0; i < n; ++i) {
+    items[i] = i;
+    // a few zero weights, and unaligned tail
+    weights[i] = i % 37 ? 0x10000 * (1 + i % 5) : 0;
+  }
+  c->set_max_devices(n);
+
+  string root_name("default");
+  int root;
+  EXPECT_EQ(0, c->add_bucket(0, CRUSH_BUCKET_STRAW2, CRUSH_HASH_RJENKINS1,
+			     ROOT_TYPE, n, items.data(), weights.data(),
+			     &root));
+  EXPECT_EQ(0, c->set_item_name(root, root_name));
+  int rule = c->add_simple_rule("rule", root_name, "osd", "",
+				"firstn", pg_pool_t::TYPE_REPLICATED);
+  EXPECT_EQ(0, rule);
+  c->finalize();
+
+  vector<unsigned> reweight(n, 0x10000);
+  reweight[3] = 0;
+  reweight[4] = 0x8000;
+  vector<int> xs;
+  for (int x = 0; x < 10000; ++x) {
+    xs.push_back(x * 2654435761u);
+  }
+  vector<vector<int>> out;
+  c->do_rule_batch(rule, xs, out, 3, reweight, 0);
+  ASSERT_EQ(xs.size(), out.size());
+
+  // no SIMD hashing and the original scalar straw2 loop
+  int old = crush_hash_set_simd(0);
+  auto restore = make_scope_guard([old] { crush_hash_set_simd(old); });
+  for (size_t i = 0; i < xs.size(); ++i) {
+    vector<int> scalar;
+    c->do_rule(rule, xs[i], scalar, 3, reweight, 0);
+    ASSERT_EQ(scalar, out[i]) << "x " << xs[i];
+  }
+}
@@ -0,0 +1,211 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * In-process messenger throughput benchmark: a client messenger streams
+ * large MOSDOp writes over loopback to a server messenger in the same
+ * process, and the CPU time spent per transferred byte is reported.
+ * Compare runs with e.g. --ms_tcp_rx_direct_data=true/false.
+ *
+ * With the rep_op_reply message type, tiny MOSDRepOpReply messages are
+ * streamed instead, which is what replicas send back to the primary, and
+ * ops/s is the number to look at. Compare runs with different
+ * --ms_tcp_tx_batch_bytes.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+#include <iostream>
+#include <sys/resource.h>
+
+using namespace std;
+
+#include "common/ceph_argparse.h"
+#include "common/ceph_time.h"
+#include "common/debug.h"
+#include "global/global_init.h"
+#include "msg/Messenger.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDRepOpReply.h"
+#include "auth/DummyAuth.h"
+
+class ServerDispatcher : public Dispatcher {
+ public:
+  ceph::mutex lock = ceph::make_mutex("ServerDispatcher::lock");
+  ceph::condition_variable cond;
+  uint64_t received = 0;
+  uint64_t bytes = 0;
+
+  ServerDispatcher() : Dispatcher(g_ceph_context) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_OSD_OP ||
+      m->get_type() == MSG_OSD_REPOPREPLY;
+  }
+  void ms_handle_fast_connect(Connection *con) override {}
+  void ms_handle_fast_accept(Connection *con) override {}
+  bool ms_dispatch(Message *m) override { return true; }
+  void ms_fast_dispatch(Message *m) override {
+    uint64_t len = m->get_data().length();
+    m->put();
+    std::lock_guard l{lock};
+    ++received;
+    bytes += len;
+    cond.notify_all();
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  bool ms_handle_fast_authentication(Connection *con) override {
+    return true;
+  }
+};
+
+static ceph::timespan cpu_time()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ceph::make_timespan(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+    std::chrono::microseconds(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+void usage(const string &name) {
+  cout << "Usage: " << name << " [bind ip:port] [concurrency] [ios] [msg length] [msg type]" << std::endl;
+  cout << "       [bind ip:port]: address the server messenger binds to" << std::endl;
+  cout << "       [concurrency]: the max inflight messages(like iodepth in fio)" << std::endl;
+  cout << "       [ios]: how much messages are sent" << std::endl;
+  cout << "       [msg length]: message data bytes" << std::endl;
+  cout << "       [msg type]: osd_op (default) or rep_op_reply, the latter ignores msg length" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  auto args = argv_to_vec(argc, argv);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  if (args.size() < 4) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  uint64_t concurrent = atoi(args[1]);
+  uint64_t ios = atoi(args[2]);
+  int len = atoi(args[3]);
+  bool rep_op_reply = args.size() > 4 && std::string(args[4]) == "rep_op_reply";
+
+  std::string public_msgr_type = g_ceph_context->_conf->ms_public_type.empty() ? g_ceph_context->_conf.get_val<std::string>("ms_type") : g_ceph_context->_conf->ms_public_type;
+
+  cout << " using ms-public-type " << public_msgr_type << std::endl;
+  cout << "       bind ip:port " << args[0] << std::endl;
+  cout << "       concurrency " << concurrent << std::endl;
+  cout << "       ios " << ios << std::endl;
+  cout << "       message data bytes " << len << std::endl;
+  cout << "       message type " << (rep_op_reply ? "rep_op_reply" : "osd_op")
+       << std::endl;
+  cout << "       ms_tcp_rx_direct_data "
+       << g_ceph_context->_conf->ms_tcp_rx_direct_data << std::endl;
+  cout << "       ms_tcp_tx_batch_bytes "
+       << g_ceph_context->_conf->ms_tcp_tx_batch_bytes << std::endl;
+
+  DummyAuthClientServer dummy_auth(g_ceph_context);
+  dummy_auth.auth_registry.refresh_config();
+
+  entity_addr_t bind_addr;
+  bind_addr.parse(args[0]);
+  Messenger *server = Messenger::create(g_ceph_context, public_msgr_type,
+                                        entity_name_t::OSD(0), "server", 0);
+  server->set_default_policy(Messenger::Policy::stateless_server(0));
+  server->set_auth_client(&dummy_auth);
+  server->set_auth_server(&dummy_auth);
+  server->set_require_authorizer(false);
+  ServerDispatcher dispatcher;
+  server->add_dispatcher_head(&dispatcher);
+  if (server->bind(bind_addr) < 0) {
+    cerr << "failed to bind " << args[0] << std::endl;
+    return 1;
+  }
+  server->start();
+
+  Messenger *client = Messenger::create(g_ceph_context, public_msgr_type,
+                                        entity_name_t::CLIENT(0), "client", getpid());
+  client->set_default_policy(Messenger::Policy::lossless_client(0));
+  client->set_auth_client(&dummy_auth);
+  client->start();
+  ConnectionRef conn = client->connect_to_osd(server->get_myaddrs());
+
+  bufferptr ptr(len);
+  memset(ptr.c_str(), 0, len);
+  bufferlist data;
+  data.append(ptr);
+  object_t oid("object-name");
+  object_locator_t oloc(1, 1);
+  pg_t pgid;
+  hobject_t hobj(oid, oloc.key, CEPH_NOSNAP, pgid.ps(), pgid.pool(),
+                 oloc.nspace);
+
+  auto start = ceph::mono_clock::now();
+  auto cpu_start = cpu_time();
+  for (uint64_t i = 0; i < ios; ++i) {
+    {
+      std::unique_lock l{dispatcher.lock};
+      dispatcher.cond.wait(l, [&] {
+        return i - dispatcher.received < concurrent;
+      });
+    }
+    if (rep_op_reply) {
+      MOSDRepOpReply *m = new MOSDRepOpReply;
+      m->set_tid(i);
+      conn->send_message(m);
+    } else {
+      MOSDOp *m = new MOSDOp(0, 0, hobj, spg_t(pgid), 0, 0, 0);
+      bufferlist msg_data(data);
+      m->write(0, len, msg_data);
+      conn->send_message(m);
+    }
+  }
+  {
+    std::unique_lock l{dispatcher.lock};
+    dispatcher.cond.wait(l, [&] { return dispatcher.received == ios; });
+  }
+  auto elapsed = ceph::mono_clock::now() - start;
+  auto cpu = cpu_time() - cpu_start;
+
+  client->shutdown();
+  client->wait();
+  server->shutdown();
+  server->wait();
+
+  double secs = std::chrono::duration<double>(elapsed).count();
+  cout << " Total op " << ios << " bytes " << dispatcher.bytes
+       << " run time " << secs << "s"
+       << " ops/s " << ios / secs << std::endl;
+  double cpu_ns = std::chrono::duration<double, std::nano>(cpu).count();
+  cout << " throughput " << dispatcher.bytes / secs / (1 << 20) << " MiB/s"
+       << " cpu " << std::chrono::duration<double>(cpu).count() << "s"
+       << " cpu/op " << cpu_ns / ios << " ns";
+  if (dispatcher.bytes) {
+    cout << " cpu/byte " << cpu_ns / dispatcher.bytes << " ns";
+  }
+  cout << std::endl;
+
+  delete client;
+  delete server;
+  return 0;
+}
@@ -24,6 +24,7 @@
 #include <pthread.h>
 #include <stdint.h>
 #include <arpa/inet.h>
+#include "acconfig.h"
 #include "include/Context.h"
 #include "common/ceph_mutex.h"
 #include "common/Cond.h"
@@ -56,6 +57,9 @@
 #include "msg/async/EventKqueue.h"
 #endif
 #include "msg/async/EventSelect.h"
+#ifdef HAVE_LIBURING
+#include "msg/async/EventIoUring.h"
+#endif
 
 #include <gtest/gtest.h>
 
@@ -78,6 +82,12 @@ class EventDriverTest : public ::testing::TestWithParam<const char*> {
 #endif
     if (strcmp(GetParam(), "select"))
       driver = new SelectDriver(g_ceph_context);
+#ifdef HAVE_LIBURING
+    if (strcmp(GetParam(), "io_uring") == 0) {
+      delete driver;
+      driver = new IoUringDriver(g_ceph_context);
+    }
+#endif
     driver->init(NULL, 100);
   }
   void TearDown() override {
@@ -341,6 +351,9 @@ INSTANTIATE_TEST_SUITE_P(
 #endif
 #ifdef HAVE_KQUEUE
     "kqueue",
+#endif
+#ifdef HAVE_LIBURING
+    "io_uring",
 #endif
     "select"
   )
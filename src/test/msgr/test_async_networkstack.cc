@@ -1049,6 +1049,9 @@ INSTANTIATE_TEST_SUITE_P(
   ::testing::Values(
 #ifdef HAVE_DPDK
     "dpdk",
+#endif
+#ifdef HAVE_LIBURING
+    "io_uring",
 #endif
     "posix"
   )
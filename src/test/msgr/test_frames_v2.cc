@@ -16,6 +16,7 @@
 #include "msg/async/frames_v2.h"
 
 #include <numeric>
+#include <iostream>
 #include <ostream>
 #include <string>
 #include <tuple>
@@ -23,6 +24,7 @@
 #include "msg/async/compression_meta.h"
 #include "auth/Auth.h"
 #include "common/ceph_argparse.h"
+#include "common/ceph_time.h"
 #include "global/global_init.h"
 #include "global/global_context.h"
 #include "include/Context.h"
@@ -469,6 +471,134 @@ INSTANTIATE_TEST_SUITE_P(
         ::testing::ValuesIn(round_trip_perf_instances),
         ::testing::ValuesIn(modes)));
 
+static ceph::crypto::onwire::rxtx_t make_crypto(const bufferlist& secret,
+                                                bool crossed) {
+  AuthConnectionMeta auth_meta;
+  auth_meta.con_mode = CEPH_CON_MODE_SECURE;
+  auth_meta.connection_secret.assign(secret.c_str(),
+                                     secret.c_str() + secret.length());
+  return ceph::crypto::onwire::rxtx_t::create_handler_pair(
+      g_ceph_context, auth_meta, /*new_nonce_format=*/true, crossed);
+}
+
+static bufferlist make_secret() {
+  bufferptr secret(64);
+  g_ceph_context->random()->get_bytes(secret.c_str(), secret.length());
+  bufferlist bl;
+  bl.append(std::move(secret));
+  return bl;
+}
+
+// plaintext the way an encoded message looks like: lots of small
+// bufferptrs, optionally followed by a large payload
+static bufferlist make_fragmented(size_t small_len, size_t large_len) {
+  bufferlist bl;
+  for (size_t off = 0, i = 0; off < small_len; i++) {
+    size_t len = std::min(small_len - off, 1 + i % 23);
+    bl.append(make_bufferlist(len, 'a' + i % 26));
+    off += len;
+  }
+  if (large_len > 0) {
+    bl.append(make_bufferlist(large_len, 'L'));
+  }
+  return bl;
+}
+
+static bufferlist encrypt(ceph::crypto::onwire::TxHandler& tx,
+                          const std::vector<bufferlist>& plaintexts) {
+  std::vector<uint32_t> lens;
+  for (auto& bl : plaintexts) {
+    lens.push_back(bl.length());
+  }
+  tx.reset_tx_handler(lens.data(), lens.data() + lens.size());
+  for (auto& bl : plaintexts) {
+    tx.authenticated_encrypt_update(bl);
+  }
+  return tx.authenticated_encrypt_final();
+}
+
+TEST(CryptoOnwireTest, GatheredEncrypt) {
+  auto secret = make_secret();
+  auto tx_crypto = make_crypto(secret, false);
+  auto ref_tx_crypto = make_crypto(secret, false);
+  auto rx_crypto = make_crypto(secret, true);
+
+  for (size_t large_len : {0, 4095, 4096, 65536 + 5}) {
+    std::vector<bufferlist> plaintexts = {
+      make_fragmented(32, 0),
+      make_fragmented(300, large_len),
+      make_fragmented(1000, 0),
+      make_fragmented(0, large_len),
+      make_fragmented(13, 0),
+    };
+    auto ciphertext = encrypt(*tx_crypto.tx, plaintexts);
+
+    // the same plaintext handed over contiguously must give the very
+    // same ciphertext
+    std::vector<bufferlist> contiguous;
+    for (auto& bl : plaintexts) {
+      contiguous.emplace_back(bl);
+      contiguous.back().rebuild();
+    }
+    auto ref_ciphertext = encrypt(*ref_tx_crypto.tx, contiguous);
+    ASSERT_TRUE(ciphertext.contents_equal(ref_ciphertext));
+
+    bufferlist plaintext;
+    for (auto& bl : plaintexts) {
+      plaintext.append(bl);
+    }
+    rx_crypto.rx->reset_rx_handler();
+    rx_crypto.rx->authenticated_decrypt_update_final(ciphertext);
+    ASSERT_TRUE(plaintext.contents_equal(ciphertext));
+  }
+}
+
+// AES-GCM throughput of the onwire handlers on a single core
+class CryptoPerfTest : public ::testing::TestWithParam<size_t> {};
+
+TEST_P(CryptoPerfTest, DISABLED_Throughput) {
+  auto secret = make_secret();
+  auto tx_crypto = make_crypto(secret, false);
+  auto rx_crypto = make_crypto(secret, true);
+  // preamble, ceph_msg_header2 + front encoded piece by piece, data
+  const std::vector<bufferlist> plaintexts = {
+    make_fragmented(32, 0),
+    make_fragmented(41 + 250, 0),
+    make_fragmented(0, GetParam()),
+  };
+  uint64_t frame_len = 0;
+  for (auto& bl : plaintexts) {
+    frame_len += bl.length();
+  }
+
+  const uint64_t iterations = std::max<uint64_t>(
+    100, (uint64_t(1) << 32) / frame_len);
+  ceph::timespan tx_time = ceph::timespan::zero();
+  ceph::timespan rx_time = ceph::timespan::zero();
+  for (uint64_t i = 0; i < iterations; i++) {
+    auto start = ceph::mono_clock::now();
+    auto ciphertext = encrypt(*tx_crypto.tx, plaintexts);
+    auto mid = ceph::mono_clock::now();
+    rx_crypto.rx->reset_rx_handler();
+    rx_crypto.rx->authenticated_decrypt_update_final(ciphertext);
+    tx_time += mid - start;
+    rx_time += ceph::mono_clock::now() - mid;
+  }
+
+  auto mib_per_sec = [&](ceph::timespan t) {
+    return frame_len * iterations /
+      std::chrono::duration<double>(t).count() / (1 << 20);
+  };
+  std::cout << "frame " << frame_len << " bytes"
+            << " encrypt " << mib_per_sec(tx_time) << " MiB/s"
+            << " decrypt " << mib_per_sec(rx_time) << " MiB/s"
+            << std::endl;
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    CryptoPerfTests, CryptoPerfTest,
+    ::testing::Values(0, 512, 4096, 32768, 131072, 4194304));
+
 }  // namespace ceph::msgr::v2
 
 int main(int argc, char* argv[]) {
@@ -20,6 +20,7 @@
 #include <list>
 #include <memory>
 #include <set>
+#include <thread>
 #include <gmock/gmock-matchers.h>
 #include <stdlib.h>
 #include <time.h>
@@ -50,6 +51,7 @@ typedef boost::mt11213b gen_type;
 
 #include "common/dout.h"
 #include "include/ceph_assert.h"
+#include "include/scope_guard.h"
 
 #include "auth/DummyAuth.h"
 
@@ -1183,6 +1185,95 @@ TEST_P(MessengerTest, SimpleMsgr2Test) {
   server_msgr->wait();
 }
 
+class OrderCheckDispatcher : public Dispatcher {
+ public:
+  ceph::mutex lock = ceph::make_mutex("OrderCheckDispatcher::lock");
+  ceph::condition_variable cond;
+  std::map<Connection*, uint64_t> last_seq;
+  std::set<std::thread::id> threads;
+  uint64_t received = 0;
+  bool out_of_order = false;
+
+  OrderCheckDispatcher() : Dispatcher(g_ceph_context) {}
+  bool ms_dispatch(Message *m) override {
+    std::lock_guard l{lock};
+    auto& last = last_seq[m->get_connection().get()];
+    if (m->get_seq() <= last) {
+      out_of_order = true;
+    }
+    last = m->get_seq();
+    threads.insert(std::this_thread::get_id());
+    ++received;
+    cond.notify_all();
+    m->put();
+    return true;
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+};
+
+TEST_P(MessengerTest, ShardedDispatchTest) {
+  g_ceph_context->_conf.set_val("ms_dispatch_shards", "4");
+  auto reset_shards = make_scope_guard([] {
+    g_ceph_context->_conf.set_val("ms_dispatch_shards", "1");
+  });
+  OrderCheckDispatcher srv_dispatcher;
+  Messenger *server = Messenger::create(g_ceph_context, string(GetParam()),
+                                        entity_name_t::OSD(0), "server",
+                                        getpid() + 1);
+  server->set_default_policy(Messenger::Policy::stateless_server(0));
+  server->set_auth_client(&dummy_auth);
+  server->set_auth_server(&dummy_auth);
+  server->set_require_authorizer(false);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server->bind(bind_addr);
+  server->add_dispatcher_head(&srv_dispatcher);
+  server->start();
+
+  const int num_clients = 8;
+  const int num_messages = 200;
+  vector<Messenger*> clients;
+  auto stop_msgrs = make_scope_guard([&] {
+    for (auto client : clients) {
+      client->shutdown();
+      client->wait();
+      delete client;
+    }
+    server->shutdown();
+    server->wait();
+    delete server;
+  });
+  for (int i = 0; i < num_clients; ++i) {
+    Messenger *client = Messenger::create(g_ceph_context, string(GetParam()),
+                                          entity_name_t::CLIENT(-1), "client",
+                                          getpid() + 2 + i);
+    client->set_default_policy(Messenger::Policy::lossy_client(0));
+    client->set_auth_client(&dummy_auth);
+    client->set_auth_server(&dummy_auth);
+    client->start();
+    clients.push_back(client);
+  }
+  for (int n = 0; n < num_messages; ++n) {
+    for (auto client : clients) {
+      ConnectionRef conn = client->connect_to(server->get_mytype(),
+                                              server->get_myaddrs());
+      ASSERT_EQ(conn->send_message(new MPing()), 0);
+    }
+  }
+  {
+    std::unique_lock l{srv_dispatcher.lock};
+    srv_dispatcher.cond.wait(l, [&] {
+      return srv_dispatcher.received == num_clients * num_messages;
+    });
+    ASSERT_FALSE(srv_dispatcher.out_of_order);
+    ASSERT_EQ(num_clients, (int)srv_dispatcher.last_seq.size());
+    // the connections were spread over more than one dispatch thread
+    ASSERT_GT(srv_dispatcher.threads.size(), 1u);
+  }
+}
+
 TEST_P(MessengerTest, FeatureTest) {
   FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
   entity_addr_t bind_addr;
@@ -2203,6 +2294,39 @@ TEST_P(MessengerTest, SyntheticStressTest1) {
   test_msg.wait_for_done();
 }
 
+TEST_P(MessengerTest, SyntheticBatchingTest) {
+  g_ceph_context->_conf.set_val("ms_tcp_tx_batch_bytes", "65536");
+  g_ceph_context->_conf.set_val("ms_inject_socket_failures", "100");
+  SyntheticWorkload test_msg(8, 32, GetParam(), 100,
+                             Messenger::Policy::lossless_peer_reuse(0),
+                             Messenger::Policy::lossless_peer_reuse(0));
+  for (int i = 0; i < 10; ++i) {
+    if (!(i % 10)) lderr(g_ceph_context) << "seeding connection " << i << dendl;
+    test_msg.generate_connection();
+  }
+  gen_type rng(time(NULL));
+  for (int i = 0; i < 5000; ++i) {
+    if (!(i % 10)) {
+      lderr(g_ceph_context) << "Op " << i << ": " << dendl;
+      test_msg.print_internal_state();
+    }
+    boost::uniform_int<> true_false(0, 99);
+    int val = true_false(rng);
+    if (val > 95) {
+      test_msg.generate_connection();
+    } else if (val > 90) {
+      test_msg.drop_connection();
+    } else if (val > 5) {
+      test_msg.send_message();
+    } else {
+      usleep(rand() % 1000 + 500);
+    }
+  }
+  test_msg.wait_for_done();
+  g_ceph_context->_conf.set_val("ms_inject_socket_failures", "0");
+  g_ceph_context->_conf.set_val("ms_tcp_tx_batch_bytes", "0");
+}
+
 
 TEST_P(MessengerTest, SyntheticInjectTest) {
   uint64_t dispatch_throttle_bytes = g_ceph_context->_conf->ms_dispatch_throttle_bytes;
@@ -7,6 +7,7 @@
  */
 #include <bit>
 #include <iostream>
+#include <thread>
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
 #include <boost/random/triangle_distribution.hpp>
@@ -458,7 +459,88 @@ TEST_P(AllocTest, test_bonus_empty_fragmented)
   std::cout << "    empty storage frag.score=" << frag_score << std::endl;
 }
 
+/*
+ * Several threads age the same allocator concurrently, each one filling
+ * its share of the space up to the high mark and freeing it down to the
+ * low mark again. Reports allocations/sec next to the fragmentation
+ * observed, which is what sharding the allocator trades against.
+ */
+TEST_P(AllocTest, test_alloc_mt_aging)
+{
+  std::string allocator_name = GetParam();
+  constexpr size_t thread_count = 8;
+  constexpr uint32_t repeats = 3;
+  uint64_t capacity = uint64_t(256) * _1G;
+  uint32_t alloc_unit = 65536 / 16;
+  init_alloc(allocator_name, capacity, alloc_unit);
+  alloc->init_add_free(0, capacity);
+  uint64_t high_mark = capacity * 9 / 10 / thread_count;
+  uint64_t low_mark = capacity * 7 / 10 / thread_count;
+
+  std::atomic<uint64_t> allocs = 0;
+  std::atomic<uint64_t> fragmented = 0;
+  std::vector<std::thread> threads;
+  utime_t start = ceph_clock_now();
+  for (size_t t = 0; t < thread_count; t++) {
+    threads.emplace_back([&, t] {
+      gen_type rng(t);
+      boost::uniform_int<> D(1, 128); // alloc_unit * 16 * D => 64K - 8M
+      AllocTracker tracker;
+      PExtentVector tmp;
+      uint64_t level = 0;
+      for (uint32_t i = 0; i < repeats; i++) {
+        while (level < high_mark) {
+          uint32_t want = alloc_unit * 16 * D(rng);
+          tmp.clear();
+          auto r = alloc->allocate(want, alloc_unit, 0, 0, &tmp);
+          if (r < want) {
+            if (r > 0) {
+              alloc->release(tmp);
+            }
+            break;
+          }
+          level += r;
+          for (auto a : tmp) {
+            tracker.push(a.offset, a.length);
+          }
+          allocs++;
+          if (tmp.size() > 1) {
+            fragmented++;
+          }
+        }
+        if (i + 1 == repeats) {
+          break; // leave the last fill allocated to measure it
+        }
+        while (level > low_mark) {
+          uint64_t o = 0;
+          uint32_t l = 0;
+          if (!tracker.pop_random(rng, &o, &l)) {
+            break;
+          }
+          interval_set<uint64_t> release_set;
+          release_set.insert(o, l);
+          alloc->release(release_set);
+          level -= l;
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  double secs = ceph_clock_now() - start;
+  std::cout << "Allocator: " << allocator_name
+            << " threads=" << thread_count
+            << " allocs=" << allocs
+            << " allocs/s=" << allocs / secs
+            << " fragmented allocs=" << 100.0 * fragmented / allocs << "%"
+            << " frag=" << alloc->get_fragmentation()
+            << " frag.score=" << alloc->get_fragmentation_score()
+            << std::endl;
+}
+
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap", "avl", "btree"));
+  ::testing::Values("stupid", "bitmap", "avl", "btree", "hybrid",
+                    "hybrid_sharded"));
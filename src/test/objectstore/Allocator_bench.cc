@@ -6,6 +6,7 @@
  * Author: Igor Fedotov, ifedotov@suse.com
  */
 #include <iostream>
+#include <thread>
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
 
@@ -817,6 +818,103 @@ TEST_P(AllocTest, test_alloc_bench2_75_500_x2)
   doOverwriteMPC2Test(2, capacity, prefill, overwrite, 0.05);
 }
 
+/*
+ * Allocations/sec with several threads allocating and releasing small
+ * extents concurrently, like kv_sync and finisher threads do.
+ */
+TEST_P(AllocTest, test_alloc_bench_mt)
+{
+  if ((GetParam() == string("stupid"))) {
+    GTEST_SKIP() << "skipping for specific allocators";
+  }
+  uint64_t capacity = uint64_t(1024) * 1024 * 1024 * 128;
+  uint64_t alloc_unit = 4096;
+  constexpr size_t ops_per_thread = 256 * 1024;
+  constexpr size_t keep = 1024; // allocations each thread holds on to
+
+  for (size_t thread_count = 1; thread_count <= 16; thread_count *= 2) {
+    init_alloc(capacity, alloc_unit);
+    alloc->init_add_free(0, capacity);
+    std::vector<std::thread> threads;
+    auto start = mono_clock::now();
+    for (size_t t = 0; t < thread_count; t++) {
+      threads.emplace_back([&, t] {
+        gen_type rng(t);
+        boost::uniform_int<> u1(1, 16); // alloc_unit * u1 => 4K-64K
+        std::vector<PExtentVector> held(keep);
+        for (size_t i = 0; i < ops_per_thread; i++) {
+          auto& slot = held[i % keep];
+          if (!slot.empty()) {
+            alloc->release(slot);
+            slot.clear();
+          }
+          uint64_t want = alloc_unit * u1(rng);
+          EXPECT_EQ((int64_t)want,
+                    alloc->allocate(want, alloc_unit, 0, 0, &slot));
+        }
+        for (auto& slot : held) {
+          alloc->release(slot);
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    double secs = std::chrono::duration<double>(mono_clock::now() - start).count();
+    std::cout << GetParam() << " threads " << thread_count
+              << " allocs/s " << thread_count * ops_per_thread / secs
+              << " fragmentation " << alloc->get_fragmentation()
+              << std::endl;
+    EXPECT_EQ(capacity, alloc->get_free());
+    init_close();
+  }
+}
+
+/*
+ * Many writes of a transaction served by one allocate_batch() call
+ * vs. an allocate() call per write.
+ */
+TEST_P(AllocTest, test_alloc_bench_batch)
+{
+  uint64_t capacity = uint64_t(1024) * 1024 * 1024 * 16;
+  uint64_t alloc_unit = 4096;
+  constexpr size_t batches = 64 * 1024;
+  constexpr size_t batch_size = 16;
+  init_alloc(capacity, alloc_unit);
+  alloc->init_add_free(0, capacity);
+
+  gen_type rng(0);
+  boost::uniform_int<> u1(1, 16);
+  std::vector<uint64_t> wants(batch_size);
+  ceph::timespan single = ceph::make_timespan(0);
+  ceph::timespan batched = ceph::make_timespan(0);
+  for (size_t i = 0; i < batches; i++) {
+    for (auto& w : wants) {
+      w = alloc_unit * u1(rng);
+    }
+    std::vector<PExtentVector> extents(batch_size);
+    auto t0 = mono_clock::now();
+    for (size_t j = 0; j < batch_size; j++) {
+      alloc->allocate(wants[j], alloc_unit, 0, 0, &extents[j]);
+    }
+    single += mono_clock::now() - t0;
+    for (auto& e : extents) {
+      alloc->release(e);
+    }
+
+    t0 = mono_clock::now();
+    ASSERT_GT(alloc->allocate_batch(wants, alloc_unit, 0, 0, &extents), 0);
+    batched += mono_clock::now() - t0;
+    for (auto& e : extents) {
+      alloc->release(e);
+    }
+  }
+  std::cout << GetParam() << " " << batch_size << " allocations, "
+            << "one by one " << single / batches
+            << " batched " << batched / batches
+            << std::endl;
+}
+
 TEST_P(AllocTest, mempoolAccounting)
 {
   uint64_t bytes = mempool::bluestore_alloc::allocated_bytes();
@@ -854,4 +952,5 @@ TEST_P(AllocTest, mempoolAccounting)
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap", "avl", "hybrid", "btree", "hybrid_btree2"));
+  ::testing::Values("stupid", "bitmap", "avl", "hybrid", "btree", "hybrid_btree2",
+                    "hybrid_sharded"));
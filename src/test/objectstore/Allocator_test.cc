@@ -671,6 +671,44 @@ TEST_P(AllocTest, test_init_rm_free_unbound)
   }
 }
 
+TEST_P(AllocTest, test_alloc_batch)
+{
+  int64_t block_size = 0x1000;
+  int64_t capacity = 0x1000 * block_size;
+  init_alloc(capacity, block_size);
+  alloc->init_add_free(0, capacity);
+
+  std::vector<uint64_t> wants = {0x1000, 0x10000, 0x3000, 0x100000, 0x2000};
+  uint64_t total = 0;
+  for (auto w : wants) {
+    total += w;
+  }
+  std::vector<PExtentVector> extents;
+  EXPECT_EQ((int64_t)total,
+    alloc->allocate_batch(wants, block_size, 0, 0, &extents));
+  ASSERT_EQ(wants.size(), extents.size());
+  EXPECT_EQ(capacity - total, alloc->get_free());
+  interval_set<uint64_t> all;
+  for (size_t i = 0; i < wants.size(); i++) {
+    uint64_t len = 0;
+    for (auto& e : extents[i]) {
+      EXPECT_EQ(0u, e.offset % block_size);
+      all.insert(e.offset, e.length); // asserts on overlaps
+      len += e.length;
+    }
+    EXPECT_EQ(wants[i], len);
+  }
+  alloc->release(all);
+  EXPECT_EQ((uint64_t)capacity, alloc->get_free());
+
+  // nothing gets allocated if the whole batch doesn't fit
+  wants.push_back(capacity);
+  EXPECT_EQ(-ENOSPC,
+    alloc->allocate_batch(wants, block_size, 0, 0, &extents));
+  EXPECT_TRUE(extents.empty());
+  EXPECT_EQ((uint64_t)capacity, alloc->get_free());
+}
+
 TEST_P(AllocTest, test_alloc_spatial_locality)
 {
   if (GetParam() == string("hybrid_btree2")) {
@@ -798,4 +836,5 @@ TEST_P(AllocTest, test_alloc_spatial_locality)
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap", "avl", "hybrid", "btree", "hybrid_btree2"));
+  ::testing::Values("stupid", "bitmap", "avl", "hybrid", "btree", "hybrid_btree2",
+		    "hybrid_sharded"));
@@ -0,0 +1,105 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Onode cache hit path benchmark: measures the latency of
+ * Collection::get_onode() for cached onodes under concurrent readers.
+ */
+#include <iostream>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "common/ceph_time.h"
+#include "common/perf_counters.h"
+#include "include/stringify.h"
+#include "os/bluestore/BlueStore.h"
+#include "global/global_context.h"
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+typedef boost::mt11213b gen_type;
+
+using namespace std;
+
+class OnodeCacheBench : public ::testing::Test {
+public:
+  static constexpr size_t num_onodes = 64 * 1024;
+
+  BlueStore store{g_ceph_context, "", 4096};
+  std::unique_ptr<PerfCounters> logger;
+  std::unique_ptr<BlueStore::OnodeCacheShard> oc;
+  std::unique_ptr<BlueStore::BufferCacheShard> bc;
+  BlueStore::CollectionRef coll;
+  vector<ghobject_t> oids;
+
+  void SetUp() override {
+    PerfCountersBuilder b(g_ceph_context, "onode_cache_bench",
+                          l_bluestore_first, l_bluestore_last);
+    b.add_u64_counter(l_bluestore_onode_hits, "onode_hits", "");
+    b.add_u64_counter(l_bluestore_onode_misses, "onode_misses", "");
+    logger.reset(b.create_perf_counters());
+
+    oc.reset(BlueStore::OnodeCacheShard::create(g_ceph_context, "lru",
+                                                logger.get()));
+    oc->set_max(num_onodes);
+    bc.reset(BlueStore::BufferCacheShard::create(&store, "lru", nullptr));
+    coll = ceph::make_ref<BlueStore::Collection>(&store, oc.get(), bc.get(),
+                                                 coll_t());
+
+    std::unique_lock l(coll->lock);
+    for (size_t i = 0; i < num_onodes; ++i) {
+      oids.emplace_back(hobject_t(sobject_t("obj" + stringify(i),
+                                            CEPH_NOSNAP)));
+      auto o = coll->get_onode(oids.back(), true, true);
+      ASSERT_TRUE(o);
+      // pretend it has been written, non-existent onodes
+      // are dropped from the cache once unpinned
+      o->exists = true;
+    }
+  }
+  void TearDown() override {
+    coll->onode_space.clear();
+    coll.reset();
+  }
+
+  void run(size_t thread_count, size_t lookups_per_thread) {
+    vector<std::thread> threads;
+    vector<ceph::timespan> spent(thread_count);
+    auto hits0 = logger->get(l_bluestore_onode_hits);
+    for (size_t t = 0; t < thread_count; ++t) {
+      threads.emplace_back([&, t] {
+        gen_type rng(t);
+        boost::uniform_int<size_t> u(0, oids.size() - 1);
+        auto start = ceph::mono_clock::now();
+        for (size_t i = 0; i < lookups_per_thread; ++i) {
+          std::shared_lock l(coll->lock);
+          auto o = coll->get_onode(oids[u(rng)], false);
+          ceph_assert(o);
+        }
+        spent[t] = ceph::mono_clock::now() - start;
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    ceph::timespan total = ceph::timespan::zero();
+    for (auto& s : spent) {
+      total += s;
+    }
+    auto lookups = thread_count * lookups_per_thread;
+    ASSERT_EQ(lookups, logger->get(l_bluestore_onode_hits) - hits0);
+    std::cout << "threads " << thread_count
+              << " lookups " << lookups
+              << " avg hit latency "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   total).count() / lookups << " ns"
+              << std::endl;
+  }
+};
+
+TEST_F(OnodeCacheBench, hit_latency)
+{
+  for (size_t threads = 1; threads <= 64; threads *= 2) {
+    run(threads, 1024 * 1024 / threads);
+  }
+}
@@ -2,9 +2,11 @@
 // vim: ts=8 sw=2 sts=2 expandtab
 
 #include <iostream>
+#include <thread>
 #include <gtest/gtest.h>
 
 #include "os/bluestore/HybridAllocator.h"
+#include "os/bluestore/ShardedAllocator.h"
 
 class TestHybridAllocator : public HybridAvlAllocator {
 public:
@@ -288,3 +290,102 @@ TEST(HybridAllocator, fragmentation)
     ASSERT_EQ(0.5 * 7 / 8 + 1.0 / 8, ha.get_fragmentation());
   }
 }
+
+TEST(ShardedAllocator, basic)
+{
+  uint64_t block_size = 0x1000;
+  uint64_t shard = ShardedAllocator::SHARD_ALIGNMENT;
+  uint64_t capacity = shard * 3 + _4m; // the last shard is a short one
+  ShardedAllocator sa(g_ceph_context, capacity, block_size, 4,
+    64 * _1m, "test_sharded_allocator");
+  ASSERT_EQ(4u, sa.get_num_shards());
+  ASSERT_EQ(0, sa.get_free());
+
+  // spans all the shard boundaries
+  sa.init_add_free(0, capacity);
+  ASSERT_EQ(capacity, sa.get_free());
+
+  uint64_t cnt = 0;
+  uint64_t sum = 0;
+  sa.foreach([&](uint64_t o, uint64_t l) {
+    ASSERT_EQ(o, cnt * shard);
+    ++cnt;
+    sum += l;
+  });
+  ASSERT_EQ(4u, cnt);
+  ASSERT_EQ(capacity, sum);
+
+  // the hint picks the shard
+  PExtentVector extents;
+  ASSERT_EQ(_1m, sa.allocate(_1m, block_size, 0, shard * 2 + _4m, &extents));
+  ASSERT_EQ(1u, extents.size());
+  ASSERT_GE(extents[0].offset, shard * 2);
+  ASSERT_LT(extents[0].offset, shard * 3);
+  ASSERT_EQ(capacity - _1m, sa.get_free());
+
+  // a release crossing a shard boundary
+  sa.release(extents);
+  sa.init_rm_free(shard - _1m, 2 * _1m);
+  ASSERT_EQ(capacity - 2 * _1m, sa.get_free());
+  interval_set<uint64_t> r;
+  r.insert(shard - _1m, 2 * _1m);
+  sa.release(r);
+  ASSERT_EQ(capacity, sa.get_free());
+
+  // takes the remainder from other shards once one is exhausted
+  sa.init_rm_free(0, capacity);
+  sa.init_add_free(shard - _1m, 2 * _1m);
+  extents.clear();
+  ASSERT_EQ(2 * _1m, sa.allocate(2 * _1m, block_size, 0, 0, &extents));
+  ASSERT_EQ(2u, extents.size());
+  ASSERT_EQ(0, sa.get_free());
+  extents.clear();
+  ASSERT_EQ(-ENOSPC, sa.allocate(block_size, block_size, 0, 0, &extents));
+
+  sa.expand(capacity + _4m);
+  sa.init_add_free(capacity, _4m);
+  ASSERT_EQ(_4m, sa.allocate(_4m, block_size, 0, 0, &extents));
+  ASSERT_EQ(capacity, extents.back().offset);
+}
+
+TEST(ShardedAllocator, small_device)
+{
+  uint64_t block_size = 0x1000;
+  ShardedAllocator sa(g_ceph_context, 64 * _1m, block_size, 4,
+    64 * _1m, "test_sharded_allocator");
+  ASSERT_EQ(1u, sa.get_num_shards());
+  sa.init_add_free(0, 64 * _1m);
+  PExtentVector extents;
+  ASSERT_EQ(64 * _1m, sa.allocate(64 * _1m, block_size, 0, 0, &extents));
+  ASSERT_EQ(0, sa.get_free());
+}
+
+TEST(ShardedAllocator, concurrent)
+{
+  uint64_t block_size = 0x1000;
+  uint64_t capacity = ShardedAllocator::SHARD_ALIGNMENT * 4;
+  ShardedAllocator sa(g_ceph_context, capacity, block_size, 4,
+    64 * _1m, "test_sharded_allocator");
+  sa.init_add_free(0, capacity);
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 8; t++) {
+    threads.emplace_back([&] {
+      std::vector<PExtentVector> held(64);
+      for (size_t i = 0; i < 64 * 1024; i++) {
+        auto& h = held[i % held.size()];
+        sa.release(h);
+        h.clear();
+        uint64_t want = block_size * (1 + i % 16);
+        ASSERT_EQ((int64_t)want, sa.allocate(want, block_size, 0, 0, &h));
+      }
+      for (auto& h : held) {
+        sa.release(h);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(capacity, sa.get_free());
+}
@@ -2624,6 +2624,136 @@ TEST_P(StoreTestSpecificAUSize, BluestoreFragmentedBlobTest) {
     ASSERT_EQ( 0u, statfs.data_compressed_allocated);
   }
 }
+
+TEST_P(StoreTest, BluestoreOnodeMissFilter) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  SetVal(g_conf(), "bluestore_onode_miss_filter", "true");
+  g_conf().apply_changes(nullptr);
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  ghobject_t hoid2(hobject_t(sobject_t("Object 2", CEPH_NOSNAP)));
+  bufferlist bl;
+  bl.append("1234512345");
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // filters are rebuilt from the stored onodes on mount
+  ch.reset();
+  ASSERT_EQ(0, store->umount());
+  ASSERT_EQ(0, store->mount());
+  ch = store->open_collection(cid);
+
+  const PerfCounters* logger = store->get_perf_counters();
+  auto skips = logger->get(l_bluestore_onode_filter_skips);
+  ASSERT_TRUE(store->exists(ch, hoid));
+  ASSERT_EQ(skips, logger->get(l_bluestore_onode_filter_skips));
+  ASSERT_FALSE(store->exists(ch, hoid2));
+  ASSERT_EQ(skips + 1, logger->get(l_bluestore_onode_filter_skips));
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid2, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_EQ(skips + 2, logger->get(l_bluestore_onode_filter_skips));
+  bufferlist in;
+  r = store->read(ch, hoid2, 0, bl.length(), in);
+  ASSERT_EQ((int)bl.length(), r);
+  ASSERT_TRUE(bl_eq(bl, in));
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove(cid, hoid2);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTest, BlueStoreAllocationDeltasRecovery) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  BlueStore* bstore = dynamic_cast<BlueStore*> (store.get());
+  if (!bstore->has_null_manager())
+    return;
+  SetVal(g_conf(), "bluestore_allocation_deltas", "true");
+  SetVal(g_conf(), "bluestore_allocation_deltas_compact_threshold", "16");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(0, store->umount());
+  ASSERT_EQ(0, store->mount());
+
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  gen_type rng(TEST_RANDOM_SEED);
+  boost::uniform_int<> u(0, 63);
+  boost::uniform_int<> u_ops(1, 300);
+  boost::uniform_int<> u_threshold(2, 32);
+  bufferlist bl;
+  bl.append(string(0x10000, 'a'));
+  // each round stops after a random number of transactions, with merges
+  // of a random size, so the restart finds the deltas anywhere between
+  // two merges. A merge is a single kv transaction, so a crash during
+  // one leaves the same state as a stop right before or after it.
+  for (unsigned round = 0; round < 8; ++round) {
+    SetVal(g_conf(), "bluestore_allocation_deltas_compact_threshold",
+           stringify(u_threshold(rng)).c_str());
+    g_conf().apply_changes(nullptr);
+    unsigned ops = u_ops(rng);
+    for (unsigned i = 0; i < ops; ++i) {
+      ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(u(rng)),
+                                          CEPH_NOSNAP)));
+      ObjectStore::Transaction t;
+      if (u(rng) < 16) {
+        t.remove(cid, hoid);
+      } else {
+        t.write(cid, hoid, u(rng) * 0x1000, bl.length(), bl);
+      }
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+    store_statfs_t before;
+    ASSERT_EQ(0, store->statfs(&before));
+
+    // neither the allocation file nor statfs are stored at umount,
+    // so the next mount has to rely on the journaled deltas
+    SetVal(g_conf(), "bluestore_debug_skip_allocation_destage", "true");
+    g_conf().apply_changes(nullptr);
+    ch.reset();
+    ASSERT_EQ(0, store->umount());
+    SetVal(g_conf(), "bluestore_debug_skip_allocation_destage", "false");
+    g_conf().apply_changes(nullptr);
+    ASSERT_EQ(0, store->mount());
+    ch = store->open_collection(cid);
+
+    store_statfs_t after;
+    ASSERT_EQ(0, store->statfs(&after));
+    ASSERT_EQ(before.allocated, after.allocated);
+    ASSERT_EQ(before.data_stored, after.data_stored);
+  }
+  ASSERT_GT(store->get_perf_counters()->get(l_bluestore_alloc_delta_compactions), 0u);
+
+  ch.reset();
+  ASSERT_EQ(0, store->umount());
+  ASSERT_EQ(0, store->fsck(false));
+  SetVal(g_conf(), "bluestore_allocation_deltas", "false");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(0, store->mount());
+}
 #endif
 
 TEST_P(StoreTest, ManySmallWrite) {
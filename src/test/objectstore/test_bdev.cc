@@ -10,9 +10,13 @@
 #include "common/ceph_context.h"
 #include "common/ceph_argparse.h"
 #include "include/stringify.h"
+#include "common/ceph_time.h"
 #include "common/errno.h"
+#include "common/perf_counters_collection.h"
+#include "include/scope_guard.h"
 
 #include "blk/BlockDevice.h"
+#include "blk/kernel/io_uring.h"
 
 using namespace std;
 
@@ -91,6 +95,102 @@ TEST(KernelDevice, Ticket45337) {
   b->close();
 }
 
+// runs a batched read workload (16 extents per IOContext) through the
+// given aio backend and returns how many reads used registered buffers
+static void run_aio_reads(bool ioring, unsigned registered_buffers,
+                          uint64_t* registered_reads)
+{
+  const uint64_t size = 1048576ull * 64;
+  const uint64_t read_len = 0x4000;
+  const unsigned extents_per_ioc = 16;
+  const unsigned rounds = 256;
+  TempBdev bdev{ size };
+
+  auto& conf = g_ceph_context->_conf;
+  auto reset_conf = make_scope_guard([&conf] {
+    conf.set_val("bdev_ioring", "false");
+    conf.set_val("bdev_ioring_registered_buffers", "0");
+    conf.apply_changes(nullptr);
+  });
+  conf.set_val("bdev_ioring", ioring ? "true" : "false");
+  conf.set_val("bdev_ioring_registered_buffers",
+               stringify(registered_buffers));
+  conf.apply_changes(nullptr);
+
+  std::unique_ptr<BlockDevice> b(
+    BlockDevice::create(g_ceph_context, bdev.path, NULL, NULL,
+      [](void* handle, void* aio) {}, NULL));
+  int r = b->open(bdev.path);
+  if (r < 0) {
+    GTEST_SKIP() << "open " << bdev.path << " failed: " << cpp_strerror(r);
+  }
+  auto close_bdev = make_scope_guard([&b] { b->close(); });
+
+  bufferlist bl;
+  for (uint64_t off = 0; off < size; off += read_len) {
+    bl.append(string(read_len, 'a' + (off / read_len) % 26));
+  }
+  r = b->write(0, bl, false);
+  ASSERT_EQ(r, 0);
+
+  for (unsigned i = 0; i < rounds; i++) {
+    IOContext ioc(g_ceph_context, NULL);
+    bufferlist out[extents_per_ioc];
+    uint64_t offs[extents_per_ioc];
+    for (unsigned j = 0; j < extents_per_ioc; j++) {
+      offs[j] = (rand() % (size / read_len)) * read_len;
+      r = b->aio_read(offs[j], read_len, &out[j], &ioc);
+      ASSERT_EQ(r, 0);
+    }
+    if (ioc.has_pending_aios()) {
+      b->aio_submit(&ioc);
+      ioc.aio_wait();
+    }
+    for (unsigned j = 0; j < extents_per_ioc; j++) {
+      ASSERT_EQ(out[j].length(), read_len);
+      ASSERT_EQ(out[j][0], 'a' + (offs[j] / read_len) % 26);
+    }
+  }
+
+  *registered_reads = 0;
+  g_ceph_context->get_perfcounters_collection()->with_counters(
+    [&](const PerfCountersCollectionImpl::CounterMap& by_path) {
+      for (const auto& [path, ref] : by_path) {
+        if (path.starts_with("blk-kernel-device-") &&
+            path.ends_with(".registered_buffer_reads")) {
+          *registered_reads += ref.data->u64;
+        }
+      }
+    });
+}
+
+TEST(KernelDevice, AioModes_libaio) {
+  uint64_t registered_reads = 0;
+  run_aio_reads(false, 0, &registered_reads);
+  ASSERT_EQ(registered_reads, 0u);
+}
+
+TEST(KernelDevice, AioModes_io_uring) {
+  if (!ioring_queue_t::supported()) {
+    GTEST_SKIP() << "io_uring is not supported";
+  }
+  uint64_t registered_reads = 0;
+  run_aio_reads(true, 0, &registered_reads);
+  ASSERT_EQ(registered_reads, 0u);
+}
+
+TEST(KernelDevice, AioModes_io_uring_registered) {
+  if (!ioring_queue_t::supported()) {
+    GTEST_SKIP() << "io_uring is not supported";
+  }
+  uint64_t registered_reads = 0;
+  run_aio_reads(true, 64, &registered_reads);
+  if (IsSkipped()) {
+    return;
+  }
+  ASSERT_GT(registered_reads, 0u);
+}
+
 int main(int argc, char **argv) {
   auto args = argv_to_vec(argc, argv);
   map<string,string> defaults = {
@@ -1543,6 +1543,43 @@ TEST_F(BlueFS_wal, wal_v2_read_after_write)
   fs.umount();
 }
 
+TEST_F(BlueFS_wal, wal_v2_prealloc)
+{
+  ConfSaver conf(g_ceph_context->_conf);
+  conf.SetVal("bluefs_min_flush_size", "65536");
+  conf.SetVal("bluefs_wal_envelope_mode", "true");
+  conf.SetVal("bluefs_wal_envelope_prealloc", "1048576");
+  conf.ApplyChanges();
+
+  Create(1048576 * 256, 1048576 * 128, 1048576 * 64);
+  ASSERT_EQ(0, fs.mount());
+  std::string dir = "dir";
+  std::string file = "wal.log";
+  int r = fs.mkdir(dir);
+  ASSERT_TRUE(r == 0 || r == -EEXIST);
+  BlueFS::FileWriter *writer;
+  ASSERT_EQ(0, fs.open_for_write(dir, file, &writer, false));
+  ASSERT_NE(nullptr, writer);
+  ASSERT_GE(writer->file->fnode.get_allocated(), 1048576u);
+  fs.fsync(writer);
+
+  auto *logger = fs.get_perf_counters();
+  uint64_t logged = logger->get(l_bluefs_logged_bytes);
+  bufferlist content;
+  many_small_writes(writer, content, 100000, 100, 1000, 100);
+  // all appends fit in the preallocation, none touched the log
+  EXPECT_EQ(logged, logger->get(l_bluefs_logged_bytes));
+  EXPECT_NE(0u, logger->get(l_bluefs_wal_log_syncs_avoided));
+  fs.close_writer(writer);
+
+  fs.umount();
+  ASSERT_EQ(0, fs.mount());
+  bufferlist read_content;
+  many_small_reads(dir, file, read_content, 100000, 100, 1000, 100);
+  ASSERT_EQ(content, read_content);
+  fs.umount();
+}
+
 TEST(BlueFS, test_wal_read_after_rollback_to_v1) {
   // test whether we still read with v2 version even though new files will be v1
   uint64_t size_wal = 1048576 * 64;
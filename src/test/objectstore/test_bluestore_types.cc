@@ -4583,6 +4583,64 @@ TEST(bluestore_blob_use_tracker_t, mempool_stats_test) {
   }
 }
 
+TEST(CompressedBlobCache, basic) {
+  BlueStore::CompressedBlobCache cache(g_ceph_context);
+  cache.set_max(0x3000);
+
+  auto make_blob = [](uint64_t offset, uint32_t len) {
+    bluestore_blob_t b;
+    b.allocated_test(bluestore_pextent_t(offset, len));
+    b.set_compressed(0x10000, len);
+    return b;
+  };
+  auto make_bl = [](uint32_t len, char c) {
+    bufferlist bl;
+    bl.append(std::string(len, c));
+    return bl;
+  };
+  bluestore_blob_t b1 = make_blob(0x10000, 0x1000);
+  bluestore_blob_t b2 = make_blob(0x20000, 0x1000);
+  bluestore_blob_t b3 = make_blob(0x30000, 0x2000);
+
+  bufferlist out;
+  ASSERT_FALSE(cache.lookup(b1, &out));
+  cache.add(b1, make_bl(0x1000, 'a'));
+  cache.add(b2, make_bl(0x1000, 'b'));
+  ASSERT_EQ(0x2000u, cache._get_bytes());
+  ASSERT_TRUE(cache.lookup(b1, &out));
+  ASSERT_TRUE(out.contents_equal(make_bl(0x1000, 'a')));
+
+  // same offset, different blob: must not hit
+  ASSERT_FALSE(cache.lookup(make_blob(0x10000, 0x2000), &out));
+
+  // b2 is the least recently used one and goes first
+  cache.add(b3, make_bl(0x2000, 'c'));
+  ASSERT_EQ(0x3000u, cache._get_bytes());
+  ASSERT_FALSE(cache.lookup(b2, &out));
+  ASSERT_TRUE(cache.lookup(b1, &out));
+  ASSERT_TRUE(cache.lookup(b3, &out));
+
+  // releasing the tail of b3 drops it
+  interval_set<uint64_t> released;
+  released.insert(0x31000, 0x1000);
+  cache.invalidate(released);
+  ASSERT_FALSE(cache.lookup(b3, &out));
+  ASSERT_TRUE(cache.lookup(b1, &out));
+  ASSERT_EQ(0x1000u, cache._get_bytes());
+
+  // fragmented blobs are not cached
+  bluestore_blob_t b4;
+  b4.allocated_test(bluestore_pextent_t(0x40000, 0x1000));
+  b4.allocated_test(bluestore_pextent_t(0x50000, 0x1000));
+  b4.set_compressed(0x10000, 0x2000);
+  cache.add(b4, make_bl(0x2000, 'd'));
+  ASSERT_FALSE(cache.lookup(b4, &out));
+
+  cache.flush();
+  ASSERT_EQ(0u, cache._get_bytes());
+  ASSERT_EQ(0u, cache._get_num());
+}
+
 int main(int argc, char **argv) {
   auto args = argv_to_vec(argc, argv);
   auto cct =
@@ -474,6 +474,135 @@ TEST_P(KVTest, RocksDBColumnFamilyTest) {
   fini();
 }
 
+TEST_P(KVTest, RocksDBCoalesceTransactions) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+
+  std::string cfs("cf1");
+  ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->create_and_open(cout, cfs));
+  auto val = [](const char* s) {
+    bufferlist bl;
+    bl.append(s);
+    return bl;
+  };
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->set("prefix", "gone", val("x"));
+    t->set("cf1", "single", val("x"));
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  {
+    // no key written twice, nothing to gain
+    vector<KeyValueDB::Transaction> ts;
+    ts.push_back(db->get_transaction());
+    ts.back()->set("prefix", "a", val("1"));
+    ts.push_back(db->get_transaction());
+    ts.back()->set("prefix", "b", val("1"));
+    ASSERT_FALSE(db->coalesce_transactions(ts));
+  }
+  vector<KeyValueDB::Transaction> ts;
+  ts.push_back(db->get_transaction());
+  ts.back()->set("prefix", "key", val("v1"));
+  ts.back()->set("cf1", "key", val("v1"));
+  ts.back()->rmkey("prefix", "gone");
+  ts.push_back(db->get_transaction());
+  ts.back()->set("prefix", "key", val("v2"));
+  ts.back()->rm_single_key("cf1", "single");
+  ts.push_back(db->get_transaction());
+  ts.back()->set("prefix", "key", val("v3"));
+  ts.back()->set("prefix", "gone", val("back"));
+  KeyValueDB::Transaction t = db->coalesce_transactions(ts);
+  ASSERT_TRUE(t);
+  // two puts and the rmkey of "prefix" are overridden
+  size_t count = 0;
+  for (auto& i : ts) {
+    count += i->get_count();
+  }
+  ASSERT_EQ(count - 3, t->get_count());
+  ASSERT_EQ(0, db->submit_transaction_sync(t));
+  {
+    bufferlist v;
+    ASSERT_EQ(0, db->get("prefix", "key", &v));
+    ASSERT_EQ("v3", _bl_to_str(v));
+    ASSERT_EQ(0, db->get("prefix", "gone", &v));
+    ASSERT_EQ("back", _bl_to_str(v));
+    // same key in another column family is a different key
+    ASSERT_EQ(0, db->get("cf1", "key", &v));
+    ASSERT_EQ("v1", _bl_to_str(v));
+    ASSERT_EQ(-ENOENT, db->get("cf1", "single", &v));
+  }
+  fini();
+}
+
+TEST_P(KVTest, RocksDBColumnFamilyProfile) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+
+  std::string cfs("O(2,0-) m");
+  ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->create_and_open(cout, cfs));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    bufferlist value;
+    value.append("value");
+    t->set("O", "key", value);
+    t->set("m", "key", value);
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  fini();
+
+  {
+    // retune existing column families without resharding
+    g_ceph_context->_conf.set_val_or_die(
+      "rocksdb_cf_options",
+      "O=block_based_table_factory={block_size=16384} "
+      "m=compression=kNoCompression");
+    init();
+    ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+    ASSERT_EQ(0, db->open(cout, cfs));
+    RocksDBStore* rdb = dynamic_cast<RocksDBStore*>(db.get());
+    ASSERT_TRUE(rdb);
+    rocksdb::ColumnFamilyOptions cf_opt;
+    ASSERT_EQ(0, rdb->get_column_family_options("O", &cf_opt));
+    auto bbt = cf_opt.table_factory->GetOptions<rocksdb::BlockBasedTableOptions>();
+    ASSERT_TRUE(bbt);
+    ASSERT_EQ(16384u, bbt->block_size);
+    ASSERT_EQ(0, rdb->get_column_family_options("m", &cf_opt));
+    ASSERT_EQ(rocksdb::kNoCompression, cf_opt.compression);
+    bufferlist v;
+    ASSERT_EQ(0, db->get("O", "key", &v));
+    ASSERT_EQ("value", _bl_to_str(v));
+    ASSERT_EQ(0, db->get("m", "key", &v));
+    ASSERT_EQ("value", _bl_to_str(v));
+    fini();
+  }
+  {
+    g_ceph_context->_conf.set_val_or_die("rocksdb_cf_options",
+                                         "O=no_such_option=1");
+    init();
+    ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+    ASSERT_NE(0, db->open(cout, cfs));
+    fini();
+  }
+  g_ceph_context->_conf.set_val_or_die("rocksdb_cf_options", "");
+  {
+    // a different layout is only warned about, the stored one stays
+    init();
+    ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+    ASSERT_EQ(0, db->open(cout, "O(3,0-) m p"));
+    RocksDBStore* rdb = dynamic_cast<RocksDBStore*>(db.get());
+    ASSERT_TRUE(rdb);
+    std::string sharding;
+    ASSERT_TRUE(rdb->get_sharding(sharding));
+    ASSERT_EQ(cfs, sharding);
+    bufferlist v;
+    ASSERT_EQ(0, db->get("O", "key", &v));
+    ASSERT_EQ("value", _bl_to_str(v));
+    fini();
+  }
+}
+
 TEST_P(KVTest, RocksDBIteratorTest) {
   if(string(GetParam()) != "rocksdb")
     return;
@@ -3480,6 +3480,136 @@ TEST_F(OSDMapTest, pgtemp_primaryfirst) {
   }
 }
 
+TEST_F(OSDMapTest, PGMappingCache) {
+  const int n_osds = 600;
+  const int pg_num = 16384;
+  set_up_map(n_osds, true);
+
+  int pool_id;
+  {
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    pending_inc.new_pool_max = osdmap.get_pool_max();
+    pool_id = ++pending_inc.new_pool_max;
+    pg_pool_t empty;
+    auto p = pending_inc.get_new_pool(pool_id, &empty);
+    p->size = 3;
+    p->min_size = 2;
+    p->set_pg_num(pg_num);
+    p->set_pgp_num(pg_num);
+    p->type = pg_pool_t::TYPE_REPLICATED;
+    p->crush_rule = 0;
+    p->set_flag(pg_pool_t::FLAG_HASHPSPOOL);
+    pending_inc.new_pool_names[pool_id] = "cache_pool";
+    osdmap.apply_incremental(pending_inc);
+  }
+
+  // the reference map computes every mapping from scratch
+  OSDMap ref;
+  ref.deepish_copy_from(osdmap);
+  osdmap.enable_pg_mapping_cache();
+  const auto& cache = osdmap.get_pg_mapping_cache();
+
+  auto verify = [&]() {
+    for (int ps = 0; ps < pg_num; ++ps) {
+      pg_t pg(ps, pool_id);
+      vector<int> up, acting, ref_up, ref_acting;
+      int up_primary, acting_primary, ref_up_primary, ref_acting_primary;
+      // twice, so that the second one is served by the cache
+      for (int i = 0; i < 2; ++i) {
+	osdmap.pg_to_up_acting_osds(pg, &up, &up_primary,
+				    &acting, &acting_primary);
+      }
+      ref.pg_to_up_acting_osds(pg, &ref_up, &ref_up_primary,
+			       &ref_acting, &ref_acting_primary);
+      ASSERT_EQ(ref_up, up) << pg;
+      ASSERT_EQ(ref_up_primary, up_primary) << pg;
+      ASSERT_EQ(ref_acting, acting) << pg;
+      ASSERT_EQ(ref_acting_primary, acting_primary) << pg;
+    }
+  };
+  auto apply = [&](const OSDMap::Incremental& inc) {
+    osdmap.apply_incremental(inc);
+    ref.apply_incremental(inc);
+  };
+
+  verify();
+  ASSERT_EQ((uint64_t)pg_num, cache.get_num_cached());
+
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[7] = CEPH_OSD_UP; // mark down
+    apply(inc);
+    ASSERT_LT(cache.get_num_cached(), (uint64_t)pg_num);
+    verify();
+  }
+  {
+    vector<int> acting;
+    osdmap.pg_to_acting_osds(pg_t(1, pool_id), acting);
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[pg_t(1, pool_id)] = mempool::osdmap::vector<int>(
+      acting.rbegin(), acting.rend());
+    inc.new_primary_temp[pg_t(2, pool_id)] = 11;
+    inc.new_primary_affinity[12] = CEPH_OSD_MAX_PRIMARY_AFFINITY / 2;
+    apply(inc);
+    verify();
+  }
+  {
+    vector<int> up;
+    int up_primary;
+    osdmap.pg_to_raw_up(pg_t(3, pool_id), &up, &up_primary);
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_upmap_items[pg_t(3, pool_id)] =
+      mempool::osdmap::vector<pair<int32_t,int32_t>>{{up[0], 13}};
+    apply(inc);
+    verify();
+  }
+  {
+    // the acting set of the pg_temp above contains osd.7
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[7] = CEPH_OSD_UP; // and up again
+    entity_addrvec_t addrs;
+    addrs.v.push_back(entity_addr_t());
+    inc.new_up_client[8] = addrs; // already up, nothing changes
+    apply(inc);
+    verify();
+  }
+  {
+    // osd.13 is also the upmap target of pg 3, which falls back to the
+    // crush mapping while it is out
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[13] = CEPH_OSD_OUT;
+    apply(inc);
+    // only the pgs mapped to osd.13 are dropped
+    ASSERT_GT(cache.get_num_cached(), 0u);
+    ASSERT_LT(cache.get_num_cached(), (uint64_t)pg_num);
+    verify();
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[13] = CEPH_OSD_IN;
+    apply(inc);
+    // any pg of a pool whose rule reaches osd.13 may pick it again
+    ASSERT_EQ(0u, cache.get_num_cached());
+    verify();
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    pg_pool_t p = *osdmap.get_pg_pool(pool_id);
+    p.size = 2;
+    inc.new_pools[pool_id] = p;
+    apply(inc);
+    verify();
+  }
+  ASSERT_GT(cache.get_hits(), 0u);
+
+  // concurrent filling from scratch gives the same result
+  osdmap.enable_pg_mapping_cache(false);
+  osdmap.enable_pg_mapping_cache();
+  osdmap.prime_pg_mapping_cache(8);
+  ASSERT_EQ((uint64_t)pg_num, cache.get_num_cached());
+  verify();
+}
+
 INSTANTIATE_TEST_SUITE_P(
   OSDMap,
   OSDMapTest,
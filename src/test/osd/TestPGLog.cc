@@ -3967,3 +3967,244 @@ TEST_F(PGLogTest, merge_log_epoch_change_basic) {
   ASSERT_EQ(2, missing.num_missing());
   ASSERT_EQ(2, missing.get_rmissing().size());
 }
+
+class PGLogWriteTest : protected PGLog, public PGLogTestBase, public StoreTestFixture {
+public:
+  PGLogWriteTest() : PGLog(g_ceph_context), StoreTestFixture("memstore") { }
+
+  void SetUp() override {
+    StoreTestFixture::SetUp();
+    saved_dups_tracked = g_ceph_context->_conf.get_val<uint64_t>(
+      "osd_pg_log_dups_tracked");
+    g_ceph_context->_conf.set_val_or_die("osd_pg_log_dups_tracked", "100");
+    saved_trim_range_min = g_ceph_context->_conf.get_val<uint64_t>(
+      "osd_pg_log_trim_range_min");
+    ObjectStore::Transaction t;
+    test_coll = coll_t(spg_t(pg_t(1, 1)));
+    ch = store->create_new_collection(test_coll);
+    t.create_collection(test_coll, 0);
+    store->queue_transaction(ch, std::move(t));
+    hobject_t hoid;
+    hoid.pool = 1;
+    hoid.oid = "log";
+    log_oid = ghobject_t(hoid);
+    info.last_backfill = hobject_t::get_max();
+  }
+
+  void TearDown() override {
+    clear();
+    ch.reset();
+    g_ceph_context->_conf.set_val_or_die(
+      "osd_pg_log_dups_tracked", std::to_string(saved_dups_tracked));
+    g_ceph_context->_conf.set_val_or_die(
+      "osd_pg_log_trim_range_min", std::to_string(saved_trim_range_min));
+    StoreTestFixture::TearDown();
+  }
+
+  static unsigned count_ops(ObjectStore::Transaction& t, int op) {
+    unsigned n = 0;
+    for (auto i = t.begin(); i.have_op(); ) {
+      if (i.decode_op()->op == op) {
+	++n;
+      }
+    }
+    return n;
+  }
+
+  /// append num_entries entries in batches, trimming the log to keep
+  /// entries after each; returns the number of omap_rmkeys ops written
+  unsigned append_and_trim(unsigned num_entries, unsigned batch,
+			   unsigned keep) {
+    unsigned rmkeys = 0;
+    const unsigned end = log.head.version + 1 + num_entries;
+    for (unsigned v = log.head.version + 1; v < end; ) {
+      for (unsigned i = 0; i < batch; ++i, ++v) {
+	add(mk_ple_mod(mk_obj(v % 64), mk_evt(1, v), mk_evt(1, v - 1)));
+      }
+      info.last_update = info.last_complete = log.head;
+      if (v > keep) {
+	trim(mk_evt(1, v - keep), info);
+      }
+      ObjectStore::Transaction t;
+      map<string, bufferlist> km;
+      write_log_and_missing(t, &km, test_coll, log_oid, false);
+      rmkeys += count_ops(t, ObjectStore::Transaction::OP_OMAP_RMKEYS);
+      t.omap_setkeys(test_coll, log_oid, km);
+      EXPECT_EQ(0, store->queue_transaction(ch, std::move(t)));
+    }
+    return rmkeys;
+  }
+
+  /// only the live entries and dups are left on disk
+  void check_on_disk_keys() {
+    bufferlist header;
+    map<string, bufferlist> omap;
+    ASSERT_EQ(0, store->omap_get(ch, log_oid, &header, &omap));
+    set<string> log_keys, dup_keys;
+    for (auto& [key, value] : omap) {
+      if (isdigit(key[0])) {
+	log_keys.insert(key);
+      } else if (key.compare(0, 4, "dup_") == 0) {
+	dup_keys.insert(key);
+      }
+    }
+    set<string> live_log_keys, live_dup_keys;
+    for (auto& e : log.log) {
+      live_log_keys.insert(e.get_key_name());
+    }
+    for (auto& d : log.dups) {
+      live_dup_keys.insert(d.get_key_name());
+    }
+    EXPECT_EQ(live_log_keys, log_keys);
+    EXPECT_EQ(live_dup_keys, dup_keys);
+  }
+
+  coll_t test_coll;
+  ObjectStore::CollectionHandle ch;
+  ghobject_t log_oid;
+  pg_info_t info;
+  uint64_t saved_dups_tracked = 0;
+  uint64_t saved_trim_range_min = 0;
+};
+
+TEST_F(PGLogWriteTest, AppendAndTrim) {
+  constexpr unsigned num_entries = 20000;
+  constexpr unsigned batch = 16;
+  constexpr unsigned keep = 500;
+
+  utime_t encode_time;
+  uint64_t encoded = 0, buffers = 0;
+  const size_t anon_items_before = mempool::buffer_anon::allocated_items();
+  size_t anon_items_max = 0;
+  for (unsigned v = 1; v <= num_entries; ) {
+    for (unsigned i = 0; i < batch; ++i, ++v) {
+      add(mk_ple_mod(mk_obj(v % 64), mk_evt(1, v), mk_evt(1, v - 1)));
+    }
+    info.last_update = info.last_complete = log.head;
+    if (v > keep) {
+      trim(mk_evt(1, v - keep), info);
+    }
+
+    ObjectStore::Transaction t;
+    map<string, bufferlist> km;
+    utime_t start = ceph_clock_now();
+    write_log_and_missing(t, &km, test_coll, log_oid, false);
+    encode_time += ceph_clock_now() - start;
+    anon_items_max = std::max(anon_items_max,
+			      mempool::buffer_anon::allocated_items());
+    for (auto& [key, bl] : km) {
+      if (!isdigit(key[0]) && key.compare(0, 4, "dup_") != 0)
+	continue;
+      // an entry (or dup) is encoded into a single buffer
+      ASSERT_EQ(1u, bl.get_num_buffers()) << key;
+      buffers += bl.get_num_buffers();
+      ++encoded;
+    }
+    t.omap_setkeys(test_coll, log_oid, km);
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  }
+  std::cout << "encoded " << encoded << " log entries and dups in "
+	    << encode_time << " ("
+	    << (double)encoded / (double)encode_time << " entries/sec, "
+	    << (double)buffers / encoded << " buffers per entry, at most "
+	    << anon_items_max - anon_items_before
+	    << " buffer_anon items in flight per batch)" << std::endl;
+
+  check_on_disk_keys();
+
+  auto orig_log = log.log;
+  auto orig_dups = log.dups;
+  clear();
+  ostringstream err;
+  read_log_and_missing(store.get(), ch, log_oid, info, err, false, false);
+  ASSERT_EQ(orig_log.size(), log.log.size());
+  auto it = log.log.begin();
+  for (auto& e : orig_log) {
+    ASSERT_EQ(e.version, it->version);
+    ASSERT_EQ(e.soid, it->soid);
+    ++it;
+  }
+  ASSERT_EQ(orig_dups, log.dups);
+}
+
+TEST_F(PGLogWriteTest, TrimByKeyRange) {
+  // small trims remove the keys one by one ...
+  g_ceph_context->_conf.set_val_or_die("osd_pg_log_trim_range_min", "100000");
+  EXPECT_LT(0u, append_and_trim(1000, 16, 200));
+  check_on_disk_keys();
+
+  // ... larger ones as a key range
+  g_ceph_context->_conf.set_val_or_die("osd_pg_log_trim_range_min", "1");
+  EXPECT_EQ(0u, append_and_trim(1000, 16, 200));
+  check_on_disk_keys();
+}
+
+struct PGLogReqidIndexTest :
+  public ::testing::Test,
+  public PGLogTestBase
+{
+}; // struct PGLogReqidIndexTest
+
+TEST_F(PGLogReqidIndexTest, LazyReqidIndex) {
+  constexpr unsigned num_entries = 3000;
+  constexpr unsigned num_dups = 3000;
+  entity_name_t client = entity_name_t::CLIENT(777);
+
+  mempool::osd_pglog::list<pg_log_entry_t> entries;
+  mempool::osd_pglog::list<pg_log_dup_t> dups;
+  for (unsigned v = 1; v <= num_dups; ++v) {
+    dups.push_back(pg_log_dup_t(mk_evt(1, v), v, osd_reqid_t(client, 8, v), 0));
+  }
+  for (unsigned v = num_dups + 1; v <= num_dups + num_entries; ++v) {
+    entries.push_back(mk_ple_mod(mk_obj(v % 100), mk_evt(1, v),
+				 mk_evt(1, v - 1), osd_reqid_t(client, 8, v)));
+  }
+  const eversion_t head = mk_evt(1, num_dups + num_entries);
+
+  // loading the log only indexes the objects
+  PGLog::IndexedLog log(head, mk_evt(1, num_dups), head, head,
+			std::move(entries), std::move(dups));
+  const size_t bytes_objects = mempool::osd_pglog::allocated_bytes();
+  EXPECT_EQ(100u, log.objects.size());
+  EXPECT_TRUE(log.caller_ops.empty());
+  EXPECT_TRUE(log.extra_caller_ops.empty());
+  EXPECT_TRUE(log.dup_index.empty());
+
+  // the first lookup of a reqid builds the reqid indices
+  eversion_t version;
+  version_t user_version;
+  int return_code;
+  std::vector<pg_log_op_return_item_t> op_returns;
+  EXPECT_TRUE(log.get_request(osd_reqid_t(client, 8, num_dups + 1),
+			      &version, &user_version, &return_code,
+			      &op_returns));
+  EXPECT_EQ(mk_evt(1, num_dups + 1), version);
+  EXPECT_EQ(num_entries, log.caller_ops.size());
+  EXPECT_TRUE(log.dup_index.empty());
+  const size_t bytes_caller_ops = mempool::osd_pglog::allocated_bytes();
+
+  EXPECT_TRUE(log.get_request(osd_reqid_t(client, 8, 1),
+			      &version, &user_version, &return_code,
+			      &op_returns));
+  EXPECT_EQ(mk_evt(1, 1), version);
+  EXPECT_EQ(num_dups, log.dup_index.size());
+  const size_t bytes_dups = mempool::osd_pglog::allocated_bytes();
+
+  EXPECT_GT(bytes_caller_ops, bytes_objects);
+  EXPECT_GT(bytes_dups, bytes_caller_ops);
+
+  // the indices built so far are kept up to date
+  log.rewind_from_head(mk_evt(1, num_dups + num_entries - 10));
+  EXPECT_EQ(num_entries - 10, log.caller_ops.size());
+  EXPECT_EQ(num_dups, log.dup_index.size());
+  EXPECT_FALSE(log.logged_req(
+    osd_reqid_t(client, 8, num_dups + num_entries)));
+
+  // ... while a claimed log starts over
+  PGLog::IndexedLog claimed;
+  claimed.claim_log_and_clear_rollback_info(log);
+  EXPECT_EQ(100u, claimed.objects.size());
+  EXPECT_TRUE(claimed.caller_ops.empty());
+  EXPECT_TRUE(claimed.dup_index.empty());
+  EXPECT_TRUE(claimed.logged_req(osd_reqid_t(client, 8, num_dups + 1)));
+}
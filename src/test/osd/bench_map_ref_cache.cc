@@ -0,0 +1,155 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Readers look up the recent epochs while a writer keeps publishing new
+ * ones, either through a single mutex protected map (what every OSD shard
+ * used to go through) or through a MapRefCache per shard, and the lookup
+ * rate is reported for 1, 2, 4 ... max_shards shards.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common/ceph_time.h"
+#include "osd/MapRefCache.h"
+
+using namespace std;
+
+namespace {
+
+struct Map {
+  epoch_t epoch;
+  explicit Map(epoch_t e) : epoch(e) {}
+  epoch_t get_epoch() const {
+    return epoch;
+  }
+};
+using MapRef = std::shared_ptr<const Map>;
+
+void run(bool sharded, unsigned shards, unsigned threads_per_shard,
+         unsigned lookups)
+{
+  const epoch_t window = 8;
+  std::mutex lock;
+  std::map<epoch_t, MapRef> global;
+  std::vector<MapRefCache<Map>> caches(shards);
+  std::atomic<epoch_t> newest = window;
+  std::atomic<bool> stop = false;
+
+  auto global_get = [&](epoch_t e) {
+    std::lock_guard l(lock);
+    auto p = global.find(e);
+    return p == global.end() ? MapRef() : p->second;
+  };
+  for (epoch_t e = 1; e <= window; ++e) {
+    global[e] = std::make_shared<Map>(e);
+  }
+
+  std::thread writer([&] {
+    while (!stop) {
+      epoch_t e = newest + 1;
+      auto m = std::make_shared<Map>(e);
+      {
+        std::lock_guard l(lock);
+        global[e] = m;
+        global.erase(global.begin());
+      }
+      if (sharded) {
+        for (auto& c : caches) {
+          c.add(m);
+        }
+      }
+      newest = e;
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+
+  std::vector<std::thread> readers;
+  auto start = ceph::mono_clock::now();
+  for (unsigned t = 0; t < shards * threads_per_shard; ++t) {
+    auto& cache = caches[t % shards];
+    readers.emplace_back([&, t] {
+      for (unsigned i = 0; i < lookups; ++i) {
+        epoch_t e = newest - (i + t) % (window / 2);
+        MapRef m;
+        if (sharded) {
+          m = cache.lookup(e);
+          if (!m) {
+            m = global_get(e);
+            if (m) {
+              cache.add(m);
+            }
+          }
+        } else {
+          m = global_get(e);
+        }
+      }
+    });
+  }
+  for (auto& t : readers) {
+    t.join();
+  }
+  auto elapsed = ceph::mono_clock::now() - start;
+  stop = true;
+  writer.join();
+
+  uint64_t hits = 0, misses = 0;
+  for (auto& c : caches) {
+    hits += c.get_hits();
+    misses += c.get_misses();
+  }
+  double secs = std::chrono::duration<double>(elapsed).count();
+  cout << (sharded ? "per-shard cache" : "global lock")
+       << " shards " << shards
+       << " threads " << shards * threads_per_shard
+       << ": " << shards * threads_per_shard * lookups / secs
+       << " lookups/s";
+  if (sharded) {
+    cout << " hits " << hits << " misses " << misses;
+  }
+  cout << std::endl;
+}
+
+void usage(const char *name) {
+  cout << name << " [max_shards [threads_per_shard [lookups]]]\n"
+       << "\t max_shards: the largest number of shards to run with (8)\n"
+       << "\t threads_per_shard: reader threads per shard (2)\n"
+       << "\t lookups: lookups per reader thread (200000)\n"
+       << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, const char **argv)
+{
+  unsigned max_shards = 8, threads_per_shard = 2, lookups = 200000;
+  if (argc > 4) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (argc > 1) {
+    max_shards = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    threads_per_shard = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    lookups = atoi(argv[3]);
+  }
+  if (!max_shards || !threads_per_shard || !lookups) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  for (bool sharded : {false, true}) {
+    for (unsigned shards = 1; shards <= max_shards; shards *= 2) {
+      run(sharded, shards, threads_per_shard, lookups);
+    }
+  }
+  return EXIT_SUCCESS;
+}
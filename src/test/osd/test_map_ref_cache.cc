@@ -0,0 +1,125 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "osd/MapRefCache.h"
+
+namespace {
+
+struct Map {
+  epoch_t epoch;
+  explicit Map(epoch_t e) : epoch(e) {}
+  epoch_t get_epoch() const {
+    return epoch;
+  }
+};
+using MapRef = std::shared_ptr<const Map>;
+
+}
+
+TEST(MapRefCache, basic)
+{
+  MapRefCache<Map, 4> cache;
+  ASSERT_FALSE(cache.lookup(1));
+  cache.add(std::make_shared<Map>(1));
+  cache.add(std::make_shared<Map>(2));
+  ASSERT_EQ(1u, cache.lookup(1)->get_epoch());
+  ASSERT_EQ(2u, cache.lookup(2)->get_epoch());
+  ASSERT_FALSE(cache.lookup(5));
+
+  // 5 takes the slot of 1, and 1 doesn't take it back
+  cache.add(std::make_shared<Map>(5));
+  ASSERT_FALSE(cache.lookup(1));
+  cache.add(std::make_shared<Map>(1));
+  ASSERT_FALSE(cache.lookup(1));
+  ASSERT_EQ(5u, cache.lookup(5)->get_epoch());
+
+  ASSERT_EQ(3u, cache.get_hits());
+  ASSERT_EQ(4u, cache.get_misses());
+
+  cache.clear();
+  ASSERT_FALSE(cache.lookup(2));
+}
+
+// Readers look up the recent epochs while a writer keeps publishing new
+// ones; a lookup never returns a map of another epoch.  See
+// ceph_bench_map_ref_cache for the throughput against a single lock.
+TEST(MapRefCache, concurrent)
+{
+  const unsigned num_caches = 4;
+  const unsigned threads_per_cache = 2;
+  const unsigned lookups = 20000;
+  const epoch_t window = 8;
+
+  std::mutex lock;
+  std::map<epoch_t, MapRef> global;
+  std::vector<MapRefCache<Map>> caches(num_caches);
+  std::atomic<epoch_t> newest = window;
+  std::atomic<bool> stop = false;
+  std::atomic<uint64_t> wrong = 0;
+
+  auto global_get = [&](epoch_t e) {
+    std::lock_guard l(lock);
+    auto p = global.find(e);
+    return p == global.end() ? MapRef() : p->second;
+  };
+  for (epoch_t e = 1; e <= window; ++e) {
+    global[e] = std::make_shared<Map>(e);
+  }
+
+  std::thread writer([&] {
+    while (!stop) {
+      epoch_t e = newest + 1;
+      auto m = std::make_shared<Map>(e);
+      {
+        std::lock_guard l(lock);
+        global[e] = m;
+        global.erase(global.begin());
+      }
+      for (auto& c : caches) {
+        c.add(m);
+      }
+      newest = e;
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+
+  std::vector<std::thread> readers;
+  for (unsigned t = 0; t < num_caches * threads_per_cache; ++t) {
+    auto& cache = caches[t % num_caches];
+    readers.emplace_back([&, t] {
+      for (unsigned i = 0; i < lookups; ++i) {
+        epoch_t e = newest - (i + t) % (window / 2);
+        MapRef m = cache.lookup(e);
+        if (!m) {
+          m = global_get(e);
+          if (m) {
+            cache.add(m);
+          }
+        }
+        if (m && m->get_epoch() != e) {
+          ++wrong;
+        }
+      }
+    });
+  }
+  for (auto& t : readers) {
+    t.join();
+  }
+  stop = true;
+  writer.join();
+
+  uint64_t hits = 0, misses = 0;
+  for (auto& c : caches) {
+    hits += c.get_hits();
+    misses += c.get_misses();
+  }
+  ASSERT_EQ(0u, wrong);
+  ASSERT_EQ(num_caches * threads_per_cache * lookups, hits + misses);
+  ASSERT_GT(hits, 0u);
+}
@@ -372,6 +372,74 @@ TEST(mempool, bufferlist_reassign)
   ASSERT_EQ(bytes_before, mempool::osd::allocated_bytes());
 }
 
+TEST(mempool, bufferlist_arena)
+{
+  size_t items_before = mempool::osd::allocated_items();
+  size_t bytes_before = mempool::osd::allocated_bytes();
+  {
+    bufferlist bl;
+    {
+      buffer::arena a(4096, mempool::mempool_osd);
+      for (unsigned i = 0; i < 10; ++i) {
+        bl.append(a.create(40));
+      }
+      ASSERT_EQ(items_before + 10, mempool::osd::allocated_items());
+      ASSERT_EQ(bytes_before + 400, mempool::osd::allocated_bytes());
+    }
+    // the raws outlive the arena
+    ASSERT_EQ(items_before + 10, mempool::osd::allocated_items());
+  }
+  ASSERT_EQ(items_before, mempool::osd::allocated_items());
+  ASSERT_EQ(bytes_before, mempool::osd::allocated_bytes());
+}
+
+TEST(mempool, buffer_cache)
+{
+  if (getenv("CEPH_BUFFER_NO_CACHE")) {
+    GTEST_SKIP() << "buffer cache disabled";
+  }
+  char *data;
+  {
+    bufferptr p(buffer::create_page_aligned(8192));
+    data = p.c_str();
+  }
+  // the freed buffer is kept by this thread and handed out again
+  size_t items = mempool::buffer_cache::allocated_items();
+  size_t bytes = mempool::buffer_cache::allocated_bytes();
+  ASSERT_LE(1u, items);
+  ASSERT_LE(8192u, bytes);
+  {
+    bufferptr p(buffer::create_page_aligned(8192));
+    ASSERT_EQ(data, p.c_str());
+    ASSERT_EQ(items - 1, mempool::buffer_cache::allocated_items());
+    ASSERT_EQ(bytes - 8192, mempool::buffer_cache::allocated_bytes());
+  }
+  // sizes outside of the size classes are not cached
+  {
+    bufferptr p(buffer::create_page_aligned(3 * 4096));
+  }
+  ASSERT_EQ(items, mempool::buffer_cache::allocated_items());
+}
+
+TEST(mempool, buffer_cache_cross_thread)
+{
+  if (getenv("CEPH_BUFFER_NO_CACHE")) {
+    GTEST_SKIP() << "buffer cache disabled";
+  }
+  // buffers allocated here and released by another thread find their way
+  // back to a thread allocating them again through the depot
+  std::vector<bufferptr> bufs;
+  for (unsigned i = 0; i < 256; ++i) {
+    bufs.emplace_back(buffer::create_page_aligned(4096));
+  }
+  std::thread([&bufs] { bufs.clear(); }).join();
+  size_t items = mempool::buffer_cache::allocated_items();
+  std::thread([items] {
+    bufferptr p(buffer::create_page_aligned(4096));
+    ASSERT_EQ(items - 1, mempool::buffer_cache::allocated_items());
+  }).join();
+}
+
 TEST(mempool, bufferlist_c_str)
 {
   bufferlist bl;
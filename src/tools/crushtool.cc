@@ -245,6 +245,8 @@ void usage()
   cout << "   --set-subtree-class <bucket-name> <class>\n";
   cout << "                         set class for all items beneath bucket-name\n";
   cout << "   --compare <otherfile> compare two maps using --test parameters\n";
+  cout << "   --compare-simd        compare the batch (SIMD) mapping with the scalar\n";
+  cout << "                         one using --test parameters\n";
   cout << "\n";
   cout << "Options for the output stage\n";
   cout << "\n";
@@ -445,6 +447,7 @@ int main(int argc, const char **argv)
   map<string,string> set_subtree_class;     // bucket -> class
 
   string compare;
+  bool compare_simd = false;
 
   CrushWrapper crush;
 
@@ -484,6 +487,8 @@ int main(int argc, const char **argv)
       verbose += 1;
     } else if (ceph_argparse_witharg(args, i, &val, "--compare", (char*)NULL)) {
       compare = val;
+    } else if (ceph_argparse_flag(args, i, "--compare-simd", (char*)NULL)) {
+      compare_simd = true;
     } else if (ceph_argparse_flag(args, i, "--reclassify", (char*)NULL)) {
       reclassify = true;
     } else if (ceph_argparse_witharg(args, i, &val, "--reclassify-bucket",
@@ -852,7 +857,8 @@ int main(int argc, const char **argv)
     }
   }
 
-  if (test && !check && !display && !write_to_file && compare.empty()) {
+  if (test && !check && !display && !write_to_file && compare.empty() &&
+      !compare_simd) {
     cerr << "WARNING: no output selected; use --output-csv or --show-X" << std::endl;
   }
 
@@ -864,7 +870,7 @@ int main(int argc, const char **argv)
       add_item < 0 && !add_bucket && !move_item && !add_rule && !del_rule && full_location < 0 &&
       !bucket_tree &&
       !reclassify && !rebuild_class_roots &&
-      compare.empty() &&
+      compare.empty() && !compare_simd &&
 
       remove_name.empty() && reweight_name.empty()) {
     cerr << "no action specified; -h for help" << std::endl;
@@ -1325,6 +1331,12 @@ int main(int argc, const char **argv)
       return EXIT_FAILURE;
   }
 
+  if (compare_simd) {
+    int r = tester.compare_simd();
+    if (r < 0)
+      return EXIT_FAILURE;
+  }
+
   // output ---
   if (modified) {
     crush.finalize();